@@ -2,6 +2,7 @@
 #include <msat/gdal/const.h>
 #include <string>
 #include <stdexcept>
+#include <algorithm>
 
 using namespace std;
 
@@ -51,6 +52,13 @@ void ProxyDataset::add_info(GDALDataset* ds, const std::string& dsname)
     has_sources = true;
 }
 
+DiskMaskRasterBand* ProxyDataset::get_disk_mask(int block_x, int block_y)
+{
+    if (!disk_mask)
+        disk_mask.reset(new DiskMaskRasterBand(this, block_x, block_y));
+    return disk_mask.get();
+}
+
 const char* ProxyDataset::GetProjectionRef()
 {
     return projWKT.c_str();
@@ -74,5 +82,24 @@ void ProxyRasterBand::add_info(GDALRasterBand* rb, const std::string& rbname)
         throw std::runtime_error(rbname + ": cannot set metadata from source raster band");
 }
 
+CPLErr ProxyRasterBand::read_source_block(GDALRasterBand* rb, int xblock, int yblock, double* buf)
+{
+    int xoff = xblock * nBlockXSize;
+    int yoff = yblock * nBlockYSize;
+    int xsize = min(nBlockXSize, rb->GetXSize() - xoff);
+    int ysize = min(nBlockYSize, rb->GetYSize() - yoff);
+    return rb->RasterIO(GF_Read, xoff, yoff, xsize, ysize, buf, xsize, ysize, GDT_Float64, 0, nBlockXSize * sizeof(double));
+}
+
+GDALRasterBand* ProxyRasterBand::GetMaskBand()
+{
+    return ((ProxyDataset*)poDS)->get_disk_mask(nBlockXSize, nBlockYSize);
+}
+
+int ProxyRasterBand::GetMaskFlags()
+{
+    return GMF_PER_DATASET;
+}
+
 }
 }
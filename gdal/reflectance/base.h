@@ -1,6 +1,7 @@
 #ifndef MSAT_GDALDRIVER_REFLECTANCE_BASE_H
 #define MSAT_GDALDRIVER_REFLECTANCE_BASE_H
 
+#include "diskmask.h"
 #include <gdal/gdal_priv.h>
 #include <memory>
 #include <set>
@@ -29,8 +30,18 @@ public:
      */
     void add_info(GDALDataset* ds, const std::string& dsname);
 
+    /**
+     * Return the mask of the pixels on the Earth disk, creating it with the
+     * given block size the first time it is needed
+     */
+    DiskMaskRasterBand* get_disk_mask(int block_x, int block_y);
+
     const char* GetProjectionRef() override;
     CPLErr GetGeoTransform(double* tr) override;
+
+protected:
+    /// Mask of the pixels on the Earth disk, shared by all bands
+    std::unique_ptr<DiskMaskRasterBand> disk_mask;
 };
 
 class ProxyRasterBand : public GDALRasterBand
@@ -38,6 +49,18 @@ class ProxyRasterBand : public GDALRasterBand
 public:
     /// Add information from the given raster band
     void add_info(GDALRasterBand* rb, const std::string& rbname);
+
+    /**
+     * Read the block (xblock, yblock) of the source raster band \a rb as
+     * doubles into \a buf, which holds nBlockXSize * nBlockYSize values.
+     *
+     * The parts of blocks on the right and bottom edges that fall outside the
+     * raster are left untouched.
+     */
+    CPLErr read_source_block(GDALRasterBand* rb, int xblock, int yblock, double* buf);
+
+    GDALRasterBand* GetMaskBand() override;
+    int GetMaskFlags() override;
 };
 
 }
@@ -6,6 +6,7 @@
 #include <msat/hrit/MSG_channel.h>
 #include <string>
 #include <stdexcept>
+#include <algorithm>
 #include <stdint.h>
 
 using namespace std;
@@ -53,27 +54,36 @@ public:
     CPLErr IReadBlock(int xblock, int yblock, void *buf) override
     {
         // Precompute pixel georeferentiation
+        std::vector<Span> spans(nBlockYSize);
+        p2ll->spans(xblock * nBlockXSize, yblock * nBlockYSize, nBlockXSize, nBlockYSize, spans.data());
         std::vector<double> lats(nBlockXSize * nBlockYSize);
         std::vector<double> lons(nBlockXSize * nBlockYSize);
         p2ll->compute(xblock * nBlockXSize, yblock * nBlockYSize, nBlockXSize, nBlockYSize, lats.data(), lons.data());
 
-        // Compute satellite zenith angles
+        // Compute the cosine of the solar zenith angles on the disk, leaving
+        // space as 0
         double* dest = (double*) buf;
-        for (int i = 0; i < nBlockXSize * nBlockYSize; ++i)
+        std::fill(dest, dest + nBlockXSize * nBlockYSize, 0.0);
+        facts::SolarPosition sun(jday, daytime);
+        for (int iy = 0; iy < nBlockYSize; ++iy)
         {
-            // Just the solar zenith angle
-            dest[i] = facts::cos_sol_za(jday, daytime, lats[i], lons[i]);
-            // Normalise outliars
-            switch (fpclassify(dest[i]))
+            int first = iy * nBlockXSize + spans[iy].begin;
+            int last = iy * nBlockXSize + spans[iy].end;
+            sun.cos_sol_za(last - first, lats.data() + first, lons.data() + first, dest + first);
+            for (int i = first; i < last; ++i)
             {
-                case FP_NAN:
-                case FP_SUBNORMAL:
-                case FP_ZERO: dest[i] = 0.0; break;
-                case FP_INFINITE:
-                case FP_NORMAL:
-                    if (dest[i] < 0.0) dest[i] = 0.0;
-                    if (dest[i] > 1.0) dest[i] = 1.0;
-                    break;
+                // Normalise outliars
+                switch (fpclassify(dest[i]))
+                {
+                    case FP_NAN:
+                    case FP_SUBNORMAL:
+                    case FP_ZERO: dest[i] = 0.0; break;
+                    case FP_INFINITE:
+                    case FP_NORMAL:
+                        if (dest[i] < 0.0) dest[i] = 0.0;
+                        if (dest[i] > 1.0) dest[i] = 1.0;
+                        break;
+                }
             }
         }
 
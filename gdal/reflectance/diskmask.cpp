@@ -0,0 +1,88 @@
+#include "diskmask.h"
+#include <msat/gdal/dataset.h>
+#include <msat/utils/geos.h>
+#include <algorithm>
+#include <cstring>
+#include <cstdint>
+
+using namespace std;
+
+namespace msat {
+namespace utils {
+
+DiskSpans::DiskSpans(GDALDataset* ds)
+    : width(ds->GetRasterXSize()), height(ds->GetRasterYSize()), lines(height)
+{
+    double gt[6];
+    bool have_gt = ds->GetGeoTransform(gt) == CE_None;
+    const char* projname = ds->GetProjectionRef();
+
+    GeosProjection geos;
+    if (have_gt && gt[1] != 0 && gt[2] == 0 && gt[4] == 0
+            && projname && projname[0] && dataset::geosFromWKT(projname, geos))
+    {
+        for (int y = 0; y < height; ++y)
+            geos.line_span(gt, y, width, lines[y].begin, lines[y].end);
+    } else {
+        for (auto& l: lines)
+            l.end = width;
+    }
+}
+
+void DiskSpans::intersect(int y, int begin, int end)
+{
+    Span& l = lines[y];
+    l.begin = max(l.begin, begin);
+    l.end = min(l.end, end);
+    if (l.begin >= l.end)
+        l.begin = l.end = 0;
+}
+
+void DiskSpans::clip(int x, int y, int sx, int sy, Span* out) const
+{
+    for (int iy = 0; iy < sy; ++iy)
+    {
+        Span& o = out[iy];
+        if (y + iy < 0 || y + iy >= height)
+        {
+            o.begin = o.end = 0;
+            continue;
+        }
+        const Span& l = lines[y + iy];
+        o.begin = max(l.begin, x) - x;
+        o.end = min(l.end, x + sx) - x;
+        if (o.begin >= o.end)
+            o.begin = o.end = 0;
+    }
+}
+
+
+DiskMaskRasterBand::DiskMaskRasterBand(GDALDataset* ds, int block_x, int block_y)
+    : spans(ds)
+{
+    poDS = ds;
+    nBand = 0;
+    nRasterXSize = ds->GetRasterXSize();
+    nRasterYSize = ds->GetRasterYSize();
+    eDataType = GDT_Byte;
+    nBlockXSize = block_x;
+    nBlockYSize = block_y;
+}
+
+CPLErr DiskMaskRasterBand::IReadBlock(int xblock, int yblock, void *buf)
+{
+    vector<Span> block_spans(nBlockYSize);
+    spans.clip(xblock * nBlockXSize, yblock * nBlockYSize, nBlockXSize, nBlockYSize, block_spans.data());
+
+    uint8_t* dest = (uint8_t*)buf;
+    memset(dest, 0, (size_t)nBlockXSize * nBlockYSize);
+    for (int iy = 0; iy < nBlockYSize; ++iy)
+    {
+        const Span& s = block_spans[iy];
+        memset(dest + (size_t)iy * nBlockXSize + s.begin, 255, s.end - s.begin);
+    }
+    return CE_None;
+}
+
+}
+}
@@ -0,0 +1,70 @@
+#ifndef MSAT_GDALDRIVER_REFLECTANCE_DISKMASK_H
+#define MSAT_GDALDRIVER_REFLECTANCE_DISKMASK_H
+
+#include <gdal/gdal_priv.h>
+#include <vector>
+
+namespace msat {
+namespace utils {
+
+/// Columns [begin, end) of a raster line
+struct Span
+{
+    int begin = 0;
+    int end = 0;
+
+    bool empty() const { return begin >= end; }
+};
+
+/**
+ * Columns of each line of a raster that are on the Earth disk.
+ *
+ * Rasters that are not in a geostationary projection, or that have a rotated
+ * geotransform, are taken to be on the disk everywhere.
+ */
+class DiskSpans
+{
+public:
+    const int width;
+    const int height;
+
+    DiskSpans(GDALDataset* ds);
+
+    /// Span of line \a y, which must be inside the raster
+    const Span& line(int y) const { return lines[y]; }
+
+    /**
+     * Restrict line \a y, which must be inside the raster, to columns
+     * [begin, end), such as the part of the line that has data
+     */
+    void intersect(int y, int begin, int end);
+
+    /**
+     * Fill \a out with the spans of lines [y, y+sy) clipped to columns
+     * [x, x+sx), with columns counted from \a x.
+     *
+     * Lines outside the raster get empty spans.
+     */
+    void clip(int x, int y, int sx, int sy, Span* out) const;
+
+protected:
+    std::vector<Span> lines;
+};
+
+/**
+ * Mask band with 255 for the pixels on the Earth disk and 0 for those in
+ * space, shared by all the bands of a dataset.
+ */
+class DiskMaskRasterBand : public GDALRasterBand
+{
+public:
+    DiskSpans spans;
+
+    DiskMaskRasterBand(GDALDataset* ds, int block_x, int block_y);
+
+    CPLErr IReadBlock(int xblock, int yblock, void *buf) override;
+};
+
+}
+}
+#endif
@@ -1,64 +1,600 @@
 #include "pixeltolatlon.h"
+#include <msat/gdal/dataset.h>
+#include <msat/facts.h>
 #include <stdexcept>
+#include <system_error>
+#include <limits>
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <set>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 using namespace std;
 
 namespace msat {
 namespace utils {
 
-PixelToLatlon::PixelToLatlon(GDALDataset* ds)
+namespace {
+
+const char grid_magic[8] = { 'M', 'S', 'A', 'T', 'G', 'E', 'O', '2' };
+const char grid_suffix[] = ".latlon";
+
+void append_u64(std::string& buf, uint64_t val)
+{
+    buf.append((const char*)&val, sizeof(val));
+}
+
+/// Process-wide list of the grids in use
+struct GridCache
+{
+    std::mutex mutex;
+    std::list<std::weak_ptr<LatlonGrid>> entries;
+    /// Keys of the grids being created, loaded or saved by some thread
+    std::set<std::string> loading;
+    /// Notified when a key is removed from loading
+    std::condition_variable load_done;
+    LatlonGrid::Stats stats;
+    /// Bytes of stripes stored by all grids
+    std::atomic<size_t> stored_bytes{0};
+
+    /// Charge \a bytes to LatlonGrid::max_bytes, returning false if they do not fit
+    bool reserve(size_t bytes)
+    {
+        size_t cur = stored_bytes.load();
+        do {
+            if (cur + bytes > LatlonGrid::max_bytes)
+                return false;
+        } while (!stored_bytes.compare_exchange_weak(cur, cur + bytes));
+        return true;
+    }
+
+    /// Give back \a bytes charged with reserve()
+    void release(size_t bytes)
+    {
+        stored_bytes -= bytes;
+    }
+
+    static GridCache& instance()
+    {
+        static GridCache cache;
+        return cache;
+    }
+};
+
+/// Write all of \a buf to \a out at \a offset
+void pwrite_all(sys::File& out, const void* buf, size_t size, off_t offset)
+{
+    for (size_t done = 0; done < size; )
+        done += out.pwrite((const char*)buf + done, size - done, offset + done);
+}
+
+std::string grid_name(const std::string& dir, const std::string& key)
+{
+    // 64 bit FNV-1a hash of the georeferencing
+    uint64_t hash = 14695981039346656037ull;
+    for (unsigned char c: key)
+    {
+        hash ^= c;
+        hash *= 1099511628211ull;
+    }
+    char buf[17];
+    snprintf(buf, 17, "%016llx", (unsigned long long)hash);
+    return dir + "/" + buf + grid_suffix;
+}
+
+}
+
+LatlonGrid::LatlonGrid(GDALDataset* ds, const std::string& key)
+    : key(key), width(ds->GetRasterXSize()), height(ds->GetRasterYSize()), spans(ds),
+      stripes((height + stripe_lines - 1) / stripe_lines), sat_za_stripes(stripes.size()),
+      mapping(MAP_FAILED, 0)
 {
-    if (ds->GetGeoTransform(geoTransform) != CE_None)
+    if (ds->GetGeoTransform(geotransform) != CE_None)
         throw std::runtime_error("no geotransform found in input dataset");
 
     const char* projname = ds->GetProjectionRef();
     if (!projname || !projname[0])
         throw std::runtime_error("no projection name found in input dataset");
 
+    // Geostationary projections are computed in closed form
+    use_geos = dataset::geosFromWKT(projname, geos);
+    if (use_geos) return;
+
     proj = new OGRSpatialReference(projname);
     latlon = proj->CloneGeogCS();
     toLatLon = OGRCreateCoordinateTransformation(proj, latlon);
 }
 
-PixelToLatlon::~PixelToLatlon()
+LatlonGrid::~LatlonGrid()
 {
+    GridCache::instance().release(stored_bytes);
     delete proj;
     delete latlon;
     delete toLatLon;
 }
 
-void PixelToLatlon::compute(int x, int y, int sx, int sy, double* lats, double* lons)
+void LatlonGrid::compute(int x, int y, int sx, int sy, double* lats, double* lons, size_t stride)
+{
+    if (use_geos)
+    {
+        // Only compute the pixels on the disk
+        for (int iy = 0; iy < sy; ++iy)
+        {
+            double* dlats = lats + iy * stride;
+            double* dlons = lons + iy * stride;
+            std::fill(dlats, dlats + sx, std::numeric_limits<double>::quiet_NaN());
+            std::fill(dlons, dlons + sx, std::numeric_limits<double>::quiet_NaN());
+            const Span& span = spans.line(y + iy);
+            int begin = max(span.begin, x);
+            int end = min(span.end, x + sx);
+            if (begin >= end) continue;
+            geos.pixels_to_latlon(geotransform, begin, y + iy, end - begin,
+                    dlats + (begin - x), dlons + (begin - x));
+        }
+    } else {
+        // Pixels to projected coordinates
+        vector<double> plats((size_t)sx * sy);
+        vector<double> plons((size_t)sx * sy);
+        size_t idx = 0;
+        for (int iy = y; iy < y + sy; ++iy)
+            for (int ix = x; ix < x + sx; ++ix, ++idx)
+            {
+                // Projected y
+                plats[idx] = geotransform[3]
+                    + geotransform[4] * ix
+                    + geotransform[5] * iy;
+
+                // Projected x
+                plons[idx] = geotransform[0]
+                    + geotransform[1] * ix
+                    + geotransform[2] * iy;
+            }
+
+        // Projected coordinates to latlon. Ignore errors, since there
+        // usually are points in space that fail to transform
+        {
+            lock_guard<std::mutex> lock(transform_mutex);
+            toLatLon->Transform(idx, plons.data(), plats.data());
+        }
+
+        for (int iy = 0; iy < sy; ++iy)
+        {
+            std::copy(plats.begin() + (size_t)iy * sx, plats.begin() + (size_t)(iy + 1) * sx, lats + iy * stride);
+            std::copy(plons.begin() + (size_t)iy * sx, plons.begin() + (size_t)(iy + 1) * sx, lons + iy * stride);
+        }
+    }
+
+    // Give the same values whether or not the stripe is stored
+    for (int iy = 0; iy < sy; ++iy)
+        for (int ix = 0; ix < sx; ++ix)
+        {
+            lats[iy * stride + ix] = (float)lats[iy * stride + ix];
+            lons[iy * stride + ix] = (float)lons[iy * stride + ix];
+        }
+}
+
+const float* LatlonGrid::stripe(int idx)
+{
+    if (stripes[idx]) return stripes[idx].get();
+
+    int first = idx * stripe_lines;
+    int count = min(stripe_lines, height - first);
+    size_t size = (size_t)width * count;
+    if (!GridCache::instance().reserve(size * 2 * sizeof(float)))
+        return nullptr;
+    stored_bytes += size * 2 * sizeof(float);
+
+    vector<double> plats(size);
+    vector<double> plons(size);
+    compute(0, first, width, count, plats.data(), plons.data(), width);
+
+    float* dest = new float[size * 2];
+    for (size_t i = 0; i < size; ++i)
+    {
+        dest[i] = plats[i];
+        dest[size + i] = plons[i];
+    }
+    stripes[idx].reset(dest);
+    return dest;
+}
+
+void LatlonGrid::compute_sat_za(int x, int y, int sx, int sy, const double* lats, const double* lons, double* sat_za, size_t stride) const
+{
+    for (int iy = 0; iy < sy; ++iy)
+    {
+        double* dest = sat_za + iy * stride;
+        std::fill(dest, dest + sx, std::numeric_limits<double>::quiet_NaN());
+        const Span& span = spans.line(y + iy);
+        for (int ix = max(span.begin, x); ix < min(span.end, x + sx); ++ix)
+            dest[ix - x] = facts::sat_za(lats[iy * stride + ix - x], lons[iy * stride + ix - x]);
+    }
+}
+
+const float* LatlonGrid::sat_za_stripe(int idx)
+{
+    if (sat_za_stripes[idx]) return sat_za_stripes[idx].get();
+
+    int first = idx * stripe_lines;
+    int count = min(stripe_lines, height - first);
+    size_t size = (size_t)width * count;
+    if (!GridCache::instance().reserve(size * sizeof(float)))
+        return nullptr;
+    stored_bytes += size * sizeof(float);
+
+    // Computed from the coordinates as read() returns them
+    vector<double> plats(size);
+    vector<double> plons(size);
+    if (const float* coords = stripe(idx))
+    {
+        std::copy(coords, coords + size, plats.begin());
+        std::copy(coords + size, coords + size * 2, plons.begin());
+    } else
+        compute(0, first, width, count, plats.data(), plons.data(), width);
+    vector<double> psat_za(size);
+    compute_sat_za(0, first, width, count, plats.data(), plons.data(), psat_za.data(), width);
+
+    float* dest = new float[size];
+    std::copy(psat_za.begin(), psat_za.end(), dest);
+    sat_za_stripes[idx].reset(dest);
+    return dest;
+}
+
+void LatlonGrid::read(int x, int y, int sx, int sy, double* lats, double* lons, size_t stride)
+{
+    if (this->lats)
+    {
+        // Mapped from a grid file
+        for (int iy = 0; iy < sy; ++iy)
+        {
+            const float* slats = this->lats + (size_t)(y + iy) * width + x;
+            const float* slons = this->lons + (size_t)(y + iy) * width + x;
+            std::copy(slats, slats + sx, lats + iy * stride);
+            std::copy(slons, slons + sx, lons + iy * stride);
+        }
+        return;
+    }
+
+    for (int first = y; first < y + sy; )
+    {
+        int idx = first / stripe_lines;
+        int last = min(y + sy, (idx + 1) * stripe_lines);
+        const float* data;
+        {
+            lock_guard<std::mutex> lock(mutex);
+            data = stripe(idx);
+        }
+        double* dlats = lats + (first - y) * stride;
+        double* dlons = lons + (first - y) * stride;
+        if (data)
+        {
+            // Stripes are only freed with the grid
+            size_t size = (size_t)width * min(stripe_lines, height - idx * stripe_lines);
+            for (int iy = first; iy < last; ++iy)
+            {
+                const float* slats = data + (size_t)(iy - idx * stripe_lines) * width + x;
+                const float* slons = slats + size;
+                std::copy(slats, slats + sx, dlats + (iy - first) * stride);
+                std::copy(slons, slons + sx, dlons + (iy - first) * stride);
+            }
+        } else
+            compute(x, first, sx, last - first, dlats, dlons, stride);
+        first = last;
+    }
+}
+
+void LatlonGrid::read_sat_za(int x, int y, int sx, int sy, double* sat_za, size_t stride)
+{
+    if (sat_zas)
+    {
+        // Mapped from a grid file
+        for (int iy = 0; iy < sy; ++iy)
+        {
+            const float* src = sat_zas + (size_t)(y + iy) * width + x;
+            std::copy(src, src + sx, sat_za + iy * stride);
+        }
+        return;
+    }
+
+    vector<double> plats;
+    vector<double> plons;
+    vector<double> psat_za;
+    for (int first = y; first < y + sy; )
+    {
+        int idx = first / stripe_lines;
+        int last = min(y + sy, (idx + 1) * stripe_lines);
+        const float* data;
+        {
+            lock_guard<std::mutex> lock(mutex);
+            data = sat_za_stripe(idx);
+        }
+        double* dest = sat_za + (first - y) * stride;
+        if (data)
+        {
+            for (int iy = first; iy < last; ++iy)
+            {
+                const float* src = data + (size_t)(iy - idx * stripe_lines) * width + x;
+                std::copy(src, src + sx, dest + (iy - first) * stride);
+            }
+        } else {
+            size_t size = (size_t)sx * (last - first);
+            plats.resize(size);
+            plons.resize(size);
+            psat_za.resize(size);
+            read(x, first, sx, last - first, plats.data(), plons.data(), sx);
+            compute_sat_za(x, first, sx, last - first, plats.data(), plons.data(), psat_za.data(), sx);
+            // Round like the stored values
+            for (int iy = 0; iy < last - first; ++iy)
+                for (int ix = 0; ix < sx; ++ix)
+                    dest[iy * stride + ix] = (float)psat_za[(size_t)iy * sx + ix];
+        }
+        first = last;
+    }
+}
+
+std::string LatlonGrid::file_header() const
+{
+    // Header fields are in host byte order: the cache is local to the machine
+    std::string res(grid_magic, sizeof(grid_magic));
+    append_u64(res, width);
+    append_u64(res, height);
+    append_u64(res, key.size());
+    res += key;
+    // Keep the values aligned
+    res.resize((res.size() + 7) / 8 * 8, 0);
+    return res;
+}
+
+bool LatlonGrid::load(const std::string& pathname)
+{
+    std::string header = file_header();
+    size_t size = header.size() + (size_t)width * height * 3 * sizeof(float);
+
+    // The file must exist, describe the same georeferencing and be complete
+    sys::File in(pathname);
+    if (!in.open_ifexists(O_RDONLY))
+        return false;
+    struct stat st;
+    in.fstat(st);
+    if ((size_t)st.st_size != size)
+        return false;
+    std::vector<char> buf(header.size());
+    if (in.pread(buf.data(), buf.size(), 0) != buf.size()
+            || memcmp(buf.data(), header.data(), buf.size()) != 0)
+        return false;
+
+    mapping = in.mmap(size, PROT_READ, MAP_SHARED);
+    const float* base = (const float*)((const char*)mapping + header.size());
+    lock_guard<std::mutex> lock(mutex);
+    for (auto& s: stripes)
+        s.reset();
+    for (auto& s: sat_za_stripes)
+        s.reset();
+    GridCache::instance().release(stored_bytes);
+    stored_bytes = 0;
+    lats = base;
+    lons = base + (size_t)width * height;
+    sat_zas = base + (size_t)width * height * 2;
+    return true;
+}
+
+void LatlonGrid::write(const std::string& pathname)
+{
+    std::string header = file_header();
+    size_t count = (size_t)width * height;
+
+    // Write to a temporary file and rename it in place, so that readers only
+    // ever see complete grids
+    sys::File out = sys::File::mkstemp(pathname);
+    try {
+        out.write_all_or_retry(header.data(), header.size());
+
+        // Fill the three layers a stripe at a time
+        vector<double> plats((size_t)width * stripe_lines);
+        vector<double> plons((size_t)width * stripe_lines);
+        vector<double> psat_za((size_t)width * stripe_lines);
+        vector<float> buf((size_t)width * stripe_lines);
+        for (int first = 0; first < height; first += stripe_lines)
+        {
+            int lines = min(stripe_lines, height - first);
+            size_t size = (size_t)width * lines;
+            off_t offset = header.size() + (size_t)first * width * sizeof(float);
+            read(0, first, width, lines, plats.data(), plons.data(), width);
+            read_sat_za(0, first, width, lines, psat_za.data(), width);
+            for (const vector<double>* layer: { &plats, &plons, &psat_za })
+            {
+                std::copy(layer->begin(), layer->begin() + size, buf.begin());
+                pwrite_all(out, buf.data(), size * sizeof(float), offset);
+                offset += count * sizeof(float);
+            }
+        }
+
+        out.fchmod(0644);
+        out.close();
+        if (::rename(out.name().c_str(), pathname.c_str()) < 0)
+            throw std::system_error(errno, std::system_category(), "cannot rename " + out.name() + " to " + pathname);
+    } catch (...) {
+        sys::unlink_ifexists(out.name());
+        throw;
+    }
+}
+
+std::string LatlonGrid::make_key(GDALDataset* ds)
+{
+    double gt[6];
+    if (ds->GetGeoTransform(gt) != CE_None)
+        throw std::runtime_error("no geotransform found in input dataset");
+
+    const char* projname = ds->GetProjectionRef();
+    if (!projname || !projname[0])
+        throw std::runtime_error("no projection name found in input dataset");
+
+    // The projection includes the sub-satellite longitude
+    std::string res(projname);
+    char buf[512];
+    snprintf(buf, 512, "\n%.17g %.17g %.17g %.17g %.17g %.17g\n%dx%d",
+            gt[0], gt[1], gt[2], gt[3], gt[4], gt[5],
+            ds->GetRasterXSize(), ds->GetRasterYSize());
+    return res + buf;
+}
+
+std::shared_ptr<LatlonGrid> LatlonGrid::get(GDALDataset* ds)
 {
-    int idx = 0;
+    std::string key = make_key(ds);
+    const char* dir = CPLGetConfigOption("MSAT_LATLON_CACHE", nullptr);
+    if (dir && !dir[0]) dir = nullptr;
 
-    // Pixels to projected coordinates
-    for (int iy = y; iy < y + sy; ++iy)
+    // The grid file is an optimization: do without it if it cannot be used
+    std::string pathname;
+    if (dir)
     {
-        for (int ix = x; ix < x + sx; ++ix)
+        try {
+            sys::makedirs(dir);
+            pathname = grid_name(sys::abspath(dir), key);
+        } catch (std::exception& e) {
+            CPLError(CE_Warning, CPLE_AppDefined, "cannot use latlon cache %s: %s", dir, e.what());
+        }
+    }
+
+    GridCache& cache = GridCache::instance();
+    unique_lock<std::mutex> lock(cache.mutex);
+
+    // Wait for other threads setting up the same grid, so that bands opened
+    // at the same time in different threads share it
+    cache.load_done.wait(lock, [&] { return cache.loading.find(key) == cache.loading.end(); });
+
+    std::shared_ptr<LatlonGrid> res;
+    for (auto i = cache.entries.begin(); i != cache.entries.end(); )
+    {
+        std::shared_ptr<LatlonGrid> grid = i->lock();
+        if (!grid)
+        {
+            // The last user of the grid has gone
+            i = cache.entries.erase(i);
+            continue;
+        }
+        if (grid->key == key)
         {
-            // Projected y
-            lats[idx] = geoTransform[3]
-                + geoTransform[4] * ix
-                + geoTransform[5] * iy;
+            res = grid;
+            break;
+        }
+        ++i;
+    }
 
-            // Projected x
-            lons[idx] = geoTransform[0]
-                + geoTransform[1] * ix
-                + geoTransform[2] * iy;
+    if (res)
+    {
+        ++cache.stats.hits;
+        if (pathname.empty() || res->pathname == pathname)
+            return res;
+    } else
+        ++cache.stats.misses;
 
-            ++idx;
+    // Create, load or save the grid without holding the lock, so that other
+    // grids can be used meanwhile
+    cache.loading.insert(key);
+    lock.unlock();
+    bool created = !res;
+    bool loaded = false;
+    try {
+        if (created)
+            res = make_shared<LatlonGrid>(ds, key);
+        if (!pathname.empty())
+        {
+            try {
+                // A grid already in use can only be saved: replacing its
+                // values with the mapped ones would pull them from under its
+                // readers
+                if (res.use_count() == 1 && res->load(pathname))
+                    loaded = true;
+                else
+                    res->write(pathname);
+                res->pathname = pathname;
+            } catch (std::exception& e) {
+                CPLError(CE_Warning, CPLE_AppDefined, "cannot use latlon cache %s: %s", dir, e.what());
+            }
         }
+    } catch (...) {
+        lock.lock();
+        cache.loading.erase(key);
+        cache.load_done.notify_all();
+        throw;
     }
+    lock.lock();
+    if (created)
+        cache.entries.push_back(res);
+    if (loaded)
+        ++cache.stats.loaded;
+    cache.loading.erase(key);
+    cache.load_done.notify_all();
+    return res;
+}
+
+LatlonGrid::Stats LatlonGrid::stats()
+{
+    GridCache& cache = GridCache::instance();
+    lock_guard<std::mutex> lock(cache.mutex);
+    Stats res = cache.stats;
+    res.bytes = cache.stored_bytes;
+    return res;
+}
+
+void LatlonGrid::clear()
+{
+    GridCache& cache = GridCache::instance();
+    lock_guard<std::mutex> lock(cache.mutex);
+    cache.entries.clear();
+    cache.stats = Stats();
+}
 
-    // Projected coordinates to latlon
-    toLatLon->Transform(sx * sy, lons, lats);
-    // Ignore errors, since there usually are points in space that fail to
-    // transform
 
-    // if (!toLatLon->Transform(sx * sy, lons, lats))
-    // {
-    //     throw std::runtime_error("points failed to transform to lat,lon");
-    // }
+PixelToLatlon::PixelToLatlon(GDALDataset* ds)
+    : grid(LatlonGrid::get(ds))
+{
+}
+
+void PixelToLatlon::compute(int x, int y, int sx, int sy, double* lats, double* lons)
+{
+    // Blocks on the right and bottom edges can extend past the raster
+    int x0 = max(x, 0);
+    int y0 = max(y, 0);
+    int x1 = min(x + sx, grid->width);
+    int y1 = min(y + sy, grid->height);
+    if (x1 - x0 != sx || y1 - y0 != sy)
+        for (int i = 0; i < sx * sy; ++i)
+            lats[i] = lons[i] = std::numeric_limits<double>::quiet_NaN();
+    if (x0 >= x1 || y0 >= y1)
+        return;
+
+    size_t offset = (size_t)(y0 - y) * sx + (x0 - x);
+    grid->read(x0, y0, x1 - x0, y1 - y0, lats + offset, lons + offset, sx);
+}
+
+void PixelToLatlon::compute_sat_za(int x, int y, int sx, int sy, double* sat_za)
+{
+    // Blocks on the right and bottom edges can extend past the raster
+    int x0 = max(x, 0);
+    int y0 = max(y, 0);
+    int x1 = min(x + sx, grid->width);
+    int y1 = min(y + sy, grid->height);
+    if (x1 - x0 != sx || y1 - y0 != sy)
+        for (int i = 0; i < sx * sy; ++i)
+            sat_za[i] = std::numeric_limits<double>::quiet_NaN();
+    if (x0 >= x1 || y0 >= y1)
+        return;
+
+    size_t offset = (size_t)(y0 - y) * sx + (x0 - x);
+    grid->read_sat_za(x0, y0, x1 - x0, y1 - y0, sat_za + offset, sx);
+}
+
+void PixelToLatlon::spans(int x, int y, int sx, int sy, Span* out) const
+{
+    grid->spans.clip(x, y, sx, sy, out);
 }
 
 }
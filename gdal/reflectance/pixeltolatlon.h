@@ -1,23 +1,181 @@
 #ifndef MSAT_GDALDRIVER_REFLECTANCE_PIXELTOLATLON_H
 #define MSAT_GDALDRIVER_REFLECTANCE_PIXELTOLATLON_H
 
+#include "diskmask.h"
+#include <msat/utils/sys.h>
+#include <msat/utils/geos.h>
 #include <gdal/gdal_priv.h>
 #include <ogr_spatialref.h>
+#include <string>
+#include <vector>
+#include <list>
+#include <memory>
+#include <mutex>
 
 namespace msat {
 namespace utils {
 
-struct PixelToLatlon
+/**
+ * Latitudes, longitudes and satellite zenith angles of all the pixels of a
+ * raster, stored as float32.
+ *
+ * Grids are shared by all the open rasters with the same projection,
+ * geotransform and size, which in MSG images are the same for all channels
+ * and all slots, and are freed when the last of them is closed.
+ * Each layer is computed in stripes the first time it is needed, and each
+ * stripe is kept in memory as long as all the grids together stay within
+ * max_bytes. Past that, stripes are computed again each time they are read.
+ * The on-disk spans are computed in closed form with the grid, and are not
+ * stored.
+ *
+ * If the MSAT_LATLON_CACHE configuration option names a directory, the whole
+ * grid is computed at once and saved there, and later uses map the saved file
+ * instead of computing it again.
+ */
+class LatlonGrid
 {
-    double geoTransform[6];
+public:
+    /// Number of lines computed at the same time
+    static const int stripe_lines = 64;
+
+    /// Memory that the stripes of all the grids can use together
+    static const size_t max_bytes = 256 * 1024 * 1024;
+
+    struct Stats
+    {
+        /// Number of times a grid was found in memory
+        unsigned hits = 0;
+        /// Number of times a grid had to be created
+        unsigned misses = 0;
+        /// Number of grids loaded from the MSAT_LATLON_CACHE directory
+        unsigned loaded = 0;
+        /// Bytes of stripes currently kept in memory by all grids
+        size_t bytes = 0;
+    };
+
+    /// Georeferencing of the grid, as returned by make_key()
+    const std::string key;
+    const int width;
+    const int height;
+    /// Columns of each line that are on the Earth disk
+    const DiskSpans spans;
+
+    LatlonGrid(GDALDataset* ds, const std::string& key);
+    LatlonGrid(const LatlonGrid&) = delete;
+    ~LatlonGrid();
+    LatlonGrid& operator=(const LatlonGrid&) = delete;
+
+    /**
+     * Copy the coordinates of the pixels in [x, x+sx) × [y, y+sy) to \a lats
+     * and \a lons, which have \a stride elements per line.
+     *
+     * The area must be inside the raster.
+     */
+    void read(int x, int y, int sx, int sy, double* lats, double* lons, size_t stride);
+
+    /// Like read(), for satellite zenith angles
+    void read_sat_za(int x, int y, int sx, int sy, double* sat_za, size_t stride);
+
+    /// Key identifying the projection, geotransform and size of \a ds
+    static std::string make_key(GDALDataset* ds);
+
+    /// Return the grid for \a ds, sharing it with all the datasets with the same georeferencing
+    static std::shared_ptr<LatlonGrid> get(GDALDataset* ds);
+
+    /// Return a copy of the cache statistics
+    static Stats stats();
+
+    /// Stop sharing the grids currently in use, and reset statistics
+    static void clear();
+
+protected:
+    double geotransform[6];
+    /// True if the projection is computed with geos instead of OGR
+    bool use_geos = false;
+    GeosProjection geos;
     OGRSpatialReference* proj = nullptr;
     OGRSpatialReference* latlon = nullptr;
     OGRCoordinateTransformation* toLatLon = nullptr;
 
+    /**
+     * Computed coordinates of each stripe, latitudes then longitudes, or
+     * nullptr if the stripe has not been computed or did not fit in
+     * max_bytes
+     */
+    std::vector<std::unique_ptr<float[]>> stripes;
+    /// Computed satellite zenith angles of each stripe, like stripes
+    std::vector<std::unique_ptr<float[]>> sat_za_stripes;
+    /// Bytes of stripes charged to max_bytes by this grid
+    size_t stored_bytes = 0;
+    /// Mapped grid file, if loaded from MSAT_LATLON_CACHE
+    sys::MMap mapping;
+    /// Mapped values, if loaded from MSAT_LATLON_CACHE
+    const float* lats = nullptr;
+    const float* lons = nullptr;
+    const float* sat_zas = nullptr;
+    /// Grid file the values have been loaded from or saved to
+    std::string pathname;
+
+    /// Protects stripes, sat_za_stripes and the computation of stripes
+    std::mutex mutex;
+    /// Serializes the use of toLatLon, which is not thread safe
+    std::mutex transform_mutex;
+
+    /**
+     * Compute the coordinates of the pixels in [x, x+sx) × [y, y+sy),
+     * rounded to float32 like the stored ones
+     */
+    void compute(int x, int y, int sx, int sy, double* lats, double* lons, size_t stride);
+
+    /**
+     * Return the coordinates of stripe \a idx, computing them if needed, or
+     * nullptr if they do not fit in max_bytes. Must be called with mutex held.
+     */
+    const float* stripe(int idx);
+
+    /**
+     * Compute the satellite zenith angles of the pixels in
+     * [x, x+sx) × [y, y+sy) from their coordinates, which have \a stride
+     * elements per line like \a sat_za
+     */
+    void compute_sat_za(int x, int y, int sx, int sy, const double* lats, const double* lons, double* sat_za, size_t stride) const;
+
+    /// Like stripe(), for satellite zenith angles
+    const float* sat_za_stripe(int idx);
+
+    /// Header of the grid file
+    std::string file_header() const;
+
+    /// Map the grid file \a pathname, returning false if it cannot be used
+    bool load(const std::string& pathname);
+
+    /// Compute the whole grid and save it to \a pathname
+    void write(const std::string& pathname);
+};
+
+/// Compute latitudes and longitudes of blocks of pixels of a dataset
+struct PixelToLatlon
+{
+    std::shared_ptr<LatlonGrid> grid;
+
     PixelToLatlon(GDALDataset* ds);
-    ~PixelToLatlon();
 
+    /**
+     * Fill \a lats and \a lons with the coordinates of the pixels in
+     * [x, x+sx) × [y, y+sy).
+     *
+     * Pixels outside the raster are set to NaN.
+     */
     void compute(int x, int y, int sx, int sy, double* lats, double* lons);
+
+    /// Like compute(), for satellite zenith angles
+    void compute_sat_za(int x, int y, int sx, int sy, double* sat_za);
+
+    /**
+     * Fill \a out with the on-disk spans of the sy lines of the block at
+     * (x, y), with columns counted from x, as in DiskSpans::clip
+     */
+    void spans(int x, int y, int sx, int sy, Span* out) const;
 };
 
 }
@@ -7,6 +7,8 @@
 //#include <msat/hrit/MSG_data_RadiometricProc.h>
 #include <msat/hrit/MSG_channel.h>
 #include <string>
+#include <memory>
+#include <algorithm>
 #include <stdexcept>
 #include <stdint.h>
 
@@ -49,6 +51,31 @@ void ReflectanceDataset::add_source(GDALDataset* ds, bool take_ownership)
 // cos(80deg)
 #define cos80 0.173648178
 
+namespace {
+
+/// Compute the reflectance of a VIS 0.6, VIS 0.8, IR 1.6 or HRV radiance
+inline float single_channel_reflectance(double radiance, double tr, double cossza)
+{
+    // Use cos(80°) as lower bound, to avoid division by zero
+    if (cossza < cos80) cossza = cos80;
+    float res = 100.0 * radiance / tr / cossza;
+    // Normalise outliars
+    switch (fpclassify(res))
+    {
+        case FP_NAN:
+        case FP_SUBNORMAL:
+        case FP_ZERO: res = 0.0; break;
+        case FP_INFINITE:
+        case FP_NORMAL:
+            if (res < 0.0) res = 0.0;
+            if (res > 100.0) res = 100.0;
+            break;
+    }
+    return res;
+}
+
+}
+
 ReflectanceRasterBand::ReflectanceRasterBand(ReflectanceDataset* ds, int idx)
 {
     poDS = ds;
@@ -71,6 +98,32 @@ ReflectanceRasterBand::~ReflectanceRasterBand()
     delete p2ll;
 }
 
+void ReflectanceRasterBand::compute_geometry(int xblock, int yblock, std::vector<Span>& spans,
+        std::vector<double>& lats, std::vector<double>& lons, std::vector<double>& cossza)
+{
+    size_t size = (size_t)nBlockXSize * nBlockYSize;
+    int x = xblock * nBlockXSize;
+    int y = yblock * nBlockYSize;
+
+    spans.resize(nBlockYSize);
+    p2ll->spans(x, y, nBlockXSize, nBlockYSize, spans.data());
+
+    // Precompute pixel georeferentiation
+    lats.resize(size);
+    lons.resize(size);
+    p2ll->compute(x, y, nBlockXSize, nBlockYSize, lats.data(), lons.data());
+
+    // Precompute the cosine of the solar zenith angles, only on the disk
+    cossza.assign(size, 0.0);
+    facts::SolarPosition sun(jday, daytime);
+    for (int iy = 0; iy < nBlockYSize; ++iy)
+    {
+        if (spans[iy].empty()) continue;
+        size_t first = (size_t)iy * nBlockXSize + spans[iy].begin;
+        sun.cos_sol_za(spans[iy].end - spans[iy].begin, lats.data() + first, lons.data() + first, cossza.data() + first);
+    }
+}
+
 const char* ReflectanceRasterBand::GetUnitType()
 {
     return "%";
@@ -95,12 +148,12 @@ double ReflectanceRasterBand::GetNoDataValue(int* pbSuccess)
 }
 
 
-SingleChannelReflectanceRasterBand::SingleChannelReflectanceRasterBand(ReflectanceDataset* ds, int idx)
+SingleChannelReflectanceRasterBand::SingleChannelReflectanceRasterBand(ReflectanceDataset* ds, int idx, int channel_id)
     : ReflectanceRasterBand(ds, idx)
 {
-    source_rb = ds->sources[ds->channel_id - 1];
+    source_rb = ds->sources[channel_id - 1];
     if (!source_rb)
-        throw std::runtime_error("SingleChannelReflectanceRasterBand: GDALRasterBand not found for channel " + std::to_string(ds->channel_id) + " metadata");
+        throw std::runtime_error("SingleChannelReflectanceRasterBand: GDALRasterBand not found for channel " + std::to_string(channel_id) + " metadata");
 
     add_info(source_rb, "SingleChannelReflectanceRasterBand");
 
@@ -113,13 +166,13 @@ SingleChannelReflectanceRasterBand::SingleChannelReflectanceRasterBand(Reflectan
 
     // Compute pre-cached tr factor
     double esd = 1.0 - 0.0167 * cos( 2.0 * M_PI * (jday - 3) / 365.0);
-    switch (ds->channel_id)
+    switch (channel_id)
     {
         case MSG_SEVIRI_1_5_VIS_0_6: tr = 20.76 / (esd*esd); break;
         case MSG_SEVIRI_1_5_VIS_0_8: tr = 23.24 / (esd*esd); break;
         case MSG_SEVIRI_1_5_IR_1_6:  tr = 19.85 / (esd*esd); break;
         case MSG_SEVIRI_1_5_HRV:     tr = 25.11 / (esd*esd); break;
-        default: throw std::runtime_error("SingleChannelReflectanceRasterBand: computing reflectance for channel " + std::to_string(ds->channel_id) + " is not implemented");
+        default: throw std::runtime_error("SingleChannelReflectanceRasterBand: computing reflectance for channel " + std::to_string(channel_id) + " is not implemented");
     }
 }
 
@@ -131,39 +184,91 @@ CPLErr SingleChannelReflectanceRasterBand::IReadBlock(int xblock, int yblock, vo
 {
     // Read the raw data
     std::vector<double> raw(nBlockXSize * nBlockYSize);
-    if (source_rb->RasterIO(GF_Read, xblock * nBlockXSize, yblock * nBlockYSize, nBlockXSize, nBlockYSize, raw.data(), nBlockXSize, nBlockYSize, GDT_Float64, 0, 0) == CE_Failure)
+    if (read_source_block(source_rb, xblock, yblock, raw.data()) == CE_Failure)
         return CE_Failure;
 
-    // Precompute pixel georeferentiation
-    std::vector<double> lats(nBlockXSize * nBlockYSize);
-    std::vector<double> lons(nBlockXSize * nBlockYSize);
-    p2ll->compute(xblock * nBlockXSize, yblock * nBlockYSize, nBlockXSize, nBlockYSize, lats.data(), lons.data());
+    std::vector<Span> spans;
+    std::vector<double> lats, lons, cossza_block;
+    compute_geometry(xblock, yblock, spans, lats, lons, cossza_block);
 
-    // Compute reflectances
+    // Compute reflectances on the disk, leaving space as nodata
     float* dest = (float*)buf;
-    for (int i = 0; i < nBlockXSize * nBlockYSize; ++i)
+    std::fill(dest, dest + nBlockXSize * nBlockYSize, 0.0f);
+    for (int iy = 0; iy < nBlockYSize; ++iy)
+        for (int i = iy * nBlockXSize + spans[iy].begin; i < iy * nBlockXSize + spans[iy].end; ++i)
+            // From counts to radiance to reflectance
+            dest[i] = single_channel_reflectance(raw[i] * rad_slope + rad_offset, tr, cossza_block[i]);
+
+    return CE_None;
+}
+
+CPLErr FusedReflectanceRasterBand::IReadBlock(int xblock, int yblock, void *buf)
+{
+    size_t size = (size_t)nBlockXSize * nBlockYSize;
+
+    // Find the bands that need computing: this one, and the others whose
+    // block is not in the block cache yet
+    std::vector<FusedReflectanceRasterBand*> bands;
+    for (int i = 1; i <= poDS->GetRasterCount(); ++i)
     {
-        // From counts to radiance
-        double radiance = raw[i] * rad_slope + rad_offset;
-        double cossza = facts::cos_sol_za(jday, daytime, lats[i], lons[i]);
-        // Use cos(80°) as lower bound, to avoid division by zero
-        if (cossza < cos80) cossza = cos80;
-        // From radiance to reflectance
-        dest[i] = 100.0 * radiance / tr / cossza;
-        // Normalise outliars
-        switch (fpclassify(dest[i]))
+        FusedReflectanceRasterBand* rb = (FusedReflectanceRasterBand*)poDS->GetRasterBand(i);
+        if (rb != this)
         {
-            case FP_NAN:
-            case FP_SUBNORMAL:
-            case FP_ZERO: dest[i] = 0.0; break;
-            case FP_INFINITE:
-            case FP_NORMAL:
-                if (dest[i] < 0.0) dest[i] = 0.0;
-                if (dest[i] > 100.0) dest[i] = 100.0;
-                break;
+            if (GDALRasterBlock* block = rb->TryGetLockedBlockRef(xblock, yblock))
+            {
+                block->DropLock();
+                continue;
+            }
         }
+        bands.push_back(rb);
     }
 
+    // Read the raw data of all the bands before touching the block cache, so
+    // that a failure does not leave uninitialized blocks in it
+    std::vector<std::vector<double>> raw(bands.size());
+    for (size_t b = 0; b < bands.size(); ++b)
+    {
+        raw[b].resize(size);
+        if (read_source_block(bands[b]->source_rb, xblock, yblock, raw[b].data()) == CE_Failure)
+            return CE_Failure;
+    }
+
+    std::vector<Span> spans;
+    std::vector<double> lats, lons, cossza_block;
+    compute_geometry(xblock, yblock, spans, lats, lons, cossza_block);
+
+    // Compute into buf for this band, and into new cache blocks for the
+    // others
+    std::vector<GDALRasterBlock*> blocks(bands.size(), nullptr);
+    std::vector<float*> dests(bands.size(), nullptr);
+    for (size_t b = 0; b < bands.size(); ++b)
+    {
+        if (bands[b] == this)
+        {
+            dests[b] = (float*)buf;
+            continue;
+        }
+        blocks[b] = bands[b]->GetLockedBlockRef(xblock, yblock, TRUE);
+        if (blocks[b])
+            dests[b] = (float*)blocks[b]->GetDataRef();
+    }
+
+    // Compute reflectances of all bands in one pass on the disk, leaving
+    // space as nodata
+    for (auto dest: dests)
+        if (dest) std::fill(dest, dest + size, 0.0f);
+    for (int iy = 0; iy < nBlockYSize; ++iy)
+        for (size_t i = (size_t)iy * nBlockXSize + spans[iy].begin; i < (size_t)iy * nBlockXSize + spans[iy].end; ++i)
+            for (size_t b = 0; b < bands.size(); ++b)
+            {
+                if (!dests[b]) continue;
+                const FusedReflectanceRasterBand* rb = bands[b];
+                dests[b][i] = single_channel_reflectance(raw[b][i] * rb->rad_slope + rb->rad_offset, rb->tr, cossza_block[i]);
+            }
+
+    for (auto block: blocks)
+        if (block) block->DropLock();
+
     return CE_None;
 }
 
@@ -210,106 +315,43 @@ CPLErr Reflectance39RasterBand::IReadBlock(int xblock, int yblock, void *buf)
 {
     // Read the IR 3.9 data
     std::vector<double> raw039(nBlockXSize * nBlockYSize);
-    if (source_ir039->RasterIO(GF_Read, xblock * nBlockXSize, yblock * nBlockYSize, nBlockXSize, nBlockYSize, raw039.data(), nBlockXSize, nBlockYSize, GDT_Float64, 0, 0) == CE_Failure)
+    if (read_source_block(source_ir039, xblock, yblock, raw039.data()) == CE_Failure)
         return CE_Failure;
 
     // Read the IR_10.8 channel
     std::vector<double> raw108(nBlockXSize * nBlockYSize);
-    if (source_ir108->RasterIO(GF_Read, xblock * nBlockXSize, yblock * nBlockYSize, nBlockXSize, nBlockYSize, raw108.data(), nBlockXSize, nBlockYSize, GDT_Float64, 0, 0) == CE_Failure)
+    if (read_source_block(source_ir108, xblock, yblock, raw108.data()) == CE_Failure)
         return CE_Failure;
 
     // Read the IR_13.4 channel
     std::vector<double> raw134(nBlockXSize * nBlockYSize);
-    if (source_ir134->RasterIO(GF_Read, xblock * nBlockXSize, yblock * nBlockYSize, nBlockXSize, nBlockYSize, raw134.data(), nBlockXSize, nBlockYSize, GDT_Float64, 0, 0) == CE_Failure)
+    if (read_source_block(source_ir134, xblock, yblock, raw134.data()) == CE_Failure)
         return CE_Failure;
 
-    // Precompute pixel georeferentiation
-    std::vector<double> lats(nBlockXSize * nBlockYSize);
-    std::vector<double> lons(nBlockXSize * nBlockYSize);
-    p2ll->compute(xblock * nBlockXSize, yblock * nBlockYSize, nBlockXSize, nBlockYSize, lats.data(), lons.data());
+    std::vector<Span> spans;
+    std::vector<double> lats, lons, cossza_block;
+    compute_geometry(xblock, yblock, spans, lats, lons, cossza_block);
+    std::vector<double> sat_za_block(nBlockXSize * nBlockYSize);
+    p2ll->compute_sat_za(xblock * nBlockXSize, yblock * nBlockYSize, nBlockXSize, nBlockYSize, sat_za_block.data());
 
-    // Based on: [MMKM2010]
-    //   "Cloud-Top Properties of Growing Cumulus prior to Convective Initiation as Measured
-    //   by Meteosat Second Generation. Part II: Use of Visible Reflectance"
-    // by:
-    //   JOHN R. MECIKALSKI AND WAYNE M. MACKENZIE JR.
-    //   Earth Systems Science Center, University of Alabama in Huntsville, Huntsville, Alabama
-    //   MARIANNE KONIG
-    //   European Organisation for the Exploitation of Meteorological Satellites (EUMETSAT), Darmstadt, Germany
-    //   SAM MULLER
-    //   Jupiter’s Call, LLC, Madison, Alabama
-    // published on:
-    //   JOURNAL OF APPLIED METEOROLOGY AND CLIMATOLOGY, VOLUME 49
+    facts::IR039Reflectance ir039(jday);
 
-    // IR 0.39 CO2 corrections and fine tuning from Jan Kanak's work on MSGProc software:
-    //   Jan Kanak - Slovak Hydrometeorological Institute (SHMÚ)
-    //   MSGProc - MSG Processing tools for Windows
-    // http://www.eumetsat.int/Home/Main/AboutEUMETSAT/InternationalRelations/EasternEuropeanandBalkanCountries/SP_2011062115544756?l=en
-
-    const double c1 = 0.0000119104;
-    const double c2 = 1.43877;
-    const double Vc = 2569.094;
-    const double A = 0.9959;
-    const double B = 3.471;
-    double esd = 1.0 - 0.0167 * cos( 2.0 * M_PI * (jday - 3) / 365.0);
-
-    // Compute reflectances
+    // Compute reflectances on the disk, leaving space as nodata
     float* dest = (float*) buf;
-    for (int i = 0; i < nBlockXSize * nBlockYSize; ++i)
-    {
-        // We can compute radiance from counts straight away
-        //double R_tot = (raw039[i] * rad_slope) + rad_offset;
-        // But we use the Brightness Temperature instead, so we can apply CO2
-        // correction
-        double BT039 = raw039[i] * ir039_slope + ir039_offset;
-        double BT108 = raw108[i] * ir108_slope + ir108_offset;
-        double BT134 = raw134[i] * ir134_slope + ir134_offset;
-
-        // Apply CO2 correction to BT039
-        BT039 = pow(pow(BT039, 4)
-                  + pow(BT108, 4)
-                  - pow(BT108 - (BT108 - BT134)/4, 4),
-                  0.25);
-
-        // Apply Planck function to convert the CO2 corrected Brightness
-        // Temperature to Radiance
-        double R_tot = c1 * (Vc*Vc*Vc) / (exp(c2 * Vc / (A * BT039 + B)) - 1) + 0.015;  
-
-        double R39_corr = pow((BT108 - 0.25 * (BT108 - BT134)) / BT108, 4);
-        double R_therm = c1 * (Vc*Vc*Vc) / (exp(c2 * Vc / (A * BT108 + B)) - 1) * R39_corr;
-        double cosTETA = facts::cos_sol_za(jday, daytime, lats[i], lons[i]);
-        // Use cos(80°) as lower bound, to avoid division by zero
-        if (cosTETA < cos80) cosTETA = cos80;
-        double SAT = facts::sat_za(lats[i], lons[i]);
-        // Original from MMKM2010:
-        //double TOARAD = 4.92 / (esd*esd) * cosTETA * exp(-(1-R39_corr)) * exp(-(1-R39_corr) * cosTETA / cos(SAT));
-        // Version from MSGProc:
-        double TOARAD = 4.92 / (esd*esd)
-                      * pow(cosTETA, 0.75)
-                      * exp(-(1-R39_corr) * cosTETA)
-                      * exp(-(1-R39_corr) / cos(SAT));
-        if (R_tot <= R_therm) R_tot = R_therm + 0.0000001;
-        if (TOARAD <= R_therm) TOARAD = R_therm + 0.0000001;
-
-        // Original from MMKM2010
-        //double REFL = 200 * (R_tot - R_therm) / (TOARAD - R_therm);
-        // Version from MSGProc:
-        double REFL = 100 * (R_tot - R_therm) / (TOARAD);
-        dest[i] = REFL;
-
-        // Normalise outliars
-        switch (fpclassify(dest[i]))
+    std::fill(dest, dest + nBlockXSize * nBlockYSize, 0.0f);
+    for (int iy = 0; iy < nBlockYSize; ++iy)
+        for (int i = iy * nBlockXSize + spans[iy].begin; i < iy * nBlockXSize + spans[iy].end; ++i)
         {
-            case FP_NAN:
-            case FP_SUBNORMAL:
-            case FP_ZERO: dest[i] = 0.0; break;
-            case FP_INFINITE:
-            case FP_NORMAL:
-                if (dest[i] < 0.0) dest[i] = 0.0;
-                if (dest[i] > 100.0) dest[i] = 100.0;
-                break;
+            // We can compute radiance from counts straight away
+            //double R_tot = (raw039[i] * rad_slope) + rad_offset;
+            // But we use the Brightness Temperature instead, so we can apply CO2
+            // correction
+            double BT039 = raw039[i] * ir039_slope + ir039_offset;
+            double BT108 = raw108[i] * ir108_slope + ir108_offset;
+            double BT134 = raw134[i] * ir134_slope + ir134_offset;
+
+            dest[i] = ir039.reflectance(BT039, BT108, BT134, cossza_block[i], sat_za_block[i]);
         }
-    }
 
     return CE_None;
 }
@@ -323,7 +365,7 @@ void ReflectanceDataset::init_rasterband()
         case MSG_SEVIRI_1_5_VIS_0_8:
         case MSG_SEVIRI_1_5_IR_1_6:
         case MSG_SEVIRI_1_5_HRV:
-            SetBand(1, new SingleChannelReflectanceRasterBand(this, 1));
+            SetBand(1, new SingleChannelReflectanceRasterBand(this, 1, channel_id));
             return;
         case MSG_SEVIRI_1_5_IR_3_9:
             SetBand(1, new Reflectance39RasterBand(this, 1));
@@ -333,6 +375,38 @@ void ReflectanceDataset::init_rasterband()
     }
 }
 
+FusedReflectanceDataset::FusedReflectanceDataset(const std::vector<int>& channel_ids)
+    : ReflectanceDataset(channel_ids.empty() ? 0 : channel_ids[0]), channel_ids(channel_ids)
+{
+    if (channel_ids.empty())
+        throw std::runtime_error("FusedReflectanceDataset: no channels requested");
+}
+
+void FusedReflectanceDataset::init_rasterbands()
+{
+    int block_x = 0, block_y = 0;
+    for (size_t i = 0; i < channel_ids.size(); ++i)
+    {
+        int id = channel_ids[i];
+        if (id < 1 || (unsigned)id > sources.size())
+            throw std::runtime_error("FusedReflectanceDataset: invalid channel " + std::to_string(id));
+
+        unique_ptr<FusedReflectanceRasterBand> rb(new FusedReflectanceRasterBand(this, i + 1, id));
+
+        // Blocks are computed for all bands at the same time
+        int bx, by;
+        rb->GetBlockSize(&bx, &by);
+        if (i == 0)
+        {
+            block_x = bx;
+            block_y = by;
+        } else if (bx != block_x || by != block_y)
+            throw std::runtime_error("FusedReflectanceDataset: inconsistent block sizes in source raster bands");
+
+        SetBand(i + 1, rb.release());
+    }
+}
+
 namespace {
 template<typename T>
 void compute_reflectance_ir039(void **papoSources, void* pData, int nXSize, int nYSize, GDALDataType eBufType, int nPixelSpace, int nLineSpace)
@@ -344,68 +418,14 @@ void compute_reflectance_ir039(void **papoSources, void* pData, int nXSize, int
     const T* ir108((T*)papoSources[4]);
     const T* ir134((T*)papoSources[5]);
 
-    const double c1 = 0.0000119104;
-    const double c2 = 1.43877;
-    const double Vc = 2569.094;
-    const double A = 0.9959;
-    const double B = 3.471;
-    double esd = 1.0 - 0.0167 * cos( 2.0 * M_PI * ((int)jday[0] - 3) / 365.0);
+    facts::IR039Reflectance ir039_refl((int)jday[0]);
 
     for (int line = 0; line < nYSize; ++line)
         for (int col = 0; col < nXSize; ++col)
         {
             unsigned idx = line * nXSize + col;
 
-            // We can compute radiance from counts straight away
-            //double R_tot = (raw039[i] * rad_slope) + rad_offset;
-            // But we use the Brightness Temperature instead, so we can apply CO2
-            // correction
-            double BT039 = ir039[idx];
-            double BT108 = ir108[idx];
-            double BT134 = ir134[idx];
-            double cosTETA = cos_sol_za[idx];
-            // Use cos(80°) as lower bound, to avoid division by zero
-            if (cosTETA < cos80) cosTETA = cos80;
-            double SAT = sat_za[idx];
-
-            // Apply CO2 correction to BT039
-            BT039 = pow(pow(BT039, 4)
-                      + pow(BT108, 4)
-                      - pow(BT108 - (BT108 - BT134)/4, 4),
-                      0.25);
-
-            // Apply Planck function to convert the CO2 corrected Brightness
-            // Temperature to Radiance
-            double R_tot = c1 * (Vc*Vc*Vc) / (exp(c2 * Vc / (A * BT039 + B)) - 1) + 0.015;
-            double R39_corr = pow((BT108 - 0.25 * (BT108 - BT134)) / BT108, 4);
-            double R_therm = c1 * (Vc*Vc*Vc) / (exp(c2 * Vc / (A * BT108 + B)) - 1) * R39_corr;
-            // Original from MMKM2010:
-            //double TOARAD = 4.92 / (esd*esd) * cosTETA * exp(-(1-R39_corr)) * exp(-(1-R39_corr) * cosTETA / cos(SAT));
-            // Version from MSGProc:
-            double TOARAD = 4.92 / (esd*esd)
-                          * pow(cosTETA, 0.75)
-                          * exp(-(1-R39_corr) * cosTETA)
-                          * exp(-(1-R39_corr) / cos(SAT));
-            if (R_tot <= R_therm) R_tot = R_therm + 0.0000001;
-            if (TOARAD <= R_therm) TOARAD = R_therm + 0.0000001;
-
-            // Original from MMKM2010
-            //double REFL = 200 * (R_tot - R_therm) / (TOARAD - R_therm);
-            // Version from MSGProc:
-            double REFL = 100 * (R_tot - R_therm) / (TOARAD);
-
-            // Normalise outliars
-            switch (fpclassify(REFL))
-            {
-                case FP_NAN:
-                case FP_SUBNORMAL:
-                case FP_ZERO: REFL = 0.0; break;
-                case FP_INFINITE:
-                case FP_NORMAL:
-                    if (REFL < 0.0) REFL = 0.0;
-                    if (REFL > 100.0) REFL = 100.0;
-                    break;
-            }
+            double REFL = ir039_refl.reflectance(ir039[idx], ir108[idx], ir134[idx], cos_sol_za[idx], sat_za[idx]);
 
             GDALCopyWords(&REFL, GDT_Float64, 0,
                     ((GByte *)pData) + nLineSpace * line + col * nPixelSpace,
@@ -3,6 +3,7 @@
 
 #include "base.h"
 #include <memory>
+#include <vector>
 #include <set>
 
 namespace msat {
@@ -47,6 +48,28 @@ public:
     void init_rasterband();
 };
 
+/**
+ * Reflectances of several single channel sources, as the bands of one dataset.
+ *
+ * Reading a block of a band computes the same block of all the bands in one
+ * pass, sharing geolocation and solar angles, and stores the blocks of the
+ * other bands in the GDAL block cache.
+ */
+class FusedReflectanceDataset : public ReflectanceDataset
+{
+public:
+    /// Channels for which we compute reflectance, one per band
+    std::vector<int> channel_ids;
+
+    FusedReflectanceDataset(const std::vector<int>& channel_ids);
+
+    /**
+     * Call after all needed add_source() calls have been made, to create one
+     * reflectance GDALRasterBand for each channel.
+     */
+    void init_rasterbands();
+};
+
 struct PixelToLatlon;
 
 class ReflectanceRasterBand : public ProxyRasterBand
@@ -63,6 +86,14 @@ public:
     ReflectanceRasterBand(ReflectanceDataset* ds, int idx);
     ~ReflectanceRasterBand();
 
+    /**
+     * Compute the on-disk span of each line of block (xblock, yblock), and
+     * latitudes, longitudes and cosines of the solar zenith angle of the
+     * pixels in the spans
+     */
+    void compute_geometry(int xblock, int yblock, std::vector<Span>& spans,
+            std::vector<double>& lats, std::vector<double>& lons, std::vector<double>& cossza);
+
     const char* GetUnitType() override;
     double GetOffset(int* pbSuccess=NULL) override;
     double GetScale(int* pbSuccess=NULL) override;
@@ -83,12 +114,20 @@ public:
     /// Cached offset of the source raster band
     double rad_offset;
 
-    SingleChannelReflectanceRasterBand(ReflectanceDataset* ds, int idx);
+    SingleChannelReflectanceRasterBand(ReflectanceDataset* ds, int idx, int channel_id);
     ~SingleChannelReflectanceRasterBand();
 
     CPLErr IReadBlock(int xblock, int yblock, void *buf) override;
 };
 
+class FusedReflectanceRasterBand : public SingleChannelReflectanceRasterBand
+{
+public:
+    using SingleChannelReflectanceRasterBand::SingleChannelReflectanceRasterBand;
+
+    CPLErr IReadBlock(int xblock, int yblock, void *buf) override;
+};
+
 class Reflectance39RasterBand : public ReflectanceRasterBand
 {
 protected:
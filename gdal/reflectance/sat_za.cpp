@@ -6,6 +6,7 @@
 #include <msat/hrit/MSG_channel.h>
 #include <string>
 #include <stdexcept>
+#include <algorithm>
 #include <stdint.h>
 
 using namespace std;
@@ -38,28 +39,35 @@ public:
 
     CPLErr IReadBlock(int xblock, int yblock, void *buf) override
     {
-        // Precompute pixel georeferentiation
-        std::vector<double> lats(nBlockXSize * nBlockYSize);
-        std::vector<double> lons(nBlockXSize * nBlockYSize);
-        p2ll->compute(xblock * nBlockXSize, yblock * nBlockYSize, nBlockXSize, nBlockYSize, lats.data(), lons.data());
+        std::vector<Span> spans(nBlockYSize);
+        p2ll->spans(xblock * nBlockXSize, yblock * nBlockYSize, nBlockXSize, nBlockYSize, spans.data());
 
-        // Compute satellite zenith angles
+        // Satellite zenith angles do not change between slots, and come
+        // precomputed with the pixel georeferentiation
         double* dest = (double*) buf;
-        for (int i = 0; i < nBlockXSize * nBlockYSize; ++i)
+        p2ll->compute_sat_za(xblock * nBlockXSize, yblock * nBlockYSize, nBlockXSize, nBlockYSize, dest);
+
+        // Normalise the values on the disk, leaving space as 0
+        for (int iy = 0; iy < nBlockYSize; ++iy)
         {
-            // Just the solar zenith angle
-            dest[i] = facts::sat_za(lats[i], lons[i]);
-            // Normalise outliars
-            switch (fpclassify(dest[i]))
+            int first = iy * nBlockXSize + spans[iy].begin;
+            int last = iy * nBlockXSize + spans[iy].end;
+            std::fill(dest + iy * nBlockXSize, dest + first, 0.0);
+            std::fill(dest + last, dest + (iy + 1) * nBlockXSize, 0.0);
+            for (int i = first; i < last; ++i)
             {
-                case FP_NAN:
-                case FP_SUBNORMAL:
-                case FP_ZERO: dest[i] = 0.0; break;
-                case FP_INFINITE:
-                case FP_NORMAL:
-                    if (dest[i] < 0.0) dest[i] = 0.0;
-                    if (dest[i] > 1.0) dest[i] = 1.0;
-                    break;
+                // Normalise outliars
+                switch (fpclassify(dest[i]))
+                {
+                    case FP_NAN:
+                    case FP_SUBNORMAL:
+                    case FP_ZERO: dest[i] = 0.0; break;
+                    case FP_INFINITE:
+                    case FP_NORMAL:
+                        if (dest[i] < 0.0) dest[i] = 0.0;
+                        if (dest[i] > 1.0) dest[i] = 1.0;
+                        break;
+                }
             }
         }
 
@@ -4,6 +4,10 @@
 #include "rasterband.h"
 #include <msat/facts.h>
 #include <msat/hrit/MSG_HRIT.h>
+#include <msat/utils/threadpool.h>
+#include <msat/xrit/diskcache.h>
+#include <cpl_string.h>
+#include <cstring>
 #include <memory>
 
 using namespace std;
@@ -16,6 +20,10 @@ XRITDataset::XRITDataset(const xrit::FileAccess& fa)
 {
 }
 
+XRITDataset::~XRITDataset()
+{
+}
+
 const char* XRITDataset::GetProjectionRef()
 {
     return projWKT.c_str();
@@ -27,17 +35,111 @@ CPLErr XRITDataset::GetGeoTransform(double* tr)
     return CE_None;
 }
 
-bool XRITDataset::init()
+utils::DiskMaskRasterBand* XRITDataset::get_disk_mask(int block_x, int block_y)
 {
-    char buf[25];
+    if (!disk_mask)
+    {
+        disk_mask.reset(new utils::DiskMaskRasterBand(this, block_x, block_y));
+
+        // Only the columns scanned in each line have data: for HRV they are
+        // a window narrower than the disk, which moves along the image
+        const xrit::DataAccess& da = ((XRITRasterBand*)GetRasterBand(1))->da;
+        for (int y = 0; y < nRasterYSize; ++y)
+        {
+            size_t start = da.line_start(y);
+            disk_mask->spans.intersect(y, start, start + da.columns);
+        }
+    }
+    return disk_mask.get();
+}
+
+const char* XRITDataset::get_option(char** open_options, const char* name)
+{
+    const char* res = CSLFetchNameValue(open_options, name);
+    if (res) return res;
+    return CPLGetConfigOption(name, nullptr);
+}
+
+std::vector<std::string> XRITDataset::slot_channels(const xrit::FileAccess& fa)
+{
+    static const char* names[] = {
+        "VIS006", "VIS008", "IR_016", "IR_039", "WV_062", "WV_073",
+        "IR_087", "IR_097", "IR_108", "IR_120", "IR_134",
+    };
+    vector<string> res;
+    for (const char* name : names)
+    {
+        try {
+            FileAccess(fa, name).segmentFiles();
+        } catch (std::runtime_error&) {
+            continue;
+        }
+        res.push_back(name);
+    }
+    return res;
+}
 
-    // Scan segment headers
-    MSG_data PRO_data;
-    MSG_data EPI_data;
-    MSG_header header;
-    da.scan(fa, PRO_data, EPI_data, header);
+bool XRITDataset::init_data_access(xrit::DataAccess& da, char** open_options)
+{
+    // Number of threads used to decode segments
+    if (const char* val = get_option(open_options, "MSAT_XRIT_THREADS"))
+        da.threads = utils::ThreadPool::parse_count(val);
+
+    // Number of segments decoded in background on sequential reads
+    da.readahead = 1;
+    if (const char* val = get_option(open_options, "MSAT_XRIT_READAHEAD"))
+        da.readahead = atoi(val) > 0 ? atoi(val) : 0;
+
+    // Memory budget of the segment cache, in megabytes
+    if (const char* val = get_option(open_options, "MSAT_XRIT_CACHE_SIZE"))
+    {
+        long mb = strtol(val, nullptr, 10);
+        if (mb < 0)
+        {
+            CPLError(CE_Failure, CPLE_AppDefined, "invalid MSAT_XRIT_CACHE_SIZE value '%s'", val);
+            return false;
+        }
+        da.segcache.set_budget((size_t)mb * 1024 * 1024);
+    }
+
+    // Read uncompressed segments via mmap
+    if (const char* val = get_option(open_options, "MSAT_XRIT_MMAP"))
+        da.use_mmap = CSLTestBoolean(val);
+
+    // Directory of decoded segments shared with other processes
+    if (const char* dir = get_option(open_options, "MSAT_XRIT_DISK_CACHE"))
+    {
+        size_t budget = DiskCache::default_budget;
+        if (const char* val = get_option(open_options, "MSAT_XRIT_DISK_CACHE_SIZE"))
+        {
+            long mb = strtol(val, nullptr, 10);
+            if (mb < 0)
+            {
+                CPLError(CE_Failure, CPLE_AppDefined, "invalid MSAT_XRIT_DISK_CACHE_SIZE value '%s'", val);
+                return false;
+            }
+            budget = (size_t)mb * 1024 * 1024;
+        }
+        // The disk cache is an optimization: do without it if it cannot be used
+        try {
+            da.diskcache.reset(new DiskCache(dir, budget));
+        } catch (std::exception& e) {
+            CPLError(CE_Warning, CPLE_AppDefined, "cannot use disk cache %s: %s", dir, e.what());
+        }
+    }
+
+    // Allow opening a repeat cycle that is still being received
+    if (const char* val = get_option(open_options, "MSAT_XRIT_INCREMENTAL"))
+        da.incremental = CSLTestBoolean(val);
+
+    return true;
+}
+
+bool XRITDataset::init_geometry(MSG_data& PRO_data, MSG_header& header, bool hrv)
+{
+    char buf[25];
 
-    if (da.hrv)
+    if (hrv)
     {
         nRasterXSize = 11136;
         nRasterYSize = 11136;
@@ -57,8 +159,8 @@ bool XRITDataset::init()
 
 
     /// Image time
-    struct tm *tmtime = PRO_data.prologue->image_acquisition.PlannedAquisitionTime.TrueRepeatCycleStart.get_timestruct( );
-    snprintf(buf, 20, "%04d-%02d-%02d %02d:%02d:00", tmtime->tm_year+1900, tmtime->tm_mon+1, tmtime->tm_mday, tmtime->tm_hour, tmtime->tm_min);
+    struct tm tmtime = PRO_data.prologue->image_acquisition.PlannedAquisitionTime.TrueRepeatCycleStart.get_timestruct( );
+    snprintf(buf, 20, "%04d-%02d-%02d %02d:%02d:00", tmtime.tm_year+1900, tmtime.tm_mon+1, tmtime.tm_mday, tmtime.tm_hour, tmtime.tm_min);
     if (SetMetadataItem(MD_MSAT_DATETIME, buf, MD_DOMAIN_MSAT) != CE_None)
         return false;
 
@@ -70,7 +172,7 @@ bool XRITDataset::init()
     /// Geotransform matrix
     double pixelSizeX, pixelSizeY;
     int column_offset, line_offset, x0 = 0, y0 = 0;
-    if (da.hrv)
+    if (hrv)
     {
         pixelSizeX = 1000 * PRO_data.prologue->image_description.ReferenceGridHRV.ColumnDirGridStep;
         pixelSizeY = 1000 * PRO_data.prologue->image_description.ReferenceGridHRV.LineDirGridStep;
@@ -99,15 +201,126 @@ bool XRITDataset::init()
     geotransform[2] = 0.0;
     geotransform[4] = 0.0;
 
+    return true;
+}
+
+bool XRITDataset::init(char** open_options)
+{
+    int tile_size = 0;
+    if (const char* val = get_option(open_options, "MSAT_XRIT_TILE_SIZE"))
+    {
+        tile_size = atoi(val);
+        if (tile_size <= 0)
+        {
+            CPLError(CE_Failure, CPLE_AppDefined, "invalid MSAT_XRIT_TILE_SIZE value '%s'", val);
+            return false;
+        }
+    }
+
+    // A "*" channel opens all the non-HRV channels of the slot
+    vector<string> channels;
+    if (fa.productid2 == "*")
+    {
+        channels = slot_channels(fa);
+        if (channels.empty())
+        {
+            CPLError(CE_Failure, CPLE_AppDefined, "%s: no channels found", fa.toString().c_str());
+            return false;
+        }
+    } else
+        channels.push_back(fa.productid2);
 
-    // Raster bands
-    unique_ptr<XRITRasterBand> rb(new XRITRasterBand(this, 1));
-    if (!rb->init(PRO_data, EPI_data, header)) return false;
-    SetBand(1, rb.release());
+    // Overviews computed from the full resolution data
+    bool overviews = true;
+    if (const char* val = get_option(open_options, "MSAT_XRIT_OVERVIEWS"))
+        overviews = CSLTestBoolean(val);
+
+    bool incremental = false;
+    for (size_t i = 0; i < channels.size(); ++i)
+    {
+        unique_ptr<XRITRasterBand> rb(new XRITRasterBand(this, i + 1, FileAccess(fa, channels[i])));
+        if (!init_data_access(rb->da, open_options)) return false;
+        incremental = rb->da.incremental;
+
+        // Scan segment headers, sharing prologue and epilogue with the other
+        // bands and datasets of the same repeat cycle
+        MSG_header header;
+        rb->da.scan(rb->fa, header);
+
+        // All channels of a slot share the same geometry: set it up once
+        if (i == 0 && !init_geometry(*rb->da.pro, header, rb->da.hrv))
+            return false;
+
+        if (!rb->init(*rb->da.pro, header, tile_size)) return false;
+        XRITRasterBand* band = rb.get();
+        SetBand(i + 1, rb.release());
+        if (overviews) band->init_overviews();
+    }
+
+    if (incremental)
+        update_available_lines();
 
     return true;
 }
 
+size_t XRITDataset::refresh()
+{
+    size_t added = 0;
+    for (int i = 1; i <= GetRasterCount(); ++i)
+    {
+        XRITRasterBand* rb = (XRITRasterBand*)GetRasterBand(i);
+        added += rb->da.refresh(rb->fa);
+    }
+    if (added)
+    {
+        // Overviews are not registered as bands of the dataset, and their
+        // blocks need to be flushed separately
+        FlushCache();
+        for (int i = 1; i <= GetRasterCount(); ++i)
+            for (auto& ovr: ((XRITRasterBand*)GetRasterBand(i))->overviews)
+                ovr->FlushCache();
+        update_available_lines();
+    }
+    return added;
+}
+
+CPLErr XRITDataset::SetMetadataItem(const char* name, const char* value, const char* domain)
+{
+    if (name && strcmp(name, MD_MSAT_REFRESH) == 0 && (!domain || strcmp(domain, MD_DOMAIN_MSAT) == 0))
+    {
+        try {
+            refresh();
+        } catch (std::exception& e) {
+            CPLError(CE_Failure, CPLE_AppDefined, "%s", e.what());
+            return CE_Failure;
+        }
+        return CE_None;
+    }
+    return GDALDataset::SetMetadataItem(name, value, domain);
+}
+
+void XRITDataset::update_available_lines()
+{
+    string ranges;
+    char buf[50];
+    int first = -1;
+    for (int line = 0; line <= nRasterYSize; ++line)
+    {
+        bool available = line < nRasterYSize;
+        for (int i = 1; available && i <= GetRasterCount(); ++i)
+            available = ((XRITRasterBand*)GetRasterBand(i))->da.line_available(line);
+        if (available && first == -1)
+            first = line;
+        else if (!available && first != -1)
+        {
+            snprintf(buf, 50, "%s%d-%d", ranges.empty() ? "" : ",", first, line - 1);
+            ranges += buf;
+            first = -1;
+        }
+    }
+    SetMetadataItem(MD_MSAT_AVAILABLE_LINES, ranges.c_str(), MD_DOMAIN_MSAT);
+}
+
 
 }
 }
@@ -3,24 +3,103 @@
 
 #include <msat/xrit/fileaccess.h>
 #include <msat/xrit/dataaccess.h>
+#include "gdal/reflectance/diskmask.h"
 #include <gdal/gdal_priv.h>
 #include <string>
+#include <vector>
+#include <memory>
 
 namespace msat {
 namespace xrit {
 
+/**
+ * Dataset with the image of an xRIT product.
+ *
+ * If the channel of the product name is "*", as in H:MSG2:*:200807150900,
+ * the dataset has a band for each non-HRV channel of the slot found on disk,
+ * in channel order. Otherwise it has only one band, with the given channel.
+ */
 class XRITDataset : public GDALDataset
 {
+protected:
+    /**
+     * Configure a DataAccess with the tuning parameters in \a open_options.
+     * Returns false if an option value is invalid.
+     */
+    bool init_data_access(xrit::DataAccess& da, char** open_options);
+
+    /**
+     * Set up size, metadata, projection and geotransform from the prologue
+     * and the header of the first band
+     */
+    bool init_geometry(MSG_data& PRO_data, MSG_header& header, bool hrv);
+
+    /// Mask of the pixels on the Earth disk, shared by all bands
+    std::unique_ptr<utils::DiskMaskRasterBand> disk_mask;
+
 public:
     xrit::FileAccess fa;
-    xrit::DataAccess da;
     int spacecraft_id;
     std::string projWKT;
     double geotransform[6];
 
     XRITDataset(const xrit::FileAccess& fa);
+    ~XRITDataset();
+
+    /**
+     * Scan the xRIT data and set up the dataset.
+     *
+     * open_options are the GDAL open options, which can be used to pass
+     * tuning parameters. Each option can also be given as a GDAL config
+     * option with the same name, and applies to each band separately.
+     */
+    virtual bool init(char** open_options=nullptr);
+
+    /**
+     * Look for segments that arrived after the dataset was opened with the
+     * MSAT_XRIT_INCREMENTAL option, and make them readable.
+     *
+     * If new segments are found, the blocks cached by GDAL are discarded, so
+     * that the newly covered lines are read again, and the
+     * MSAT_AVAILABLE_LINES metadata item is updated.
+     *
+     * Returns the number of new segments.
+     */
+    size_t refresh();
+
+    /**
+     * Setting the MSAT_REFRESH metadata item, to any value, calls refresh(),
+     * so that GDAL callers can pick up new segments without reopening the
+     * dataset, and returns CE_Failure if it fails. Other items are set as
+     * usual.
+     */
+    virtual CPLErr SetMetadataItem(const char* name, const char* value, const char* domain="");
+
+    /**
+     * Set the MSAT_AVAILABLE_LINES metadata item to the ranges of lines
+     * that can currently be read in all bands, as comma separated first-last
+     * pairs
+     */
+    void update_available_lines();
+
+    /**
+     * Look up the value of a tuning option, first in the open options, then
+     * in the GDAL config options. Returns nullptr if the option is not set.
+     */
+    static const char* get_option(char** open_options, const char* name);
+
+    /**
+     * Return the non-HRV channels of the slot of \a fa that have segment
+     * files, in channel order
+     */
+    static std::vector<std::string> slot_channels(const xrit::FileAccess& fa);
 
-    virtual bool init();
+    /**
+     * Return the mask of the pixels on the Earth disk that are covered by
+     * data, creating it with the given block size the first time it is
+     * needed
+     */
+    utils::DiskMaskRasterBand* get_disk_mask(int block_x, int block_y);
 
     virtual const char* GetProjectionRef();
     virtual CPLErr GetGeoTransform(double* tr);
@@ -2,13 +2,17 @@
 #include "dataset.h"
 #include <msat/gdal/const.h>
 #include <msat/facts.h>
+#include <msat/utils/kernels.h>
+#include <msat/xrit/diskcache.h>
 #include <stdint.h>
+#include <algorithm>
+#include <vector>
 
 namespace msat {
 namespace xrit {
 
-XRITRasterBand::XRITRasterBand(XRITDataset* ds, int idx)
-    : xds(ds), calibration(0)
+XRITRasterBand::XRITRasterBand(XRITDataset* ds, int idx, const xrit::FileAccess& fa)
+    : xds(ds), fa(fa), calibration(0)
 {
     poDS = ds;
     nBand = idx;
@@ -16,18 +20,27 @@ XRITRasterBand::XRITRasterBand(XRITDataset* ds, int idx)
 
 XRITRasterBand::~XRITRasterBand()
 {
+    const SegmentCache::Stats& stats = da.segcache.stats();
+    CPLDebug("XRIT", "%s %s: segment cache hits: %zu, misses: %zu, evictions: %zu",
+            fa.timing.c_str(), GetDescription(), stats.hits, stats.misses, stats.evictions);
+    if (da.diskcache)
+    {
+        DiskCache::Stats dstats = da.diskcache->stats();
+        CPLDebug("XRIT", "%s %s: disk cache hits: %zu, misses: %zu, stores: %zu, evictions: %zu",
+                fa.timing.c_str(), GetDescription(), dstats.hits, dstats.misses, dstats.stores, dstats.evictions);
+    }
     if (calibration) delete[] calibration;
 }
 
-bool XRITRasterBand::init(MSG_data& PRO_data, MSG_data& EPI_data, MSG_header& header)
+bool XRITRasterBand::init(MSG_data& PRO_data, MSG_header& header, int tile_size)
 {
-    if (xds->da.hrv)
+    if (tile_size > 0)
     {
-        nBlockXSize = 11136;
-        nBlockYSize = 1;
+        nBlockXSize = tile_size;
+        nBlockYSize = tile_size;
     } else {
-        nBlockXSize = 3712;
-        nBlockYSize = 1;
+        nBlockXSize = xds->GetRasterXSize();
+        nBlockYSize = da.seglines;
     }
 
     /// Channel
@@ -63,41 +76,157 @@ bool XRITRasterBand::init(MSG_data& PRO_data, MSG_data& EPI_data, MSG_header& he
     return true;
 }
 
+void XRITRasterBand::init_overviews()
+{
+    XRITOverviewBand* prev = nullptr;
+    int size = std::min(nRasterXSize, nRasterYSize);
+    for (int factor = 2; size / factor >= 256; factor *= 2)
+    {
+        overviews.emplace_back(new XRITOverviewBand(this, prev));
+        if (prev) prev->next = overviews.back().get();
+        prev = overviews.back().get();
+    }
+}
+
 const char* XRITRasterBand::GetUnitType()
 {
     return facts::channelUnit(xds->spacecraft_id, channel_id);
 }
 
+void XRITRasterBand::read_window(int xoff, int yoff, int xsize, int ysize, void* buf, size_t line_space)
+{
+    // When decoding with multiple threads, on a cache miss decode together
+    // the segments needed by this and the following lines
+    if (da.threads > 1)
+    {
+        size_t segnum, segline;
+        da.line_segment(yoff, segnum, segline);
+        if (!da.in_cache(segnum))
+        {
+            size_t skipped = da.preload_lines(yoff, std::min((size_t)nRasterYSize,
+                        yoff + std::max((size_t)ysize, da.threads * da.seglines)));
+            if (skipped)
+                CPLDebug("XRIT", "%s %s: %zu segments not preloaded: raise MSAT_XRIT_CACHE_SIZE to decode them in parallel",
+                        fa.timing.c_str(), GetDescription(), skipped);
+        }
+    }
+
+    std::vector<MSG_SAMPLE> raw;
+    if (!linear) raw.resize(xsize);
+
+    for (int y = 0; y < ysize; ++y)
+    {
+        unsigned char* line = (unsigned char*)buf + y * line_space;
+
+        // Intersect the window with the part of the line covered by data
+        size_t linestart = da.line_start(yoff + y);
+        size_t begin = std::max((size_t)xoff, linestart);
+        size_t end = std::min((size_t)(xoff + xsize), linestart + da.columns);
+        // Keep both ends inside the window when it misses the data entirely
+        end = std::max(end, (size_t)xoff);
+        begin = std::min(begin, end);
+        size_t lead = begin - xoff;
+        size_t count = end - begin;
+
+        if (linear)
+        {
+            uint16_t* out = (uint16_t*)line;
+            std::fill(out, out + lead, 0);
+            if (count)
+                da.line_read(yoff + y, out + lead, begin - linestart, count);
+            std::fill(out + lead + count, out + xsize, 0);
+        } else {
+            if (count)
+                da.line_read(yoff + y, raw.data(), begin - linestart, count);
+            utils::kernels::calibrate(raw.data(), count, calibration, (float*)line, lead, xsize - lead - count);
+        }
+    }
+}
+
 CPLErr XRITRasterBand::IReadBlock(int xblock, int yblock, void *buf)
 {
-    if (xblock != 0)
+    int xoff = xblock * nBlockXSize;
+    int yoff = yblock * nBlockYSize;
+    if (xoff >= nRasterXSize || yoff >= nRasterYSize)
     {
         CPLError(CE_Failure, CPLE_AppDefined, "Invalid block number");
         return CE_Failure;
     }
 
-    size_t linestart = xds->da.line_start(yblock);
+    // Blocks on the right and bottom edges can be partial: the rest of the
+    // buffer is zeroed
+    int xsize = std::min(nBlockXSize, nRasterXSize - xoff);
+    int ysize = std::min(nBlockYSize, nRasterYSize - yoff);
+    size_t pixel_size = GDALGetDataTypeSize(eDataType) / 8;
+    if (xsize < nBlockXSize || ysize < nBlockYSize)
+        memset(buf, 0, nBlockXSize * nBlockYSize * pixel_size);
 
-    if (linear)
+    try {
+        read_window(xoff, yoff, xsize, ysize, buf, nBlockXSize * pixel_size);
+    } catch (std::exception& e) {
+        CPLError(CE_Failure, CPLE_AppDefined, "%s", e.what());
+        return CE_Failure;
+    }
+
+    // Compute the overviews while the full resolution data is at hand
+    if (!overviews.empty())
+        overviews[0]->add_block(xblock, yblock, buf);
+
+    return CE_None;
+}
+
+#if GDAL_VERSION_MAJOR >= 2
+CPLErr XRITRasterBand::IRasterIO(GDALRWFlag eRWFlag, int nXOff, int nYOff, int nXSize, int nYSize,
+                                 void* pData, int nBufXSize, int nBufYSize, GDALDataType eBufType,
+                                 GSpacing nPixelSpace, GSpacing nLineSpace,
+                                 GDALRasterIOExtraArg* psExtraArg)
+#else
+CPLErr XRITRasterBand::IRasterIO(GDALRWFlag eRWFlag, int nXOff, int nYOff, int nXSize, int nYSize,
+                                 void* pData, int nBufXSize, int nBufYSize, GDALDataType eBufType,
+                                 int nPixelSpace, int nLineSpace)
+#endif
+{
+    // Read straight out of the decoded segments when no resampling or type
+    // conversion is needed, bypassing the block cache
+    if (eRWFlag == GF_Read
+            && nBufXSize == nXSize && nBufYSize == nYSize
+            && eBufType == eDataType
+            && nPixelSpace == GDALGetDataTypeSize(eDataType) / 8
+            && nLineSpace > 0)
     {
-        bzero(buf, nBlockXSize * sizeof(uint16_t));
-        xds->da.line_read(yblock, (MSG_SAMPLE*)buf + linestart);
-    } else {
-        float* fbuf = (float*)buf;
-        MSG_SAMPLE rawbuf[xds->da.columns];
-        xds->da.line_read(yblock, rawbuf);
-        for (size_t i = 0; i < linestart; ++i)
-            fbuf[i] = 0.0;
-        for (size_t i = 0; i < xds->da.columns; ++i)
-        {
-            float res = calibration[rawbuf[i]];
-            if (res < 0 || isnan(res)) res = 0;
-            fbuf[linestart + i] = res;
+        try {
+            read_window(nXOff, nYOff, nXSize, nYSize, pData, nLineSpace);
+        } catch (std::exception& e) {
+            CPLError(CE_Failure, CPLE_AppDefined, "%s", e.what());
+            return CE_Failure;
         }
-        for (size_t i = linestart + xds->da.columns; i < (size_t)nBlockXSize; ++i)
-            fbuf[i] = 0.0;
+        return CE_None;
     }
 
+#if GDAL_VERSION_MAJOR >= 2
+    return GDALRasterBand::IRasterIO(eRWFlag, nXOff, nYOff, nXSize, nYSize,
+                                     pData, nBufXSize, nBufYSize, eBufType,
+                                     nPixelSpace, nLineSpace, psExtraArg);
+#else
+    return GDALRasterBand::IRasterIO(eRWFlag, nXOff, nYOff, nXSize, nYSize,
+                                     pData, nBufXSize, nBufYSize, eBufType,
+                                     nPixelSpace, nLineSpace);
+#endif
+}
+
+CPLErr XRITRasterBand::AdviseRead(int nXOff, int nYOff, int nXSize, int nYSize,
+                                  int nBufXSize, int nBufYSize, GDALDataType eDT,
+                                  char** papszOptions)
+{
+    try {
+        size_t skipped = da.preload_lines(nYOff, nYOff + nYSize);
+        if (skipped)
+            CPLDebug("XRIT", "%s %s: %zu segments not preloaded: raise MSAT_XRIT_CACHE_SIZE to decode them in parallel",
+                    fa.timing.c_str(), GetDescription(), skipped);
+    } catch (std::exception& e) {
+        CPLError(CE_Failure, CPLE_AppDefined, "%s", e.what());
+        return CE_Failure;
+    }
     return CE_None;
 }
 
@@ -119,5 +248,156 @@ double XRITRasterBand::GetNoDataValue(int* pbSuccess)
     return 0.0;
 }
 
+int XRITRasterBand::GetOverviewCount()
+{
+    return overviews.size();
+}
+
+GDALRasterBand* XRITRasterBand::GetOverview(int idx)
+{
+    if (idx < 0 || (size_t)idx >= overviews.size()) return nullptr;
+    return overviews[idx].get();
+}
+
+GDALRasterBand* XRITRasterBand::GetMaskBand()
+{
+    return xds->get_disk_mask(nBlockXSize, nBlockYSize);
+}
+
+int XRITRasterBand::GetMaskFlags()
+{
+    return GMF_PER_DATASET;
+}
+
+
+XRITOverviewBand::XRITOverviewBand(XRITRasterBand* parent, XRITOverviewBand* prev)
+    : parent(parent), prev(prev), next(nullptr)
+{
+    poDS = parent->xds;
+    nBand = parent->GetBand();
+    eDataType = parent->GetRasterDataType();
+
+    GDALRasterBand* src = source();
+    int sbx, sby;
+    src->GetBlockSize(&sbx, &sby);
+    nRasterXSize = (src->GetXSize() + 1) / 2;
+    nRasterYSize = (src->GetYSize() + 1) / 2;
+    nBlockXSize = (sbx + 1) / 2;
+    nBlockYSize = (sby + 1) / 2;
+}
+
+GDALRasterBand* XRITOverviewBand::source()
+{
+    if (prev) return prev;
+    return parent;
+}
+
+void XRITOverviewBand::read_source(int xoff, int yoff, int xsize, int ysize, void* buf, size_t line_space)
+{
+    if (prev)
+        prev->read_window(xoff, yoff, xsize, ysize, buf, line_space);
+    else
+        parent->read_window(xoff, yoff, xsize, ysize, buf, line_space);
+}
+
+void XRITOverviewBand::decimate(const void* src, int width, int height, size_t src_line_space, void* dst, size_t dst_line_space)
+{
+    if (eDataType == GDT_UInt16)
+        utils::kernels::box_decimate((const uint16_t*)src, width, height, src_line_space / 2, 2, (uint16_t*)dst, dst_line_space / 2);
+    else
+        utils::kernels::box_decimate((const float*)src, width, height, src_line_space / 4, 2, (float*)dst, dst_line_space / 4);
+}
+
+void XRITOverviewBand::read_window(int xoff, int yoff, int xsize, int ysize, void* buf, size_t line_space)
+{
+    // Source window, clipped to the source size
+    int src_xoff = xoff * 2, src_yoff = yoff * 2;
+    int src_xsize = std::min(xsize * 2, source()->GetXSize() - src_xoff);
+    int src_ysize = std::min(ysize * 2, source()->GetYSize() - src_yoff);
+    size_t pixel_size = GDALGetDataTypeSize(eDataType) / 8;
+    std::vector<unsigned char> src(src_xsize * src_ysize * pixel_size);
+    read_source(src_xoff, src_yoff, src_xsize, src_ysize, src.data(), src_xsize * pixel_size);
+    decimate(src.data(), src_xsize, src_ysize, src_xsize * pixel_size, buf, line_space);
+}
+
+void XRITOverviewBand::add_block(int xblock, int yblock, const void* src)
+{
+    int sx = source()->GetXSize(), sy = source()->GetYSize(), sbx, sby;
+    source()->GetBlockSize(&sbx, &sby);
+
+    // Source blocks need to map to exactly one of our blocks
+    if ((sbx % 2 && sbx < sx) || (sby % 2 && sby < sy)) return;
+
+    GDALRasterBlock* block = TryGetLockedBlockRef(xblock, yblock);
+    if (block)
+    {
+        // Already computed
+        block->DropLock();
+        return;
+    }
+    block = GetLockedBlockRef(xblock, yblock, TRUE);
+    if (!block) return;
+
+    // Partial blocks on the edges are padded with zeroes
+    size_t pixel_size = GDALGetDataTypeSize(eDataType) / 8;
+    int width = std::min(sbx, sx - xblock * sbx);
+    int height = std::min(sby, sy - yblock * sby);
+    void* dst = block->GetDataRef();
+    if (width < sbx || height < sby)
+        memset(dst, 0, nBlockXSize * nBlockYSize * pixel_size);
+    decimate(src, width, height, sbx * pixel_size, dst, nBlockXSize * pixel_size);
+
+    if (next)
+        next->add_block(xblock, yblock, dst);
+
+    block->DropLock();
+}
+
+CPLErr XRITOverviewBand::IReadBlock(int xblock, int yblock, void *buf)
+{
+    int xoff = xblock * nBlockXSize;
+    int yoff = yblock * nBlockYSize;
+    if (xoff >= nRasterXSize || yoff >= nRasterYSize)
+    {
+        CPLError(CE_Failure, CPLE_AppDefined, "Invalid block number");
+        return CE_Failure;
+    }
+
+    int xsize = std::min(nBlockXSize, nRasterXSize - xoff);
+    int ysize = std::min(nBlockYSize, nRasterYSize - yoff);
+    size_t pixel_size = GDALGetDataTypeSize(eDataType) / 8;
+    if (xsize < nBlockXSize || ysize < nBlockYSize)
+        memset(buf, 0, nBlockXSize * nBlockYSize * pixel_size);
+
+    try {
+        read_window(xoff, yoff, xsize, ysize, buf, nBlockXSize * pixel_size);
+    } catch (std::exception& e) {
+        CPLError(CE_Failure, CPLE_AppDefined, "%s", e.what());
+        return CE_Failure;
+    }
+
+    return CE_None;
+}
+
+const char* XRITOverviewBand::GetUnitType()
+{
+    return parent->GetUnitType();
+}
+
+double XRITOverviewBand::GetOffset(int* pbSuccess)
+{
+    return parent->GetOffset(pbSuccess);
+}
+
+double XRITOverviewBand::GetScale(int* pbSuccess)
+{
+    return parent->GetScale(pbSuccess);
+}
+
+double XRITOverviewBand::GetNoDataValue(int* pbSuccess)
+{
+    return parent->GetNoDataValue(pbSuccess);
+}
+
 }
 }
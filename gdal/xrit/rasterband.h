@@ -2,35 +2,137 @@
 #define MSAT_GDALDRIVER_XRIT_RASTERBAND_H
 
 #include <gdal/gdal_priv.h>
+#include <gdal_version.h>
 #include <msat/hrit/MSG_HRIT.h>
+#include <msat/xrit/fileaccess.h>
+#include <msat/xrit/dataaccess.h>
+#include <vector>
+#include <memory>
 
 namespace msat {
 namespace xrit {
 
 class XRITDataset;
+class XRITOverviewBand;
 
 class XRITRasterBand : public GDALRasterBand
 {
 public:
     XRITDataset* xds;
+    /// Channel read by this band
+    xrit::FileAccess fa;
+    xrit::DataAccess da;
     double slope;
     double offset;
     bool linear;
     int channel_id;
     float* calibration;
+    /// Overviews, each half the size of the previous one
+    std::vector<std::unique_ptr<XRITOverviewBand>> overviews;
 
-    XRITRasterBand(XRITDataset* ds, int idx);
+    XRITRasterBand(XRITDataset* ds, int idx, const xrit::FileAccess& fa);
     ~XRITRasterBand();
 
-    bool init(MSG_data& PRO_data, MSG_data& EPI_data, MSG_header& header);
+    /**
+     * Set up the band.
+     *
+     * Blocks span the whole image width and are as tall as a segment, unless
+     * \a tile_size is set, in which case blocks are tile_size x tile_size
+     * squares.
+     */
+    bool init(MSG_data& PRO_data, MSG_header& header, int tile_size=0);
+
+    /**
+     * Create overviews at 1/2, 1/4, 1/8... of the band size, as long as they
+     * are at least 256 pixels wide.
+     *
+     * It needs to be called after the band has been added to the dataset.
+     */
+    void init_overviews();
+
+    /**
+     * Read a window of the image as the band data type into \a buf, whose
+     * lines are \a line_space bytes apart.
+     *
+     * Areas outside the data, like the parts of HRV lines not covered by the
+     * scan, are filled with 0.
+     */
+    void read_window(int xoff, int yoff, int xsize, int ysize, void* buf, size_t line_space);
 
     virtual const char* GetUnitType();
 
     virtual CPLErr IReadBlock(int xblock, int yblock, void *buf);
+#if GDAL_VERSION_MAJOR >= 2
+    virtual CPLErr IRasterIO(GDALRWFlag eRWFlag, int nXOff, int nYOff, int nXSize, int nYSize,
+                             void* pData, int nBufXSize, int nBufYSize, GDALDataType eBufType,
+                             GSpacing nPixelSpace, GSpacing nLineSpace,
+                             GDALRasterIOExtraArg* psExtraArg);
+#else
+    virtual CPLErr IRasterIO(GDALRWFlag eRWFlag, int nXOff, int nYOff, int nXSize, int nYSize,
+                             void* pData, int nBufXSize, int nBufYSize, GDALDataType eBufType,
+                             int nPixelSpace, int nLineSpace);
+#endif
+    virtual CPLErr AdviseRead(int nXOff, int nYOff, int nXSize, int nYSize,
+                              int nBufXSize, int nBufYSize, GDALDataType eDT,
+                              char** papszOptions);
 
     virtual double GetOffset(int* pbSuccess=NULL);
     virtual double GetScale(int* pbSuccess=NULL);
     virtual double GetNoDataValue(int* pbSuccess=NULL);
+    virtual int GetOverviewCount();
+    virtual GDALRasterBand* GetOverview(int idx);
+    virtual GDALRasterBand* GetMaskBand();
+    virtual int GetMaskFlags();
+};
+
+/**
+ * Overview of a XRITRasterBand, half the size of the previous overview or of
+ * the band itself.
+ *
+ * Each pixel is the average of the valid pixels in a 2x2 box of the source.
+ * Overview blocks are computed from the blocks of the full resolution band as
+ * they are read, so that after a full read the overviews are already in the
+ * GDAL block cache.
+ */
+class XRITOverviewBand : public GDALRasterBand
+{
+public:
+    XRITRasterBand* parent;
+    /// Previous overview, or nullptr if this is computed from the band itself
+    XRITOverviewBand* prev;
+    /// Next smaller overview, or nullptr if this is the smallest
+    XRITOverviewBand* next;
+
+    XRITOverviewBand(XRITRasterBand* parent, XRITOverviewBand* prev);
+
+    /// Read a window of the overview, like XRITRasterBand::read_window
+    void read_window(int xoff, int yoff, int xsize, int ysize, void* buf, size_t line_space);
+
+    /**
+     * Given block (xblock, yblock) of the source, already read into \a src,
+     * compute the matching block of this overview and add it to the GDAL
+     * block cache, then do the same for the following overviews.
+     *
+     * Does nothing if source blocks do not map to exactly one block of this
+     * overview, or if the block is already cached.
+     */
+    void add_block(int xblock, int yblock, const void* src);
+
+    virtual CPLErr IReadBlock(int xblock, int yblock, void *buf);
+    virtual const char* GetUnitType();
+    virtual double GetOffset(int* pbSuccess=NULL);
+    virtual double GetScale(int* pbSuccess=NULL);
+    virtual double GetNoDataValue(int* pbSuccess=NULL);
+
+protected:
+    /// Band this overview is computed from
+    GDALRasterBand* source();
+
+    /// Read a window of the source of this overview
+    void read_source(int xoff, int yoff, int xsize, int ysize, void* buf, size_t line_space);
+
+    /// Halve \a width x \a height pixels of \a src into \a dst
+    void decimate(const void* src, int width, int height, size_t src_line_space, void* dst, size_t dst_line_space);
 };
 
 }
@@ -4,8 +4,11 @@
 #include "gdal/reflectance/reflectance.h"
 #include "gdal/reflectance/cos_sol_za.h"
 #include "gdal/utils.h"
+#include <msat/xrit/archiveindex.h>
+#include <gdal_version.h>
 #include <string>
 #include <memory>
+#include <vector>
 #include <cctype>
 
 using namespace std;
@@ -23,7 +26,23 @@ GDALDataset* XRITOpen(GDALOpenInfo* info)
     // the channel
     bool do_reflectance = false;
     bool do_sza = false;
+    char** open_options = nullptr;
+#if GDAL_VERSION_MAJOR >= 2
+    open_options = info->papszOpenOptions;
+#endif
     FileAccess fa(info->pszFilename);
+
+    // Look up file names in an index built by msat-index
+    if (const char* val = XRITDataset::get_option(open_options, "MSAT_XRIT_INDEX"))
+    {
+        try {
+            fa.index = ArchiveIndex::load(val);
+        } catch (std::exception& e) {
+            CPLError(CE_Failure, CPLE_AppDefined, "cannot read index %s: %s", val, e.what());
+            return NULL;
+        }
+    }
+
     if (!fa.productid2.empty())
     {
         switch (fa.productid2[fa.productid2.size() - 1])
@@ -39,14 +58,39 @@ GDALDataset* XRITOpen(GDALOpenInfo* info)
 
     if (do_reflectance)
     {
-        if (fa.productid2 == "IR_039")
+        if (fa.productid2.find('+') != string::npos)
+        {
+            // Several channels joined by '+', computed together as the bands
+            // of one dataset
+            vector<int> channel_ids;
+            vector<unique_ptr<XRITDataset>> sources;
+            size_t beg = 0;
+            while (true)
+            {
+                size_t end = fa.productid2.find('+', beg);
+                std::string chan = fa.productid2.substr(beg, end == string::npos ? string::npos : end - beg);
+                std::unique_ptr<XRITDataset> ds(new XRITDataset(FileAccess(fa, chan)));
+                if (!ds->init(open_options)) return NULL;
+                XRITRasterBand* rb = dynamic_cast<XRITRasterBand*>(ds->GetRasterBand(1));
+                channel_ids.push_back(rb->channel_id);
+                sources.emplace_back(ds.release());
+                if (end == string::npos) break;
+                beg = end + 1;
+            }
+
+            unique_ptr<msat::utils::FusedReflectanceDataset> rds(new msat::utils::FusedReflectanceDataset(channel_ids));
+            for (auto& ds: sources)
+                rds->add_source(ds.release(), true);
+            rds->init_rasterbands();
+            return rds.release();
+        } else if (fa.productid2 == "IR_039")
         {
             std::unique_ptr<XRITDataset> ds039(new XRITDataset(fa));
-            if (!ds039->init()) return NULL;
+            if (!ds039->init(open_options)) return NULL;
             std::unique_ptr<XRITDataset> ds108(new XRITDataset(FileAccess(fa, "IR_108")));
-            if (!ds108->init()) return NULL;
+            if (!ds108->init(open_options)) return NULL;
             std::unique_ptr<XRITDataset> ds134(new XRITDataset(FileAccess(fa, "IR_134")));
-            if (!ds134->init()) return NULL;
+            if (!ds134->init(open_options)) return NULL;
 
             unique_ptr<msat::utils::ReflectanceDataset> rds(new msat::utils::ReflectanceDataset(MSG_SEVIRI_1_5_IR_3_9));
             rds->add_source(ds039.release(), true);
@@ -56,7 +100,7 @@ GDALDataset* XRITOpen(GDALOpenInfo* info)
             return rds.release();
         } else {
             std::unique_ptr<XRITDataset> ds(new XRITDataset(fa));
-            if (!ds->init()) return NULL;
+            if (!ds->init(open_options)) return NULL;
             XRITRasterBand* rb = dynamic_cast<XRITRasterBand*>(ds->GetRasterBand(1));
             unique_ptr<msat::utils::ReflectanceDataset> rds(new msat::utils::ReflectanceDataset(rb->channel_id));
             rds->add_source(ds.release(), true);
@@ -65,12 +109,12 @@ GDALDataset* XRITOpen(GDALOpenInfo* info)
         }
     } else if (do_sza) {
         std::unique_ptr<XRITDataset> ds(new XRITDataset(fa));
-        if (!ds->init()) return NULL;
+        if (!ds->init(open_options)) return NULL;
         unique_ptr<msat::utils::CosSolZADataset> rds(new msat::utils::CosSolZADataset(ds.get()));
         return rds.release();
     } else {
         std::unique_ptr<XRITDataset> ds(new XRITDataset(fa));
-        if (!ds->init()) return NULL;
+        if (!ds->init(open_options)) return NULL;
         return msat::gdal::add_extras(ds.release(), info);
     }
 }
@@ -92,6 +136,22 @@ void GDALRegister_MsatXRIT()
         driver->SetMetadataItem(GDAL_DMD_LONGNAME, "Meteosat xRIT (via Meteosatlib)");
         //driver->SetMetadataItem(GDAL_DMD_HELPTOPIC, "frmt_various.html#JDEM");
         //driver->SetMetadataItem(GDAL_DMD_EXTENSION, "mem");
+#if GDAL_VERSION_MAJOR >= 2
+        driver->SetMetadataItem(GDAL_DMD_OPENOPTIONLIST,
+"<OpenOptionList>"
+"  <Option name='MSAT_COMPUTE' type='string' description='Compute a derived product (reflectance, sat_za, cos_sol_za, jday)'/>"
+"  <Option name='MSAT_XRIT_THREADS' type='string' description='Number of threads used to decode segments, or ALL_CPUS' default='1'/>"
+"  <Option name='MSAT_XRIT_READAHEAD' type='int' description='Number of segments decoded in background when reading sequentially' default='1'/>"
+"  <Option name='MSAT_XRIT_CACHE_SIZE' type='int' description='Memory budget in megabytes for decoded segments' default='64'/>"
+"  <Option name='MSAT_XRIT_DISK_CACHE' type='string' description='Directory where decoded segments are cached for use by other processes'/>"
+"  <Option name='MSAT_XRIT_DISK_CACHE_SIZE' type='int' description='Size budget in megabytes of the disk cache' default='1024'/>"
+"  <Option name='MSAT_XRIT_MMAP' type='boolean' description='Read uncompressed segments via mmap' default='YES'/>"
+"  <Option name='MSAT_XRIT_OVERVIEWS' type='boolean' description='Provide overviews computed from the full resolution data' default='YES'/>"
+"  <Option name='MSAT_XRIT_TILE_SIZE' type='int' description='Use square blocks of this size instead of segment-high strips'/>"
+"  <Option name='MSAT_XRIT_INDEX' type='string' description='Index file written by msat-index, used to find files instead of listing directories'/>"
+"  <Option name='MSAT_XRIT_INCREMENTAL' type='boolean' description='Open a repeat cycle that is still being received, reading missing segments as zeros' default='NO'/>"
+"</OpenOptionList>");
+#endif
         driver->pfnOpen = msat::xrit::XRITOpen;
         GetGDALDriverManager()->RegisterDriver(driver.release());
     }
@@ -609,37 +609,161 @@ double cos_sol_za(int jday, int hour, int minute, double dlat, double dlon)
 
 double cos_sol_za(int jday, double hour, double dlat, double dlon)
 {
-  // http://en.wikipedia.org/wiki/Solar_zenith_angle
-  double coz;
-
-  const double sinob = 0.3978;
-  // Days per year
-  const double dpy = 365.242;
-  // Degrees per hour, speed of earth rotation
-  const double dph = 15.0;
-  // From degrees to radians
-  const double rpd = M_PI/180.0;
-  // From radians to degrees
-  const double dpr = 1.0/rpd;
+  return SolarPosition(jday, hour).cos_sol_za(dlat, dlon);
+}
+
+namespace {
+
+// http://en.wikipedia.org/wiki/Solar_zenith_angle
+
+// Sin of the obliquity of the ecliptic
+const double sinob = 0.3978;
+// Days per year
+const double dpy = 365.242;
+// Degrees per hour, speed of earth rotation
+const double dph = 15.0;
+// From degrees to radians
+const double rpd = M_PI/180.0;
+// From radians to degrees
+const double dpr = 1.0/rpd;
+
+}
+
+SolarPosition::SolarPosition(int jday, double hour)
+{
   // Angle in earth orbit in radians, 0 = the beginning of the year
   double dang = 2.0*M_PI*(double)(jday-1)/dpy;
   double homp = 12.0 + 0.123570*sin(dang) - 0.004289*cos(dang) +
                 0.153809*sin(2.0*dang) + 0.060783*cos(2.0*dang);
-  // Hour angle in the local solar time (degrees)
-  double hang = dph* (hour-homp) + dlon;
+  // Hour angle in the local solar time (degrees), without the longitude
+  hang0 = dph* (hour-homp);
   double ang = 279.9348*rpd + dang;
   double sigma = (ang*dpr+0.4087*sin(ang)+1.8724*cos(ang)-
                  0.0182*sin(2.0*ang)+0.0083*cos(2.0*ang))*rpd;
   // Sin of sun declination
-  double sindlt = sinob*sin(sigma);
+  sindlt = sinob*sin(sigma);
   // Cos of sun declination
-  double cosdlt = sqrt(1.0-sindlt*sindlt);
+  cosdlt = sqrt(1.0-sindlt*sindlt);
+}
 
-  coz = sindlt*sin(rpd*dlat) + cosdlt*cos(rpd*dlat)*cos(rpd*hang);
+double SolarPosition::cos_sol_za(double dlat, double dlon) const
+{
+  double hang = hang0 + dlon;
+  return sindlt*sin(rpd*dlat) + cosdlt*cos(rpd*dlat)*cos(rpd*hang);
+}
 
-  return coz;
+void SolarPosition::cos_sol_za(size_t count, const double* dlat, const double* dlon, double* res) const
+{
+  // Keep the loop free of branches and calls other than the math functions,
+  // so that the compiler can vectorize it
+  const double sindlt = this->sindlt;
+  const double cosdlt = this->cosdlt;
+  const double hang0 = this->hang0;
+  for (size_t i = 0; i < count; ++i)
+  {
+    double lat = rpd*dlat[i];
+    double hang = hang0 + dlon[i];
+    res[i] = sindlt*sin(lat) + cosdlt*cos(lat)*cos(rpd*hang);
+  }
 }
 
+// Based on: [MMKM2010]
+//   "Cloud-Top Properties of Growing Cumulus prior to Convective Initiation as Measured
+//   by Meteosat Second Generation. Part II: Use of Visible Reflectance"
+// by:
+//   JOHN R. MECIKALSKI AND WAYNE M. MACKENZIE JR.
+//   Earth Systems Science Center, University of Alabama in Huntsville, Huntsville, Alabama
+//   MARIANNE KONIG
+//   European Organisation for the Exploitation of Meteorological Satellites (EUMETSAT), Darmstadt, Germany
+//   SAM MULLER
+//   Jupiter’s Call, LLC, Madison, Alabama
+// published on:
+//   JOURNAL OF APPLIED METEOROLOGY AND CLIMATOLOGY, VOLUME 49
+
+// IR 0.39 CO2 corrections and fine tuning from Jan Kanak's work on MSGProc software:
+//   Jan Kanak - Slovak Hydrometeorological Institute (SHMÚ)
+//   MSGProc - MSG Processing tools for Windows
+// http://www.eumetsat.int/Home/Main/AboutEUMETSAT/InternationalRelations/EasternEuropeanandBalkanCountries/SP_2011062115544756?l=en
+
+namespace {
+
+const double c1 = 0.0000119104;
+const double c2 = 1.43877;
+const double Vc = 2569.094;
+const double A = 0.9959;
+const double B = 3.471;
+
+// cos(80deg)
+const double cos80 = 0.173648178;
+
+inline double pow4(double x)
+{
+  double x2 = x * x;
+  return x2 * x2;
+}
+
+/// Apply Planck function to convert a Brightness Temperature to IR 3.9 Radiance
+inline double planck039(double bt)
+{
+  return c1 * (Vc*Vc*Vc) / (exp(c2 * Vc / (A * bt + B)) - 1);
+}
+
+}
+
+IR039Reflectance::IR039Reflectance(int jday)
+{
+  double esd = 1.0 - 0.0167 * cos( 2.0 * M_PI * (jday - 3) / 365.0);
+  toarad_scale = 4.92 / (esd*esd);
+}
+
+double IR039Reflectance::reflectance(double BT039, double BT108, double BT134, double cosTETA, double SAT) const
+{
+  // Use cos(80°) as lower bound, to avoid division by zero
+  if (cosTETA < cos80) cosTETA = cos80;
+
+  // Apply CO2 correction to BT039
+  double BT_co2 = BT108 - (BT108 - BT134)/4;
+  BT039 = sqrt(sqrt(pow4(BT039) + pow4(BT108) - pow4(BT_co2)));
+
+  // Apply Planck function to convert the CO2 corrected Brightness
+  // Temperature to Radiance
+  double R_tot = planck039(BT039) + 0.015;
+
+  double R39_corr = pow4(BT_co2 / BT108);
+  double R_therm = planck039(BT108) * R39_corr;
+  // Original from MMKM2010:
+  //double TOARAD = 4.92 / (esd*esd) * cosTETA * exp(-(1-R39_corr)) * exp(-(1-R39_corr) * cosTETA / cos(SAT));
+  // Version from MSGProc:
+  //double TOARAD = 4.92 / (esd*esd)
+  //              * pow(cosTETA, 0.75)
+  //              * exp(-(1-R39_corr) * cosTETA)
+  //              * exp(-(1-R39_corr) / cos(SAT));
+  double sqrt_cos = sqrt(cosTETA);
+  double TOARAD = toarad_scale
+                * sqrt_cos * sqrt(sqrt_cos)
+                * exp(-(1-R39_corr) * (cosTETA + 1 / cos(SAT)));
+  if (R_tot <= R_therm) R_tot = R_therm + 0.0000001;
+  if (TOARAD <= R_therm) TOARAD = R_therm + 0.0000001;
+
+  // Original from MMKM2010
+  //double REFL = 200 * (R_tot - R_therm) / (TOARAD - R_therm);
+  // Version from MSGProc:
+  double REFL = 100 * (R_tot - R_therm) / (TOARAD);
+
+  // Normalise outliars
+  switch (fpclassify(REFL))
+  {
+    case FP_NAN:
+    case FP_SUBNORMAL:
+    case FP_ZERO: REFL = 0.0; break;
+    case FP_INFINITE:
+    case FP_NORMAL:
+      if (REFL < 0.0) REFL = 0.0;
+      if (REFL > 100.0) REFL = 100.0;
+      break;
+  }
+  return REFL;
+}
 
 }
 }
@@ -2,6 +2,7 @@
 #define MSAT_FACTS_H
 
 #include <string>
+#include <cstddef>
 #include <math.h>
 
 namespace msat {
@@ -154,6 +155,64 @@ double cos_sol_za(int jday, int hour, int minute, double dlat, double dlon);
  */
 double cos_sol_za(int jday, double hour, double dlat, double dlon);
 
+/**
+ * Position of the sun at a given time, used to compute the cosine of the
+ * solar zenith angle of many locations at once.
+ *
+ * The terms that only depend on time are computed once in the constructor.
+ */
+struct SolarPosition
+{
+    /// Sine of the sun declination
+    double sindlt;
+    /// Cosine of the sun declination
+    double cosdlt;
+    /// Hour angle in the local solar time at longitude 0 (degrees)
+    double hang0;
+
+    /// Compute the position of the sun at UTC fractional hour \a hour of julian day \a jday
+    SolarPosition(int jday, double hour);
+
+    /// Cosine of the solar zenith angle at a given location
+    double cos_sol_za(double dlat, double dlon) const;
+
+    /**
+     * Compute the cosine of the solar zenith angle of \a count locations.
+     *
+     * The output array can be the same as one of the inputs.
+     */
+    void cos_sol_za(size_t count, const double* dlat, const double* dlon, double* res) const;
+};
+
+/**
+ * IR 3.9 reflectance computed from the brightness temperatures of IR 3.9,
+ * IR 10.8 and IR 13.4, following MMKM2010 with the CO2 correction and
+ * tuning of MSGProc.
+ *
+ * The terms that only depend on the day are computed once in the
+ * constructor. Results agree with the literal formulas within 1e-9
+ * reflectance percent.
+ */
+struct IR039Reflectance
+{
+    /// Solar term of the top of atmosphere radiance, 4.92 / esd²
+    double toarad_scale;
+
+    /// Set up the computation for julian day \a jday
+    IR039Reflectance(int jday);
+
+    /**
+     * Reflectance in percent, normalised to [0, 100].
+     *
+     * Brightness temperatures are in Kelvin, and \a sat_za is as returned by
+     * sat_za(). Powers are computed with multiplications and square roots
+     * instead of pow, and the two exponentials of the top of atmosphere
+     * radiance are merged: the result differs from evaluating the formulas
+     * literally by less than 1e-9 reflectance percent.
+     */
+    double reflectance(double bt039, double bt108, double bt134, double cos_sol_za, double sat_za) const;
+};
+
 }
 }
 
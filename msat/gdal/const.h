@@ -28,6 +28,11 @@
 #define MD_MSAT_CHANNEL         "MSAT_CHANNEL"
 #define MD_MSAT_INSTITUTION     "MSAT_INSTITUTION"
 #define MD_MSAT_PRODUCT_TYPE    "MSAT_PRODUCT_TYPE"
+#define MD_MSAT_AVAILABLE_LINES "MSAT_AVAILABLE_LINES"
+// Setting this item, with any value, on an incremental XRIT dataset rescans
+// its directory for segments that arrived since it was opened, and discards
+// the cached blocks and overviews computed without them
+#define MD_MSAT_REFRESH         "MSAT_REFRESH"
 
 // vim:set sw=2:
 #endif
@@ -65,6 +65,28 @@ std::string spaceviewWKT(double sublon)
         return res;
 }
 
+bool geosFromWKT(const char* wkt, utils::GeosProjection& proj)
+{
+	if (!wkt || !wkt[0]) return false;
+
+	OGRSpatialReference osr(wkt);
+	const char* name = osr.GetAttrValue("PROJECTION");
+	if (!name || !EQUAL(name, SRS_PT_GEOSTATIONARY_SATELLITE))
+		return false;
+	// Projections with PROJ.4 extensions may use a different sweep axis
+	if (osr.GetExtension("PROJCS", "PROJ4", NULL))
+		return false;
+	if (osr.GetProjParm(SRS_PP_FALSE_EASTING, 0.0) != 0.0
+	 || osr.GetProjParm(SRS_PP_FALSE_NORTHING, 0.0) != 0.0)
+		return false;
+
+	proj = utils::GeosProjection(
+		osr.GetProjParm(SRS_PP_CENTRAL_MERIDIAN, 0.0),
+		osr.GetProjParm(SRS_PP_SATELLITE_HEIGHT, ORBIT_RADIUS_FOR_GDAL),
+		osr.GetSemiMajor(), osr.GetSemiMinor());
+	return true;
+}
+
 void decodeGeotransform(GDALDataset* ds, int& xs, int& ys, double& psx, double& psy)
 {
 	double gt[6];
@@ -171,7 +193,7 @@ CPLErr invertGeoTransform(double* normal, double* inverted)
 
 
 GeoReferencer::GeoReferencer()
-	: ds(0), proj(0), latlon(0), toLatLon(0), fromLatLon(0)
+	: ds(0), proj(0), latlon(0), toLatLon(0), fromLatLon(0), use_geos(false)
 {
 }
 
@@ -205,6 +227,10 @@ CPLErr GeoReferencer::init(GDALDataset* ds)
 
 	projection = projname;
 
+	// Geostationary projections are computed in closed form
+	use_geos = geosFromWKT(projname, geos);
+	if (use_geos) return CE_None;
+
 	proj = new OGRSpatialReference(projection.c_str());
 	latlon = proj->CloneGeogCS();
 	toLatLon = OGRCreateCoordinateTransformation(proj, latlon);
@@ -231,6 +257,16 @@ void GeoReferencer::projectedToPixel(double px, double py, int& x, int& y) const
 
 CPLErr GeoReferencer::projectedToLatlon(double px, double py, double& lat, double& lon)
 {
+	if (use_geos)
+	{
+		if (geos.to_latlon(1, &px, &py, &lat, &lon) == 0)
+		{
+			CPLError(CE_Failure, CPLE_AppDefined, "point is not on the Earth disk");
+			return CE_Failure;
+		}
+		return CE_None;
+	}
+
 	if (!toLatLon->Transform(1, &px, &py))
 	{
 		CPLError(CE_Failure, CPLE_AppDefined, "points failed to transform to lat,lon");
@@ -244,6 +280,16 @@ CPLErr GeoReferencer::projectedToLatlon(double px, double py, double& lat, doubl
 
 CPLErr GeoReferencer::latlonToProjected(double lat, double lon, double& px, double& py)
 {
+	if (use_geos)
+	{
+		if (geos.from_latlon(1, &lat, &lon, &px, &py) == 0)
+		{
+			CPLError(CE_Failure, CPLE_AppDefined, "point is not visible from the satellite");
+			return CE_Failure;
+		}
+		return CE_None;
+	}
+
 	if (!fromLatLon->Transform(1, &lon, &lat))
 	{
 		CPLError(CE_Failure, CPLE_AppDefined, "points failed to transform from lat,lon");
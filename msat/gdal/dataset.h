@@ -22,6 +22,7 @@
 
 #include <msat/gdal/clean_gdal_priv.h>
 #include <msat/gdal/points.h>
+#include <msat/utils/geos.h>
 
 struct OGRSpatialReference;
 struct OGRCoordinateTransformation;
@@ -32,6 +33,13 @@ namespace dataset {
 /// Get the WKT description for the Spaceview projection
 std::string spaceviewWKT(double sublon = 0.0);
 
+/**
+ * Check if \a wkt describes a geostationary projection that
+ * utils::GeosProjection can compute, like the ones of spaceviewWKT(), and if
+ * so set \a proj to its parameters
+ */
+bool geosFromWKT(const char* wkt, utils::GeosProjection& proj);
+
 /// Decode a geotransformation matrix to the image offset and scale 
 void decodeGeotransform(GDALDataset* ds, int& xs, int& ys, double& psx, double& psy);
 
@@ -72,6 +80,9 @@ protected:
 	OGRSpatialReference* latlon;
 	OGRCoordinateTransformation* toLatLon;
 	OGRCoordinateTransformation* fromLatLon;
+	/// True if the projection is computed with geos instead of OGR
+	bool use_geos;
+	utils::GeosProjection geos;
 
 public:
 	GeoReferencer();
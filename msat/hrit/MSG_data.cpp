@@ -28,9 +28,25 @@
 //-----------------------------------------------------------------------------
 
 #include <string>
+#include <stdexcept>
 #include <fstream>
+#include <memory>
 #include <msat/hrit/MSG_data.h>
 
+namespace {
+
+// Read the data field that follows the header of a file
+std::unique_ptr<unsigned char_1[]> read_data_field( std::ifstream &in, size_t dsize )
+{
+  std::unique_ptr<unsigned char_1[]> res(new unsigned char_1[dsize]);
+  in.read((char *) res.get( ), dsize);
+  if (in.fail( ))
+    throw std::runtime_error("Read error from HRIT file: Data field.");
+  return res;
+}
+
+}
+
 std::ostream& operator<< ( std::ostream& os, MSG_data_level_15_header &h )
 {
   os << h.sat_status
@@ -84,6 +100,7 @@ void MSG_data::read_from( std::ifstream &in, MSG_header &header )
 {
   size_t dsize;
   size_t dpos;
+  std::unique_ptr<unsigned char_1[]> dfield;
   unsigned char_1 *dbuff = 0;
   unsigned char_1 *dpnt = 0;
 
@@ -94,25 +111,34 @@ void MSG_data::read_from( std::ifstream &in, MSG_header &header )
       image = new MSG_data_image;
 
       dsize = header.data_field_length / 8;
-      dbuff = new unsigned char_1[dsize];
-      in.read((char *) dbuff, dsize);
-      if (in.fail( ))
-      {
-        std::cerr << "Read error from HRIT file: Data field." << std::endl;
-        throw;
-      }
 
       if (header.image_structure->compression_flag == MSG_NO_COMPRESSION)
       {
+        // Read the samples straight into the image buffer
         image->len = dsize;
-        image->data = (MSG_SAMPLE *) ( new char[dsize] );
-        memcpy(image->data, dbuff, dsize);
+        image->data = new MSG_SAMPLE[(dsize + sizeof(MSG_SAMPLE) - 1) / sizeof(MSG_SAMPLE)];
+        in.read((char *) image->data, dsize);
+        if (in.fail( ))
+        {
+          throw std::runtime_error("Read error from HRIT file: Data field.");
+        }
+        // 16 bit samples are stored big endian
+        if (header.image_structure->number_of_bits_per_pixel == 16)
+          for (size_t i = 0; i < dsize / 2; i ++)
+            image->data[i] = get_ui2((unsigned char_1 *) (image->data + i));
       }
       else
       {
+        // The encoded buffer is handed over to the decompressor, which frees
+        // it as soon as it is no longer needed
         MSG_data_image_encoded encoded;
-        encoded.data   = dbuff;
+        encoded.data   = new uint_1[dsize];
         encoded.len    = dsize;
+        in.read((char *) encoded.data, dsize);
+        if (in.fail( ))
+        {
+          throw std::runtime_error("Read error from HRIT file: Data field.");
+        }
         encoded.bpp    = header.image_structure->number_of_bits_per_pixel;
         encoded.nx     = header.image_structure->number_of_columns;
         encoded.ny     = header.image_structure->number_of_lines;
@@ -124,13 +150,8 @@ void MSG_data::read_from( std::ifstream &in, MSG_header &header )
     case MSG_FILE_GTS_MESSAGE:
 
       dsize = header.data_field_length / 8;
-      dbuff = new unsigned char_1[dsize];
-      in.read((char *) dbuff, dsize);
-      if (in.fail( ))
-      {
-        std::cerr << "Read error from HRIT file: Data field." << std::endl;
-        throw;
-      }
+      dfield = read_data_field(in, dsize);
+      dbuff = dfield.get( );
       gts_message = new MSG_data_gts;
       dpos = gts_message->read_from(dbuff, dsize);
       {
@@ -145,13 +166,8 @@ void MSG_data::read_from( std::ifstream &in, MSG_header &header )
     case MSG_FILE_ALPHANUMERIC_TEXT:
 
       dsize = header.data_field_length / 8;
-      dbuff = new unsigned char_1[dsize];
-      in.read((char *) dbuff, dsize);
-      if (in.fail( ))
-      {
-        std::cerr << "Read error from HRIT file: Data field." << std::endl;
-        throw;
-      }
+      dfield = read_data_field(in, dsize);
+      dbuff = dfield.get( );
       text_message = new MSG_data_text;
       dpos = text_message->read_from(dbuff, dsize);
 
@@ -161,13 +177,8 @@ void MSG_data::read_from( std::ifstream &in, MSG_header &header )
     case MSG_FILE_ENCRYPTION_KEY_MESSAGE:
 
       dsize = header.data_field_length / 8;
-      dbuff = new unsigned char_1[dsize];
-      in.read((char *) dbuff, dsize);
-      if (in.fail( ))
-      {
-        std::cerr << "Read error from HRIT file: Data field." << std::endl;
-        throw;
-      }
+      dfield = read_data_field(in, dsize);
+      dbuff = dfield.get( );
       key_message = new MSG_data_key;
       dpos = key_message->read_from(dbuff, dsize);
 
@@ -176,13 +187,8 @@ void MSG_data::read_from( std::ifstream &in, MSG_header &header )
     case MSG_FILE_REPEAT_CYCLE_PROLOGUE:
       dsize = header.data_field_length / 8;
 
-      dbuff = new unsigned char_1[dsize];
-      in.read((char *) dbuff, dsize);
-      if (in.fail( ))
-      {
-        std::cerr << "Read error from HRIT file: Data field." << std::endl;
-        throw;
-      }
+      dfield = read_data_field(in, dsize);
+      dbuff = dfield.get( );
 
       if (header.annotation->product_id_1.find("MSG") != std::string::npos)
       {
@@ -232,13 +238,8 @@ void MSG_data::read_from( std::ifstream &in, MSG_header &header )
 
     case MSG_FILE_REPEAT_CYCLE_EPILOGUE:
       dsize = header.data_field_length / 8;
-      dbuff = new unsigned char_1[dsize];
-      in.read((char *) dbuff, dsize);
-      if (in.fail( ))
-      {
-        std::cerr << "Read error from HRIT file: Data field." << std::endl;
-        throw;
-      }
+      dfield = read_data_field(in, dsize);
+      dbuff = dfield.get( );
 
       if (header.annotation->product_id_1.find("MSG") != std::string::npos)
       {
@@ -269,13 +270,8 @@ void MSG_data::read_from( std::ifstream &in, MSG_header &header )
     case MSG_FILE_BINARY_MESSAGE:
 
       dsize = header.data_field_length / 8;
-      dbuff = new unsigned char_1[dsize];
-      in.read((char *) dbuff, dsize);
-      if (in.fail( ))
-      {
-        std::cerr << "Read error from HRIT file: Data field." << std::endl;
-        throw;
-      }
+      dfield = read_data_field(in, dsize);
+      dbuff = dfield.get( );
       {
         std::ofstream os;
         std::string outname;
@@ -283,20 +279,17 @@ void MSG_data::read_from( std::ifstream &in, MSG_header &header )
         outname += ".bin";
         os.open(outname.c_str( ));
         if (!os.good())
-          throw;
+          throw std::runtime_error(outname + ": cannot open for writing");
         os.write((char *) dbuff, (size_t) dsize);
         os.close( );
       }
       break;
 
     default:
-      std::cerr << "Unknown MSG file type " << header.f_typecode << std::endl;
-      throw;
+      throw std::runtime_error("Unknown MSG file type " + std::to_string(header.f_typecode));
       break;
   }
 
-  if (dbuff) delete [ ] dbuff;
-
   return;
 }
 
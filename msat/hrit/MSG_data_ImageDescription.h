@@ -93,7 +93,6 @@ class MSG_coverage_HRV {
   public:
     size_t read_from( unsigned const char_1 *buff );
     friend std::ostream& operator<< ( std::ostream& os, MSG_coverage_HRV &c );
-  private:
     int_4 LowerSouthLinePlanned;
     int_4 LowerNorthLinePlanned;
     int_4 LowerEastColumnPlanned;
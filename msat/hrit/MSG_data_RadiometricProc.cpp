@@ -31,6 +31,8 @@
 #include <cstring>
 #include <iomanip>
 #include <cmath>
+#include <stdexcept>
+#include <string>
 #include <msat/facts.h>
 #include <msat/hrit/MSG_data_RadiometricProc.h>
 
@@ -664,11 +666,8 @@ float radiance_to_reflectance(int chnum, float radiance,
                               int hour, int minute,
                               float lat, float lon)
 {
-  if (chnum != 1 || chnum != 2 || chnum != 3 || chnum != 12)
-  {
-    std::cerr << "Wrong channel number : " << chnum << std::endl;
-    throw;
-  }
+  if (chnum != 1 && chnum != 2 && chnum != 3 && chnum != 12)
+    throw std::runtime_error("Wrong channel number : " + std::to_string(chnum));
 
   int jd = msat::facts::jday(year, month, day);
   double esd = 1.0 - 0.0167 * cos( 2.0 * M_PI * (jd - 3) / 365.0);
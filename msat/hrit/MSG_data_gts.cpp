@@ -29,6 +29,7 @@
 
 #include <fstream>
 #include <cstring>
+#include <stdexcept>
 #include <msat/hrit/MSG_data_gts.h>
 
 MSG_data_gts::MSG_data_gts( )
@@ -52,8 +53,7 @@ size_t MSG_data_gts::read_from( unsigned const char_1 *buff, size_t datasize )
   msize = datasize;
   if (msize == 0 || msize > (MSG_MAX_GTS_MESSAGE_SIZE*MSG_MAX_GTS_MESSAGES))
   {
-    std::cerr << "Invalid GTS message(s) size." << std::endl;
-    throw;
+    throw std::runtime_error("Invalid GTS message(s) size.");
   }
 
   mbuff = new unsigned char_1[msize];
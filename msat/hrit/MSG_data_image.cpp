@@ -28,7 +28,9 @@
 //-----------------------------------------------------------------------------
 
 #include <vector>
+#include <memory>
 #include <cstring>
+#include <stdexcept>
 
 #include <Compress.h>
 #include <CompressT4.h>
@@ -39,42 +41,53 @@
 
 #include <msat/hrit/MSG_data_image.h>
 
-void MSG_data_image_encoded::decode( MSG_data_image *dec )
+void MSG_data_image_encoded::decode( MSG_SAMPLE *out )
 {
-  __int64 dlen = len * 8;
+  std::unique_ptr<COMP::CImage> cimg;
+
+  // Scope the compressed and uncompressed data fields, so that their buffers
+  // are released before we copy out the pixels
+  {
+    // The data field takes ownership of the encoded buffer, and frees it
+    // when it is destroyed
+    __int64 dlen = len * 8;
+    Util::CDataFieldCompressedImage cdata(data, dlen, bpp, nx, ny);
+    data = 0;
+    len = 0;
 
-  uint_1 *ibuf = new uint_1[len];
-  memcpy(ibuf, data, len);
-  Util::CDataFieldCompressedImage cdata =
-                    Util::CDataFieldCompressedImage(ibuf, dlen, bpp, nx, ny);
+    Util::CDataFieldUncompressedImage udata;
+    std::vector <short> QualityInfo;
 
-  Util::CDataFieldUncompressedImage udata;
-  std::vector <short> QualityInfo;
+    switch (format)
+    {
+      case MSG_JPEG_FORMAT:
+        COMP::DecompressJPEG(cdata, bpp, udata, QualityInfo);
+        break;
+      case MSG_WAVELET_FORMAT:
+        COMP::DecompressWT(cdata, bpp, udata, QualityInfo);
+        break;
+      case MSG_T4_FORMAT:
+        COMP::DecompressT4(cdata, udata, QualityInfo);
+        break;
+      default:
+        throw std::runtime_error("Unknown compression used.");
+    }
 
-  switch (format)
-  {
-    case MSG_JPEG_FORMAT:
-      COMP::DecompressJPEG(cdata, bpp, udata, QualityInfo);
-      break;
-    case MSG_WAVELET_FORMAT:
-      COMP::DecompressWT(cdata, bpp, udata, QualityInfo);
-      break;
-    case MSG_T4_FORMAT:
-      COMP::DecompressT4(cdata, udata, QualityInfo);
-      break;
-    default:
-      std::cerr << "Unknown compression used." << std::endl;
-      throw;
+    cimg.reset(new COMP::CImage(udata));
   }
 
-  COMP::CImage cimg(udata);
+  // CImage does not let go of its pixels, so this last copy is unavoidable
+  memcpy(out, cimg->Get( ), (size_t) nx * ny * sizeof(MSG_SAMPLE));
+}
 
-  int decnum = nx * ny;
-  dec->data = new MSG_SAMPLE[decnum];
-  memcpy(dec->data, cimg.Get( ), decnum*sizeof(MSG_SAMPLE));
+void MSG_data_image_encoded::decode( MSG_data_image *dec )
+{
+  size_t decnum = (size_t) nx * ny;
+  std::unique_ptr<MSG_SAMPLE[]> buf(new MSG_SAMPLE[decnum]);
+  decode(buf.get());
+  if (dec->data) delete [ ] dec->data;
+  dec->data = buf.release();
   dec->len  = decnum;
-
-  return;
 }
 
 std::ostream& operator<< ( std::ostream& os, MSG_data_image &i )
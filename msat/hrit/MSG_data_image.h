@@ -74,15 +74,38 @@ class MSG_data_image {
 
 class MSG_data_image_encoded {
   public:
+
+    MSG_data_image_encoded( )
+    {
+      data = 0;
+      len = 0;
+    }
+
+    ~MSG_data_image_encoded( )
+    {
+      if (data) delete [ ] data;
+    }
+
     size_t len;
+    // Encoded data, allocated with new[] and owned by this object
     uint_1 *data;
     int nx;
     int ny;
     int bpp;
     t_enum_MSG_data_format format;
 
+    // Decode into a newly allocated dec->data.
+    // Ownership of data passes to the decompressor, and data is set to 0.
     void decode( MSG_data_image *dec );
 
+    // Decode into a caller supplied buffer of at least nx*ny samples.
+    // Ownership of data passes to the decompressor, and data is set to 0.
+    void decode( MSG_SAMPLE *out );
+
+  private:
+    MSG_data_image_encoded( const MSG_data_image_encoded& );
+    MSG_data_image_encoded& operator=( const MSG_data_image_encoded& );
+
 };
 
 
@@ -28,6 +28,7 @@
 //-----------------------------------------------------------------------------
 
 #include <cstring>
+#include <stdexcept>
 #include <msat/hrit/MSG_data_key.h>
 
 MSG_data_key::MSG_data_key( )
@@ -51,8 +52,7 @@ size_t MSG_data_key::read_from( unsigned const char_1 *buff, size_t datasize )
   nkeys = datasize / MSG_KEY_MESSAGE_LEN;
   if (nkeys > MSG_MAX_NUMBER_KEY_MESSAGES || nkeys <= 0)
   {
-    std::cerr << "Key message number or size invalid." << std::endl;
-    throw;
+    throw std::runtime_error("Key message number or size invalid.");
   }
 
   keys = new MSG_encryption_key[nkeys];
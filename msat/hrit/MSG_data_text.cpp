@@ -29,6 +29,7 @@
 
 #include <fstream>
 #include <cstring>
+#include <stdexcept>
 #include <msat/hrit/MSG_data_text.h>
 
 MSG_data_text::MSG_data_text( )
@@ -52,8 +53,7 @@ size_t MSG_data_text::read_from( unsigned const char_1 *buff, size_t datasize )
   tsize = datasize;
   if (tsize == 0)
   {
-    std::cerr << "Invalid TEXT message size." << std::endl;
-    throw;
+    throw std::runtime_error("Invalid TEXT message size.");
   }
 
   tbuff = new unsigned char_1[tsize];
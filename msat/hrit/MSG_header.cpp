@@ -28,6 +28,9 @@
 //-----------------------------------------------------------------------------
 
 #include <cstring>
+#include <stdexcept>
+#include <string>
+#include <memory>
 
 #include <msat/hrit/MSG_header.h>
 
@@ -74,58 +77,52 @@ MSG_header::~MSG_header( )
 void MSG_header::read_from( std::ifstream &in )
 {
   unsigned char_1 primary_header[MSG_HEADER_PRIMARY_LEN];
-  unsigned char_1 *hbuff;
 
-  check_endianess( );
   in.read((char_1 *) primary_header, MSG_HEADER_PRIMARY_LEN);
   if (in.fail( ))
   {
-    std::cerr << "Read error from HRIT file: Primary Header." << std::endl;
-    throw;
+    throw std::runtime_error("Read error from HRIT file: Primary Header.");
   }
   if (primary_header[0] != MSG_HEADER_PRIMARY)
   {
-    std::cerr << "Error: First header type value is not primary." << std::endl;
-    throw;
+    throw std::runtime_error("Error: First header type value is not primary.");
   }
   if (get_ui2(primary_header+1) != MSG_HEADER_PRIMARY_LEN)
   {
-    std::cerr << "Error: Primary Header Length mismatch." << std::endl;
-    std::cerr << "Header Length: " << get_ui2(primary_header+1) << std::endl;
-    throw;
+    throw std::runtime_error(std::string("Error: Primary Header Length mismatch. Header Length: ")
+                             + std::to_string(get_ui2(primary_header+1)));
   }
   f_typecode = (t_enum_MSG_filetype) *(primary_header+3);
   total_header_length = get_ui4(primary_header+4);
   data_field_length   = get_ui8(primary_header+8);
   filesize = data_field_length/8+total_header_length;
+  if (total_header_length < MSG_HEADER_PRIMARY_LEN)
+    throw std::runtime_error("Error: Total Header Length " + std::to_string(total_header_length)
+                             + " is shorter than the Primary Header.");
   size_t hsize = total_header_length-MSG_HEADER_PRIMARY_LEN;
-  hbuff = new unsigned char_1[hsize];
-  if (!hbuff)
-  {
-    std::cerr << "Memory allocation error in MSG_header." << std::endl
-              << "Requested allocation of " << hsize << " bytes." << std::endl;
-    throw;
-  }
-  in.read((char_1 *) hbuff, hsize);
+  std::unique_ptr<unsigned char_1[]> hbuff(new unsigned char_1[hsize]);
+  in.read((char_1 *) hbuff.get( ), hsize);
   if (in.fail( ))
   {
-    std::cerr << "Read error from HRIT file: Header body" << std::endl;
-    throw;
+    throw std::runtime_error("Read error from HRIT file: Header body");
   }
-  unsigned char_1 *pnt = hbuff;
+  unsigned char_1 *pnt = hbuff.get( );
   size_t left = hsize;
   size_t hunk_size = 0;
   size_t hqlen = 0;
   while (left)
   {
+    // Every header record starts with its type and length
+    if (left < 3 || get_ui2(pnt+1) < 3 || get_ui2(pnt+1) > left)
+      throw std::runtime_error("Error: Truncated header record, unparsed "
+                               + std::to_string(left) + " bytes.");
     switch(*pnt)
     {
       case MSG_HEADER_IMAGE_STRUCTURE:
         if (get_ui2(pnt+1) != MSG_IMAGE_STRUCTURE_LEN)
         {
-          std::cerr << "Error: Image Structure Header mismatch." << std::endl;
-          std::cerr << "Header Length: " << get_ui2(pnt+1) << std::endl;
-          throw;
+          throw std::runtime_error(std::string("Error: Image Structure Header mismatch. Header Length: ")
+                                   + std::to_string(get_ui2(pnt+1)));
         }
         image_structure = new MSG_header_image_struct;
         image_structure->read_from(pnt);
@@ -135,9 +132,8 @@ void MSG_header::read_from( std::ifstream &in )
       case MSG_HEADER_IMAGE_NAVIGATION:
         if (get_ui2(pnt+1) != MSG_IMAGE_NAVIGATION_LEN)
         {
-          std::cerr << "Error: Image Navigation Header mismatch." << std::endl;
-          std::cerr << "Header Length: " << get_ui2(pnt+1) << std::endl;
-          throw;
+          throw std::runtime_error(std::string("Error: Image Navigation Header mismatch. Header Length: ")
+                                   + std::to_string(get_ui2(pnt+1)));
         }
         image_navigation = new MSG_header_image_navig;
         image_navigation->read_from(pnt);
@@ -154,9 +150,8 @@ void MSG_header::read_from( std::ifstream &in )
       case MSG_HEADER_ANNOTATION:
         if (get_ui2(pnt+1) != MSG_ANNOTATION_LEN)
         {
-          std::cerr << "Error: Annotation Header mismatch." << std::endl;
-          std::cerr << "Header Length: " << get_ui2(pnt+1) << std::endl;
-          throw;
+          throw std::runtime_error(std::string("Error: Annotation Header mismatch. Header Length: ")
+                                   + std::to_string(get_ui2(pnt+1)));
         }
         annotation = new MSG_header_annotation;
         annotation->read_from(pnt);
@@ -166,9 +161,8 @@ void MSG_header::read_from( std::ifstream &in )
       case MSG_HEADER_TIMESTAMP:
         if (get_ui2(pnt+1) != MSG_TIMESTAMP_LEN)
         {
-          std::cerr << "Error: Timestamp Header mismatch." << std::endl;
-          std::cerr << "Header Length: " << get_ui2(pnt+1) << std::endl;
-          throw;
+          throw std::runtime_error(std::string("Error: Timestamp Header mismatch. Header Length: ")
+                                   + std::to_string(get_ui2(pnt+1)));
         }
         timestamp = new MSG_header_timestamp;
         timestamp->read_from(pnt);
@@ -185,9 +179,8 @@ void MSG_header::read_from( std::ifstream &in )
       case MSG_HEADER_KEY:
         if (get_ui2(pnt+1) != MSG_KEY_LEN)
         {
-          std::cerr << "Error: Key Header mismatch." << std::endl;
-          std::cerr << "Header Length: " << get_ui2(pnt+1) << std::endl;
-          throw;
+          throw std::runtime_error(std::string("Error: Key Header mismatch. Header Length: ")
+                                   + std::to_string(get_ui2(pnt+1)));
         }
         key = new MSG_header_key;
         key->read_from(pnt);
@@ -197,9 +190,8 @@ void MSG_header::read_from( std::ifstream &in )
       case MSG_HEADER_SEGMENT_IDENTIFICATION:
         if (get_ui2(pnt+1) != MSG_SEGMENT_ID_LEN)
         {
-          std::cerr << "Error: Segment Id Header mismatch." << std::endl;
-          std::cerr << "Header Length: " << get_ui2(pnt+1) << std::endl;
-          throw;
+          throw std::runtime_error(std::string("Error: Segment Id Header mismatch. Header Length: ")
+                                   + std::to_string(get_ui2(pnt+1)));
         }
         segment_id = new MSG_header_segment_id;
         segment_id->read_from(pnt);
@@ -214,13 +206,11 @@ void MSG_header::read_from( std::ifstream &in )
         left = left - hqlen;
         break;
       default:
-        std::cerr << "Unknown header type: " << (uint_2) *pnt << std::endl;
-        std::cerr << "Unparsed " << left << " bytes." << std::endl;
-        throw;
+        throw std::runtime_error("Unknown header type: " + std::to_string((uint_2) *pnt)
+                                 + ", unparsed " + std::to_string(left) + " bytes.");
         break;
       }
    }
-   delete [ ] hbuff;
    return;
 }
 
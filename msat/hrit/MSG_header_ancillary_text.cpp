@@ -28,6 +28,8 @@
 //-----------------------------------------------------------------------------
 
 #include <cstring>
+#include <stdexcept>
+#include <string>
 
 #include <msat/hrit/MSG_header_ancillary_text.h>
 
@@ -51,20 +53,12 @@ MSG_header_ancillary_text::~MSG_header_ancillary_text( )
 
 void MSG_header_ancillary_text::read_from( unsigned const char_1 *buff )
 {
-  size_t h_length = (size_t) get_ui2(buff+1) - 3;
-  if (h_length <= 0)
-  {
-    std::cerr << "Error: Data Function Header length invalid." << std::endl;
-    std::cerr << "Header Length : " << h_length << std::endl;
-    throw;
-  }
+  size_t length = get_ui2(buff+1);
+  if (length <= 3)
+    throw std::runtime_error("Error: Ancillary Text Header length invalid. Header Length : "
+                             + std::to_string(length));
+  size_t h_length = length - 3;
   ancillary_text = new char_1[h_length];
-  if (!ancillary_text)
-  {
-    std::cerr << "Memory error in MSG_header_ancillary_text." << std::endl;
-    std::cerr << "Header Length : " << h_length << std::endl;
-    throw;
-  }
   memcpy(ancillary_text, buff+3, h_length);
   return;
 }
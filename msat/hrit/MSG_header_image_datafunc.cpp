@@ -28,6 +28,8 @@
 //-----------------------------------------------------------------------------
 
 #include <cstring>
+#include <stdexcept>
+#include <string>
 #include <msat/hrit/MSG_header_image_datafunc.h>
 
 MSG_header_image_datafunc::MSG_header_image_datafunc( )
@@ -44,20 +46,12 @@ MSG_header_image_datafunc::~MSG_header_image_datafunc( ) { }
 
 void MSG_header_image_datafunc::read_from( unsigned const char_1 *buff )
 {
-  size_t h_length = (size_t) get_ui2(buff+1) - 2;
-  if (h_length <= 0)
-  {
-    std::cerr << "Error: Data Function Header length invalid." << std::endl;
-    std::cerr << "Header Length : " << h_length - 1 << std::endl;
-    throw;
-  }
+  size_t length = get_ui2(buff+1);
+  if (length <= 2)
+    throw std::runtime_error("Error: Data Function Header length invalid. Header Length : "
+                             + std::to_string(length));
+  size_t h_length = length - 2;
   char_1 *tmpchar = new char_1[h_length];
-  if (!tmpchar)
-  {
-    std::cerr << "Memory error in MSG_header_image_datafunc." << std::endl;
-    std::cerr << "Header Length : " << h_length - 1 << std::endl;
-    throw;
-  }
   memcpy(tmpchar, buff+3, h_length-1);
   tmpchar[h_length-1] = 0;
   data_definition_block = tmpchar;
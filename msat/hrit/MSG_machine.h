@@ -49,24 +49,86 @@
 #define real_4 float
 #define real_8 double
 
+// Byte order of the host, known at compile time
+#if defined(__BYTE_ORDER__) && defined(__ORDER_BIG_ENDIAN__)
+#  define MSG_HOST_BIG_ENDIAN (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+#elif defined(WORDS_BIGENDIAN)
+#  define MSG_HOST_BIG_ENDIAN 1
+#else
+#  define MSG_HOST_BIG_ENDIAN 0
+#endif
+
+// Kept for compatibility: the byte order no longer needs to be detected at
+// runtime, and this does nothing
 void check_endianess();
 
-int_1 get_i1(const unsigned char_1 *buff);
-int_2 get_i2(const unsigned char_1 *buff);
-int_4 get_i4(const unsigned char_1 *buff);
-int_8 get_i8(const unsigned char_1 *buff);
+// Decoding of the big endian values found in xRIT files. These functions
+// work on any byte order and alignment, and have no state, so they can be
+// called from multiple threads.
+
+inline uint_1 get_ui1(const unsigned char_1 *buff)
+{
+  return buff[0];
+}
+
+inline uint_2 get_ui2(const unsigned char_1 *buff)
+{
+  return (uint_2) (buff[0] << 8 | buff[1]);
+}
+
+inline uint_4 get_ui4(const unsigned char_1 *buff)
+{
+  return (uint_4) buff[0] << 24 | (uint_4) buff[1] << 16 |
+         (uint_4) buff[2] << 8  | (uint_4) buff[3];
+}
+
+inline uint_8 get_ui8(const unsigned char_1 *buff)
+{
+  return (uint_8) get_ui4(buff) << 32 | get_ui4(buff + 4);
+}
+
+inline int_1 get_i1(const unsigned char_1 *buff)
+{
+  return (int_1) buff[0];
+}
+
+inline int_2 get_i2(const unsigned char_1 *buff)
+{
+  return (int_2) get_ui2(buff);
+}
+
+inline int_4 get_i4(const unsigned char_1 *buff)
+{
+  return (int_4) get_ui4(buff);
+}
+
+inline int_8 get_i8(const unsigned char_1 *buff)
+{
+  return (int_8) get_ui8(buff);
+}
 
-uint_1 get_ui1(const unsigned char_1 *buff);
-uint_2 get_ui2(const unsigned char_1 *buff);
-uint_4 get_ui4(const unsigned char_1 *buff);
-uint_8 get_ui8(const unsigned char_1 *buff);
+inline real_4 get_r4(const unsigned char_1 *buff)
+{
+  uint_4 bits = get_ui4(buff);
+  real_4 res;
+  memcpy(&res, &bits, sizeof(res));
+  return res;
+}
 
-real_4 get_r4(const unsigned char_1 *buff);
-real_8 get_r8(const unsigned char_1 *buff);
+inline real_8 get_r8(const unsigned char_1 *buff)
+{
+  uint_8 bits = get_ui8(buff);
+  real_8 res;
+  memcpy(&res, &bits, sizeof(res));
+  return res;
+}
 
 void get_mem(const unsigned char_1 *source, unsigned char_1 *dest,
              size_t nbytes);
 
-bool is_big( );
+inline bool is_big( )
+{
+  return MSG_HOST_BIG_ENDIAN;
+}
 
 #endif
@@ -93,16 +93,19 @@ time_t MSG_time_cds_short::get_unixtime( )
   return unixtime;
 }
 
-struct tm *MSG_time_cds_short::get_timestruct( )
+struct tm MSG_time_cds_short::get_timestruct( ) const
 {
-  return gmtime(&unixtime);
+  struct tm res;
+  gmtime_r(&unixtime, &res);
+  return res;
 }
 
 std::string MSG_time_cds_short::get_timestring( )
 {
   std::string timestring;
   char_1 tempchar[128];
-  strftime(tempchar, 128, "%Y-%m-%d %H:%M:%S", gmtime(&unixtime));
+  struct tm tmtime = get_timestruct( );
+  strftime(tempchar, 128, "%Y-%m-%d %H:%M:%S", &tmtime);
   timestring = tempchar;
   sprintf(tempchar, " +%03d msecs", (unsigned int) usecs);
   timestring = timestring + tempchar;
@@ -113,7 +116,8 @@ std::string MSG_time_cds_short::get_timestring( ) const
 {
   std::string timestring;
   char_1 tempchar[128];
-  strftime(tempchar, 128, "%Y-%m-%d %H:%M:%S", gmtime(&unixtime));
+  struct tm tmtime = get_timestruct( );
+  strftime(tempchar, 128, "%Y-%m-%d %H:%M:%S", &tmtime);
   timestring = tempchar;
   sprintf(tempchar, " +%03d msecs", (unsigned int) usecs);
   timestring = timestring + tempchar;
@@ -349,12 +353,15 @@ size_t MSG_time_generalized::read_from( unsigned const char_1 *buff )
 
 time_t MSG_time_generalized::get_unixtime( )
 {
-  return mktime(&generalized_time);
+  // Generalized times are UTC, and converting them must not modify the
+  // object
+  struct tm tmp = generalized_time;
+  return timegm(&tmp);
 }
 
-struct tm *MSG_time_generalized::get_timestruct( )
+struct tm MSG_time_generalized::get_timestruct( ) const
 {
-  return &generalized_time;
+  return generalized_time;
 }
 
 std::string MSG_time_generalized::get_timestring( )
@@ -67,7 +67,8 @@ class MSG_time_generalized {
     size_t read_from( unsigned const char_1 *buff );
 
     time_t get_unixtime( );
-    struct tm *get_timestruct( );
+    // Broken down UTC time
+    struct tm get_timestruct( ) const;
     std::string get_timestring( );
     std::string get_timestring( ) const;
     char_1 *get_timechar( );
@@ -93,7 +94,8 @@ class MSG_time_cds_short {
     uint_4 get_msec_in_day( );
     uint_4 get_msec_in_day( ) const;
     time_t get_unixtime( );
-    struct tm *get_timestruct( );
+    // Broken down UTC time
+    struct tm get_timestruct( ) const;
     std::string get_timestring( );
     std::string get_timestring( ) const;
     char_1 *get_timechar( );
@@ -0,0 +1,192 @@
+#include "geos.h"
+#include <msat/facts.h>
+#include <cmath>
+#include <limits>
+#include <algorithm>
+
+namespace msat {
+namespace utils {
+
+namespace {
+
+const double deg2rad = M_PI / 180.0;
+const double rad2deg = 180.0 / M_PI;
+const double nan = std::numeric_limits<double>::quiet_NaN();
+
+/// Normalize a longitude in degrees to [-180, 180]
+inline double normalize_lon(double lon)
+{
+    if (lon > 180.0) return lon - 360.0;
+    if (lon < -180.0) return lon + 360.0;
+    return lon;
+}
+
+/**
+ * Constants of the projection, with distances in units of the semi-major
+ * axis, following the naming of the CGMS specification
+ */
+struct Constants
+{
+    /// Distance of the satellite from the centre of the Earth
+    double r_sat;
+    /// r_sat² - 1
+    double c;
+    /// Ratio between semi-minor and semi-major axis
+    double r_pol;
+    /// r_pol²
+    double r_pol2;
+
+    Constants(const GeosProjection& p)
+        : r_sat(1.0 + p.height / p.semi_major),
+          c(r_sat * r_sat - 1.0),
+          r_pol(p.semi_minor / p.semi_major),
+          r_pol2(r_pol * r_pol)
+    {
+    }
+};
+
+}
+
+GeosProjection::GeosProjection(double sublon)
+    // Ellipsoid set by spaceviewWKT: a=6378169, 1/f=295.488065897
+    : sublon(sublon), height(ORBIT_RADIUS_FOR_GDAL),
+      semi_major(6378169.0), semi_minor(6378169.0 * (1.0 - 1.0 / 295.488065897))
+{
+}
+
+GeosProjection::GeosProjection(double sublon, double height, double semi_major, double semi_minor)
+    : sublon(sublon), height(height), semi_major(semi_major), semi_minor(semi_minor)
+{
+}
+
+size_t GeosProjection::to_latlon(size_t count, const double* x, const double* y, double* lat, double* lon) const
+{
+    const Constants k(*this);
+    const double inv_height = 1.0 / height;
+    const double inv_r_pol2 = 1.0 / k.r_pol2;
+    size_t on_disk = 0;
+
+    // The loop has no dependencies between iterations, and only the
+    // visibility test branches, so that the compiler can vectorize it
+    for (size_t i = 0; i < count; ++i)
+    {
+        // Direction of the line of sight from the satellite
+        double vy = tan(x[i] * inv_height);
+        double vz = tan(y[i] * inv_height) * sqrt(1.0 + vy * vy);
+
+        // Intersect it with the ellipsoid
+        double zr = vz / k.r_pol;
+        double a = 1.0 + vy * vy + zr * zr;
+        double b = -2.0 * k.r_sat;
+        double det = b * b - 4.0 * a * k.c;
+        if (!(det >= 0.0))
+        {
+            lat[i] = lon[i] = nan;
+            continue;
+        }
+        double s = (-b - sqrt(det)) / (2.0 * a);
+
+        // Geocentric coordinates of the intersection
+        double px = k.r_sat - s;
+        double py = vy * s;
+        double pz = vz * s;
+
+        lon[i] = normalize_lon(atan2(py, px) * rad2deg + sublon);
+        lat[i] = atan(inv_r_pol2 * pz / sqrt(px * px + py * py)) * rad2deg;
+        ++on_disk;
+    }
+
+    return on_disk;
+}
+
+size_t GeosProjection::from_latlon(size_t count, const double* lat, const double* lon, double* x, double* y) const
+{
+    const Constants k(*this);
+    const double inv_r_pol2 = 1.0 / k.r_pol2;
+    size_t visible = 0;
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        double lam = normalize_lon(lon[i] - sublon) * deg2rad;
+
+        // Geocentric latitude and distance from the centre of the Earth
+        double phi = atan(k.r_pol2 * tan(lat[i] * deg2rad));
+        double cphi = cos(phi);
+        double sphi = sin(phi);
+        double r = k.r_pol / sqrt(k.r_pol2 * cphi * cphi + sphi * sphi);
+
+        double px = r * cos(lam) * cphi;
+        double py = r * sin(lam) * cphi;
+        double pz = r * sphi;
+
+        // The point is visible if it is in front of the satellite's horizon
+        double tmp = k.r_sat - px;
+        if (!(tmp * px - py * py - pz * pz * inv_r_pol2 >= 0.0))
+        {
+            x[i] = y[i] = nan;
+            continue;
+        }
+
+        x[i] = height * atan(py / tmp);
+        y[i] = height * atan(pz / sqrt(py * py + tmp * tmp));
+        ++visible;
+    }
+
+    return visible;
+}
+
+size_t GeosProjection::pixels_to_latlon(const double* gt, int x, int y, size_t count, double* lat, double* lon) const
+{
+    // Pixels to projected coordinates
+    for (size_t i = 0; i < count; ++i)
+    {
+        double ix = x + (double)i;
+        lon[i] = gt[0] + gt[1] * ix + gt[2] * y;
+        lat[i] = gt[3] + gt[4] * ix + gt[5] * y;
+    }
+
+    // Projected coordinates to latlon
+    return to_latlon(count, lon, lat, lat, lon);
+}
+
+void GeosProjection::line_span(const double* gt, int y, int width, int& begin, int& end) const
+{
+    begin = end = 0;
+
+    // With vy and vz as in to_latlon, and t = tan(y / h), the line of sight
+    // meets the ellipsoid when (1 + vy²) * (1 + t² / r_pol²) <= r_sat² / c
+    const Constants k(*this);
+    double py = gt[3] + gt[5] * y;
+    double t = tan(py / height);
+    double limit = k.r_sat * k.r_sat / (k.c * (1.0 + t * t / k.r_pol2));
+    if (!(limit >= 1.0)) return;
+
+    // Projected x of the first and last points on the disk, as columns
+    double max_x = height * atan(sqrt(limit - 1.0));
+    double first = (-max_x - gt[0]) / gt[1];
+    double last = (max_x - gt[0]) / gt[1];
+    if (first > last) std::swap(first, last);
+    if (!(last >= 0.0) || !(first < width)) return;
+    begin = first <= 0.0 ? 0 : (int)ceil(first);
+    end = last >= width - 1 ? width : (int)floor(last) + 1;
+
+    // Settle rounding at the edges with the same computation as
+    // pixels_to_latlon
+    auto on_disk = [&](int x) {
+        double px = gt[0] + gt[1] * x + gt[2] * y;
+        double lat, lon;
+        return to_latlon(1, &px, &py, &lat, &lon) == 1;
+    };
+    while (begin < end && !on_disk(begin)) ++begin;
+    while (end > begin && !on_disk(end - 1)) --end;
+    if (begin == end)
+    {
+        begin = end = 0;
+        return;
+    }
+    while (begin > 0 && on_disk(begin - 1)) --begin;
+    while (end < width && on_disk(end)) ++end;
+}
+
+}
+}
@@ -0,0 +1,81 @@
+#ifndef MSAT_UTILS_GEOS_H
+#define MSAT_UTILS_GEOS_H
+
+/**
+ * @author Enrico Zini <enrico@enricozini.org>
+ * @brief Closed-form geostationary projection
+ *
+ * Copyright (C) 2016  Enrico Zini <enrico@debian.org>
+ */
+
+#include <cstddef>
+
+namespace msat {
+namespace utils {
+
+/**
+ * Normalized geostationary projection, as in section 4.4 of the CGMS LRIT/HRIT
+ * Global Specification and in the PROJ geos projection with sweep axis y.
+ *
+ * Projected coordinates are scanning angles multiplied by the satellite
+ * height, as in the geotransform of datasets using spaceviewWKT(). Latitudes
+ * and longitudes are geodetic, in degrees.
+ *
+ * All functions work on arrays, and mark the points that are not on the
+ * visible Earth disk by setting their results to NaN.
+ */
+struct GeosProjection
+{
+    /// Longitude of the sub-satellite point, in degrees
+    double sublon;
+    /// Height of the satellite above the Equator, in metres
+    double height;
+    /// Semi-major axis of the Earth ellipsoid, in metres
+    double semi_major;
+    /// Semi-minor axis of the Earth ellipsoid, in metres
+    double semi_minor;
+
+    /// Projection of spaceviewWKT(sublon)
+    GeosProjection(double sublon=0.0);
+    GeosProjection(double sublon, double height, double semi_major, double semi_minor);
+
+    /**
+     * Convert \a count projected points to latitudes and longitudes.
+     *
+     * Input and output arrays can be the same.
+     *
+     * @returns the number of points that are on the Earth disk
+     */
+    size_t to_latlon(size_t count, const double* x, const double* y, double* lat, double* lon) const;
+
+    /**
+     * Convert \a count latitudes and longitudes to projected points.
+     *
+     * Input and output arrays can be the same.
+     *
+     * @returns the number of points that are visible from the satellite
+     */
+    size_t from_latlon(size_t count, const double* lat, const double* lon, double* x, double* y) const;
+
+    /**
+     * Compute latitudes and longitudes of \a count pixels of line \a y
+     * starting at column \a x, in a raster with geotransform \a gt.
+     *
+     * @returns the number of pixels that are on the Earth disk
+     */
+    size_t pixels_to_latlon(const double* gt, int x, int y, size_t count, double* lat, double* lon) const;
+
+    /**
+     * Compute the columns [begin, end) of line \a y that are on the Earth
+     * disk, in a raster \a width pixels wide with geotransform \a gt.
+     *
+     * The geotransform must not have rotation terms. The result agrees with
+     * the pixels for which pixels_to_latlon() does not return NaN.
+     */
+    void line_span(const double* gt, int y, int width, int& begin, int& end) const;
+};
+
+}
+}
+
+#endif
@@ -0,0 +1,289 @@
+#include "kernels.h"
+#include <cstring>
+#include <algorithm>
+#include <vector>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define MSAT_KERNELS_X86
+#include <immintrin.h>
+#define TARGET_SSE2 __attribute__((target("sse2")))
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+namespace msat {
+namespace utils {
+namespace kernels {
+
+namespace {
+
+inline uint16_t bswap16(uint16_t v)
+{
+    return (v << 8) | (v >> 8);
+}
+
+inline float clamp_calibrated(float v)
+{
+    // NaN compares false and becomes 0 as well
+    return v > 0 ? v : 0;
+}
+
+/*
+ * Scalar implementations, also used to finish the tails of vectorized loops
+ */
+
+void copy_u16_scalar(const uint16_t* src, size_t n, uint16_t* dst, bool reverse, bool bswap)
+{
+    if (!reverse)
+    {
+        if (!bswap)
+            memcpy(dst, src, n * sizeof(uint16_t));
+        else
+            for (size_t i = 0; i < n; ++i)
+                dst[i] = bswap16(src[i]);
+    } else {
+        if (!bswap)
+            for (size_t i = 0; i < n; ++i)
+                dst[n - i - 1] = src[i];
+        else
+            for (size_t i = 0; i < n; ++i)
+                dst[n - i - 1] = bswap16(src[i]);
+    }
+}
+
+void calibrate_scalar(const uint16_t* src, size_t n, const float* lut, float* dst)
+{
+    for (size_t i = 0; i < n; ++i)
+        dst[i] = clamp_calibrated(lut[src[i]]);
+}
+
+/// Average of \a count samples adding up to \a sum, rounded to the nearest integer
+inline uint16_t box_average(uint32_t sum, uint32_t count)
+{
+    return (sum + count / 2) / count;
+}
+
+/// Average of \a count samples adding up to \a sum
+inline float box_average(double sum, uint32_t count)
+{
+    return sum / count;
+}
+
+/// box_decimate, accumulating sums of samples as ACC
+template<typename T, typename ACC>
+void box_decimate_scalar(const T* src, size_t width, size_t height, size_t src_stride,
+                         size_t factor, T* dst, size_t dst_stride)
+{
+    size_t dst_width = (width + factor - 1) / factor;
+    std::vector<ACC> sums(dst_width);
+    std::vector<uint32_t> counts(dst_width);
+    for (size_t y = 0; y < height; y += factor)
+    {
+        std::fill(sums.begin(), sums.end(), 0);
+        std::fill(counts.begin(), counts.end(), 0);
+        for (size_t sy = y; sy < std::min(y + factor, height); ++sy)
+        {
+            const T* line = src + sy * src_stride;
+            for (size_t x = 0; x < width; ++x)
+            {
+                if (line[x] == 0) continue;
+                sums[x / factor] += line[x];
+                ++counts[x / factor];
+            }
+        }
+        T* out = dst + (y / factor) * dst_stride;
+        for (size_t x = 0; x < dst_width; ++x)
+            out[x] = counts[x] ? box_average(sums[x], counts[x]) : 0;
+    }
+}
+
+#ifdef MSAT_KERNELS_X86
+
+/*
+ * SSE2 implementations
+ */
+
+TARGET_SSE2 inline __m128i bswap16_sse2(__m128i v)
+{
+    return _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+}
+
+TARGET_SSE2 inline __m128i reverse16_sse2(__m128i v)
+{
+    v = _mm_shufflelo_epi16(v, _MM_SHUFFLE(0, 1, 2, 3));
+    v = _mm_shufflehi_epi16(v, _MM_SHUFFLE(0, 1, 2, 3));
+    return _mm_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 3, 2));
+}
+
+TARGET_SSE2 void copy_u16_sse2(const uint16_t* src, size_t n, uint16_t* dst, bool reverse, bool bswap)
+{
+    if (!reverse && !bswap)
+    {
+        memcpy(dst, src, n * sizeof(uint16_t));
+        return;
+    }
+
+    size_t i = 0;
+    for ( ; i + 8 <= n; i += 8)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i*)(src + i));
+        if (bswap) v = bswap16_sse2(v);
+        if (reverse)
+            _mm_storeu_si128((__m128i*)(dst + n - i - 8), reverse16_sse2(v));
+        else
+            _mm_storeu_si128((__m128i*)(dst + i), v);
+    }
+    copy_u16_scalar(src + i, n - i, reverse ? dst : dst + i, reverse, bswap);
+}
+
+TARGET_SSE2 void calibrate_sse2(const uint16_t* src, size_t n, const float* lut, float* dst)
+{
+    // SSE2 has no gather: look up values one by one, and vectorize the clamp
+    const __m128 zero = _mm_setzero_ps();
+    size_t i = 0;
+    for ( ; i + 4 <= n; i += 4)
+    {
+        __m128 v = _mm_set_ps(lut[src[i + 3]], lut[src[i + 2]], lut[src[i + 1]], lut[src[i]]);
+        // maxps returns the second operand if the first is NaN
+        _mm_storeu_ps(dst + i, _mm_max_ps(v, zero));
+    }
+    calibrate_scalar(src + i, n - i, lut, dst + i);
+}
+
+/*
+ * AVX2 implementations
+ */
+
+TARGET_AVX2 void copy_u16_avx2(const uint16_t* src, size_t n, uint16_t* dst, bool reverse, bool bswap)
+{
+    if (!reverse && !bswap)
+    {
+        memcpy(dst, src, n * sizeof(uint16_t));
+        return;
+    }
+
+    // Byte shuffles within each 128 bit lane: bswap, reverse, and both
+    const __m256i shuf_bswap = _mm256_setr_epi8(
+            1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14,
+            1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14);
+    const __m256i shuf_reverse = _mm256_setr_epi8(
+            14, 15, 12, 13, 10, 11, 8, 9, 6, 7, 4, 5, 2, 3, 0, 1,
+            14, 15, 12, 13, 10, 11, 8, 9, 6, 7, 4, 5, 2, 3, 0, 1);
+    const __m256i shuf_both = _mm256_setr_epi8(
+            15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0,
+            15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0);
+    const __m256i shuf = reverse ? (bswap ? shuf_both : shuf_reverse) : shuf_bswap;
+
+    size_t i = 0;
+    for ( ; i + 16 <= n; i += 16)
+    {
+        __m256i v = _mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i*)(src + i)), shuf);
+        if (reverse)
+        {
+            // Swap the two lanes to complete the reversal
+            v = _mm256_permute2x128_si256(v, v, 1);
+            _mm256_storeu_si256((__m256i*)(dst + n - i - 16), v);
+        } else
+            _mm256_storeu_si256((__m256i*)(dst + i), v);
+    }
+    copy_u16_scalar(src + i, n - i, reverse ? dst : dst + i, reverse, bswap);
+}
+
+TARGET_AVX2 void calibrate_avx2(const uint16_t* src, size_t n, const float* lut, float* dst)
+{
+    const __m256 zero = _mm256_setzero_ps();
+    size_t i = 0;
+    for ( ; i + 8 <= n; i += 8)
+    {
+        __m256i idx = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)(src + i)));
+        __m256 v = _mm256_i32gather_ps(lut, idx, 4);
+        // maxps returns the second operand if the first is NaN
+        _mm256_storeu_ps(dst + i, _mm256_max_ps(v, zero));
+    }
+    calibrate_scalar(src + i, n - i, lut, dst + i);
+}
+
+#endif
+
+ISA detect_isa()
+{
+#ifdef MSAT_KERNELS_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        return ISA::AVX2;
+    if (__builtin_cpu_supports("sse2"))
+        return ISA::SSE2;
+#endif
+    return ISA::SCALAR;
+}
+
+}
+
+ISA best_isa()
+{
+    static const ISA isa = detect_isa();
+    return isa;
+}
+
+const char* isa_name(ISA isa)
+{
+    switch (isa)
+    {
+        case ISA::SCALAR: return "scalar";
+        case ISA::SSE2: return "sse2";
+        case ISA::AVX2: return "avx2";
+    }
+    return "unknown";
+}
+
+void copy_u16(ISA isa, const uint16_t* src, size_t n, uint16_t* dst, bool reverse, bool bswap)
+{
+    switch (isa)
+    {
+#ifdef MSAT_KERNELS_X86
+        case ISA::AVX2: copy_u16_avx2(src, n, dst, reverse, bswap); break;
+        case ISA::SSE2: copy_u16_sse2(src, n, dst, reverse, bswap); break;
+#endif
+        default: copy_u16_scalar(src, n, dst, reverse, bswap); break;
+    }
+}
+
+void calibrate(ISA isa, const uint16_t* src, size_t n, const float* lut, float* dst, size_t lead, size_t trail)
+{
+    std::fill(dst, dst + lead, 0.0f);
+    dst += lead;
+    switch (isa)
+    {
+#ifdef MSAT_KERNELS_X86
+        case ISA::AVX2: calibrate_avx2(src, n, lut, dst); break;
+        case ISA::SSE2: calibrate_sse2(src, n, lut, dst); break;
+#endif
+        default: calibrate_scalar(src, n, lut, dst); break;
+    }
+    std::fill(dst + n, dst + n + trail, 0.0f);
+}
+
+void copy_u16(const uint16_t* src, size_t n, uint16_t* dst, bool reverse, bool bswap)
+{
+    copy_u16(best_isa(), src, n, dst, reverse, bswap);
+}
+
+void calibrate(const uint16_t* src, size_t n, const float* lut, float* dst, size_t lead, size_t trail)
+{
+    calibrate(best_isa(), src, n, lut, dst, lead, trail);
+}
+
+void box_decimate(const uint16_t* src, size_t width, size_t height, size_t src_stride,
+                  size_t factor, uint16_t* dst, size_t dst_stride)
+{
+    box_decimate_scalar<uint16_t, uint32_t>(src, width, height, src_stride, factor, dst, dst_stride);
+}
+
+void box_decimate(const float* src, size_t width, size_t height, size_t src_stride,
+                  size_t factor, float* dst, size_t dst_stride)
+{
+    box_decimate_scalar<float, double>(src, width, height, src_stride, factor, dst, dst_stride);
+}
+
+}
+}
+}
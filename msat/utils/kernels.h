@@ -0,0 +1,80 @@
+#ifndef MSAT_KERNELS_H
+#define MSAT_KERNELS_H
+
+/**
+ * @author Enrico Zini <enrico@enricozini.org>
+ * @brief Vectorized inner loops used to convert scanlines
+ *
+ * Copyright (C) 2016  Enrico Zini <enrico@debian.org>
+ */
+
+#include <cstddef>
+#include <cstdint>
+
+namespace msat {
+namespace utils {
+namespace kernels {
+
+/// Instruction sets for which kernels are implemented
+enum class ISA
+{
+    SCALAR,
+    SSE2,
+    AVX2,
+};
+
+/// Best instruction set supported by the CPU we are running on
+ISA best_isa();
+
+/// Name of an instruction set
+const char* isa_name(ISA isa);
+
+/**
+ * Copy \a n 16 bit samples from \a src to \a dst.
+ *
+ * If \a reverse is true, the samples are written in reverse order, that is,
+ * dst[i] = src[n - i - 1]. If \a bswap is true, the bytes of each sample are
+ * swapped.
+ *
+ * \a src and \a dst must not overlap.
+ */
+void copy_u16(ISA isa, const uint16_t* src, size_t n, uint16_t* dst, bool reverse, bool bswap);
+
+/**
+ * Calibrate a line of samples using a lookup table.
+ *
+ * Writes \a lead zeros, then lut[src[i]] for each of the \a n samples, then
+ * \a trail zeros. Negative and NaN values from the table are written as 0.
+ */
+void calibrate(ISA isa, const uint16_t* src, size_t n, const float* lut, float* dst, size_t lead, size_t trail);
+
+/// copy_u16 using the best available instruction set
+void copy_u16(const uint16_t* src, size_t n, uint16_t* dst, bool reverse, bool bswap);
+
+/// calibrate using the best available instruction set
+void calibrate(const uint16_t* src, size_t n, const float* lut, float* dst, size_t lead, size_t trail);
+
+/**
+ * Shrink an image by \a factor in both directions, replacing each
+ * factor x factor box with the average of its nonzero samples, or with 0 if
+ * they are all 0, since 0 marks areas without data.
+ *
+ * \a src has \a width x \a height samples, with lines \a src_stride samples
+ * apart. \a dst receives ceil(width / factor) x ceil(height / factor)
+ * samples, with lines \a dst_stride samples apart. Boxes on the right and
+ * bottom edges can be partial.
+ *
+ * There is only a scalar implementation, which the compiler can vectorize.
+ */
+void box_decimate(const uint16_t* src, size_t width, size_t height, size_t src_stride,
+                  size_t factor, uint16_t* dst, size_t dst_stride);
+
+/// box_decimate for floating point samples
+void box_decimate(const float* src, size_t width, size_t height, size_t src_stride,
+                  size_t factor, float* dst, size_t dst_stride);
+
+}
+}
+}
+
+#endif
@@ -0,0 +1,91 @@
+#include "threadpool.h"
+#include <cstdlib>
+
+namespace msat {
+namespace utils {
+
+ThreadPool::ThreadPool(unsigned nthreads)
+{
+    if (nthreads < 1) nthreads = 1;
+    for (unsigned i = 0; i < nthreads; ++i)
+        workers.emplace_back([this] { worker_main(); });
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        job_done.wait(lock, [this] { return queue.empty() && running == 0; });
+        shutting_down = true;
+    }
+    has_work.notify_all();
+    for (auto& w: workers)
+        w.join();
+}
+
+void ThreadPool::worker_main()
+{
+    while (true)
+    {
+        std::function<void()> job;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            has_work.wait(lock, [this] { return shutting_down || !queue.empty(); });
+            if (queue.empty()) return;
+            job = std::move(queue.front());
+            queue.pop_front();
+            ++running;
+        }
+
+        std::exception_ptr job_error;
+        try {
+            job();
+        } catch (...) {
+            job_error = std::current_exception();
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            --running;
+            if (job_error && !error)
+                error = job_error;
+        }
+        job_done.notify_all();
+    }
+}
+
+void ThreadPool::submit(std::function<void()> job)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        queue.emplace_back(std::move(job));
+    }
+    has_work.notify_one();
+}
+
+void ThreadPool::wait()
+{
+    std::exception_ptr e;
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        job_done.wait(lock, [this] { return queue.empty() && running == 0; });
+        e = error;
+        error = nullptr;
+    }
+    if (e) std::rethrow_exception(e);
+}
+
+unsigned ThreadPool::parse_count(const std::string& val)
+{
+    if (val == "ALL_CPUS")
+    {
+        unsigned res = std::thread::hardware_concurrency();
+        return res ? res : 1;
+    }
+    long res = strtol(val.c_str(), nullptr, 10);
+    if (res < 1) return 1;
+    return res;
+}
+
+}
+}
@@ -0,0 +1,80 @@
+#ifndef MSAT_THREADPOOL_H
+#define MSAT_THREADPOOL_H
+
+/**
+ * @author Enrico Zini <enrico@enricozini.org>
+ * @brief Simple pool of worker threads
+ *
+ * Copyright (C) 2016  Enrico Zini <enrico@debian.org>
+ */
+
+#include <functional>
+#include <deque>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+#include <string>
+
+namespace msat {
+namespace utils {
+
+/**
+ * Fixed-size pool of worker threads running jobs from a FIFO queue.
+ *
+ * Exceptions raised by jobs are stored, and the first one is rethrown by
+ * wait().
+ */
+class ThreadPool
+{
+protected:
+    std::vector<std::thread> workers;
+    std::deque<std::function<void()>> queue;
+    std::mutex mutex;
+    /// Signaled when a job is queued or when the pool is shutting down
+    std::condition_variable has_work;
+    /// Signaled when a job is done
+    std::condition_variable job_done;
+    /// Number of jobs currently running
+    unsigned running = 0;
+    bool shutting_down = false;
+    std::exception_ptr error;
+
+    void worker_main();
+
+public:
+    /// Create a pool with the given number of threads (at least 1)
+    ThreadPool(unsigned nthreads);
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    /// Wait for all queued jobs to finish, then stop the workers
+    ~ThreadPool();
+
+    /// Number of worker threads
+    unsigned size() const { return workers.size(); }
+
+    /// Queue a job for execution
+    void submit(std::function<void()> job);
+
+    /**
+     * Wait until all queued jobs have been run.
+     *
+     * If any job raised an exception, rethrow the first one.
+     */
+    void wait();
+
+    /**
+     * Parse a number of threads from a string.
+     *
+     * "ALL_CPUS" (as in GDAL_NUM_THREADS) gives the number of available
+     * processors. Empty strings, invalid values and values less than 1 give 1.
+     */
+    static unsigned parse_count(const std::string& val);
+};
+
+}
+}
+
+#endif
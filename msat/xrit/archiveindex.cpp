@@ -0,0 +1,412 @@
+/*
+ * xrit/archiveindex - Catalog of the xRIT products in a directory tree
+ *
+ * Copyright (C) 2016  ARPA-SIM <urpsim@smr.arpa.emr.it>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Enrico Zini <enrico@enricozini.org>
+ */
+
+#include <msat/xrit/archiveindex.h>
+#include <msat/xrit/fileaccess.h>
+#include <msat/hrit/MSG_HRIT.h>
+#include <msat/utils/threadpool.h>
+#include <msat/utils/string.h>
+#include <msat/utils/sys.h>
+#include <msat/facts.h>
+#include <stdexcept>
+#include <sstream>
+#include <fstream>
+#include <algorithm>
+#include <mutex>
+#include <cstdio>
+#include <cstdlib>
+#include <sys/stat.h>
+
+using namespace std;
+
+namespace msat {
+namespace xrit {
+
+namespace {
+
+const char* index_signature = "msat-index 1";
+
+std::string deunderscore(const std::string& str)
+{
+    size_t end = str.find_last_not_of('_');
+    return end == string::npos ? string() : str.substr(0, end + 1);
+}
+
+/**
+ * Split an xRIT file name in its 8 dash separated fields:
+ * resolution-nnn-xxxxxx-productid1-productid2-segment-datetime-suffix
+ */
+bool split_name(const std::string& name, std::vector<std::string>& fields)
+{
+    fields.clear();
+    str::Split splitter(name, "-");
+    for (const auto& f: splitter)
+        fields.push_back(f);
+    return fields.size() == 8;
+}
+
+std::string make_key(const std::string& dir, const std::string& resolution,
+                     const std::string& productid1, const std::string& productid2,
+                     const std::string& timing)
+{
+    return dir + "/" + resolution + ":" + productid1 + ":" + productid2 + ":" + timing;
+}
+
+/// Format a sorted list of numbers as comma separated ranges, like 1-5,7
+std::string format_ranges(const std::vector<unsigned>& nums)
+{
+    if (nums.empty()) return "-";
+    stringstream out;
+    for (size_t i = 0; i < nums.size(); )
+    {
+        size_t j = i;
+        while (j + 1 < nums.size() && nums[j + 1] == nums[j] + 1)
+            ++j;
+        if (i) out << ",";
+        out << nums[i];
+        if (j > i) out << "-" << nums[j];
+        i = j + 1;
+    }
+    return out.str();
+}
+
+std::vector<unsigned> parse_ranges(const std::string& str)
+{
+    vector<unsigned> res;
+    if (str == "-") return res;
+    str::Split splitter(str, ",");
+    for (const auto& range: splitter)
+    {
+        size_t dash = range.find('-');
+        unsigned first = strtoul(range.c_str(), nullptr, 10);
+        unsigned last = dash == string::npos ? first : strtoul(range.c_str() + dash + 1, nullptr, 10);
+        for (unsigned n = first; n <= last; ++n)
+            res.push_back(n);
+    }
+    return res;
+}
+
+/// Read the header of a segment and fill in the product information from it
+void scan_product(ArchiveIndex::Product& p)
+{
+    try {
+        string pathname = p.directory + "/" + p.segment_name;
+        std::ifstream hrit(pathname.c_str(), (std::ios::binary | std::ios::in));
+        if (hrit.fail()) throw std::runtime_error(pathname + ": cannot open");
+        MSG_header header;
+        header.read_from(hrit);
+        if (!header.segment_id) throw std::runtime_error(pathname + ": segment identification is missing");
+        p.spacecraft_id = facts::spacecraftIDFromHRIT(header.segment_id->spacecraft_id);
+        p.channel_id = header.segment_id->spectral_channel_id;
+        p.planned_start = header.segment_id->planned_start_segment_sequence_number;
+        p.planned_end = header.segment_id->planned_end_segment_sequence_number;
+    } catch (std::exception&) {
+        p.flags |= ArchiveIndex::UNREADABLE;
+        return;
+    }
+
+    for (unsigned n = p.planned_start; n <= p.planned_end; ++n)
+        if (!binary_search(p.segments.begin(), p.segments.end(), n))
+        {
+            p.flags |= ArchiveIndex::MISSING_SEGMENTS;
+            break;
+        }
+}
+
+void walk(const std::string& dirname, std::map<std::string, ArchiveIndex::Product>& products,
+          std::map<std::string, ArchiveIndex::Slot>& slots, std::set<std::string>& directories)
+{
+    directories.insert(dirname);
+
+    vector<string> subdirs;
+    vector<string> fields;
+    sys::Path dir(dirname);
+    for (auto i = dir.begin(); i != dir.end(); ++i)
+    {
+        string name = i->d_name;
+        if (name == "." || name == "..") continue;
+        if (i.isdir())
+        {
+            subdirs.push_back(name);
+            continue;
+        }
+        if (!split_name(name, fields)) continue;
+
+        if (fields[7] == "C_")
+        {
+            int num = segmentNumber(name);
+            if (num < 0) continue;
+            string key = make_key(dirname, fields[0], deunderscore(fields[3]), deunderscore(fields[4]), deunderscore(fields[6]));
+            ArchiveIndex::Product& p = products[key];
+            if (p.segment_name.empty())
+            {
+                p.directory = dirname;
+                p.resolution = fields[0];
+                p.productid1 = deunderscore(fields[3]);
+                p.productid2 = deunderscore(fields[4]);
+                p.timing = deunderscore(fields[6]);
+                p.segment_name = name;
+            }
+            p.segments.push_back(num);
+        } else if (fields[7] == "__") {
+            string key = make_key(dirname, fields[0], deunderscore(fields[3]), "", deunderscore(fields[6]));
+            if (!str::startswith(fields[5], "PRO") && !str::startswith(fields[5], "EPI")) continue;
+            ArchiveIndex::Slot& slot = slots[key];
+            slot.directory = dirname;
+            slot.resolution = fields[0];
+            slot.productid1 = deunderscore(fields[3]);
+            slot.timing = deunderscore(fields[6]);
+            if (fields[5][0] == 'P')
+                slot.prologue = name;
+            else
+                slot.epilogue = name;
+        }
+    }
+
+    for (const auto& sub: subdirs)
+        walk(str::joinpath(dirname, sub), products, slots, directories);
+}
+
+}
+
+std::vector<std::string> ArchiveIndex::Product::segment_names() const
+{
+    // The segment number is the 6 digits at the start of the sixth field
+    size_t pos = 0;
+    for (int i = 0; i < 5; ++i)
+        pos = segment_name.find('-', pos) + 1;
+
+    vector<string> res;
+    string name = segment_name;
+    char buf[7];
+    for (unsigned n: segments)
+    {
+        snprintf(buf, 7, "%06u", n);
+        name.replace(pos, 6, buf);
+        res.push_back(name);
+    }
+    return res;
+}
+
+std::string ArchiveIndex::key(const FileAccess& fa)
+{
+    return make_key(sys::abspath(fa.directory), fa.resolution, fa.productid1, fa.productid2, fa.timing);
+}
+
+std::string ArchiveIndex::slot_key(const FileAccess& fa)
+{
+    return make_key(sys::abspath(fa.directory), fa.resolution, fa.productid1, "", fa.timing);
+}
+
+void ArchiveIndex::crawl(const std::string& root, unsigned threads)
+{
+    // Forget what was indexed before under root, so that files removed
+    // since then disappear from the index
+    string absroot = sys::abspath(root);
+    auto under_root = [&](const std::string& dir) {
+        return dir == absroot || str::startswith(dir, absroot + "/");
+    };
+    for (auto i = products.begin(); i != products.end(); )
+        if (under_root(i->second.directory)) i = products.erase(i); else ++i;
+    for (auto i = slots.begin(); i != slots.end(); )
+        if (under_root(i->second.directory)) i = slots.erase(i); else ++i;
+    for (auto i = directories.begin(); i != directories.end(); )
+        if (under_root(*i)) i = directories.erase(i); else ++i;
+
+    std::map<std::string, Product> found;
+    std::map<std::string, Slot> found_slots;
+    walk(absroot, found, found_slots, directories);
+
+    // Read the segment headers in parallel, since on network file systems
+    // most of the time is spent waiting for the files to open
+    utils::ThreadPool pool(threads);
+    for (auto& i: found)
+    {
+        Product& p = i.second;
+        sort(p.segments.begin(), p.segments.end());
+
+        auto slot = found_slots.find(make_key(p.directory, p.resolution, p.productid1, "", p.timing));
+        if (slot == found_slots.end() || slot->second.prologue.empty())
+            p.flags |= MISSING_PROLOGUE;
+        if (slot == found_slots.end() || slot->second.epilogue.empty())
+            p.flags |= MISSING_EPILOGUE;
+
+        pool.submit([&p] { scan_product(p); });
+    }
+    pool.wait();
+
+    for (auto& i: found)
+        products[i.first] = std::move(i.second);
+    for (auto& i: found_slots)
+        slots[i.first] = std::move(i.second);
+}
+
+const ArchiveIndex::Product* ArchiveIndex::find(const FileAccess& fa) const
+{
+    auto i = products.find(key(fa));
+    if (i == products.end()) return nullptr;
+    return &i->second;
+}
+
+const ArchiveIndex::Slot* ArchiveIndex::find_slot(const FileAccess& fa) const
+{
+    auto i = slots.find(slot_key(fa));
+    if (i == slots.end()) return nullptr;
+    return &i->second;
+}
+
+bool ArchiveIndex::covers(const FileAccess& fa) const
+{
+    return directories.find(sys::abspath(fa.directory)) != directories.end();
+}
+
+void ArchiveIndex::write(const std::string& pathname) const
+{
+    // Slots and products are listed under a C line with their directory
+    stringstream out;
+    out << index_signature << endl;
+    for (const auto& dir: directories)
+        out << "D\t" << dir << endl;
+
+    string curdir;
+    for (const auto& i: slots)
+    {
+        const Slot& s = i.second;
+        if (s.directory != curdir)
+        {
+            out << "C\t" << s.directory << endl;
+            curdir = s.directory;
+        }
+        out << "S\t" << s.resolution << "\t" << s.productid1 << "\t" << s.timing
+            << "\t" << (s.prologue.empty() ? "-" : s.prologue)
+            << "\t" << (s.epilogue.empty() ? "-" : s.epilogue) << endl;
+    }
+
+    curdir.clear();
+    for (const auto& i: products)
+    {
+        const Product& p = i.second;
+        if (p.directory != curdir)
+        {
+            out << "C\t" << p.directory << endl;
+            curdir = p.directory;
+        }
+        out << "P\t" << p.resolution << "\t" << p.productid1 << "\t" << p.productid2 << "\t" << p.timing
+            << "\t" << p.spacecraft_id << "\t" << p.channel_id
+            << "\t" << p.planned_start << "\t" << p.planned_end << "\t" << p.flags
+            << "\t" << p.segment_name << "\t" << format_ranges(p.segments) << endl;
+    }
+    sys::write_file_atomically(pathname, out.str(), 0666);
+}
+
+void ArchiveIndex::read(const std::string& pathname)
+{
+    std::ifstream in(pathname.c_str());
+    if (in.fail()) throw std::runtime_error(pathname + ": cannot open");
+
+    string line;
+    if (!getline(in, line) || line != index_signature)
+        throw std::runtime_error(pathname + ": not an msat index file");
+
+    string curdir;
+    vector<string> fields;
+    for (unsigned lineno = 2; getline(in, line); ++lineno)
+    {
+        fields.clear();
+        str::Split splitter(line, "\t");
+        for (const auto& f: splitter)
+            fields.push_back(f);
+
+        if (fields.size() == 2 && fields[0] == "D")
+            directories.insert(fields[1]);
+        else if (fields.size() == 2 && fields[0] == "C")
+            curdir = fields[1];
+        else if (fields.size() == 6 && fields[0] == "S" && !curdir.empty())
+        {
+            Slot slot;
+            slot.directory = curdir;
+            slot.resolution = fields[1];
+            slot.productid1 = fields[2];
+            slot.timing = fields[3];
+            if (fields[4] != "-") slot.prologue = fields[4];
+            if (fields[5] != "-") slot.epilogue = fields[5];
+            slots[make_key(curdir, fields[1], fields[2], "", fields[3])] = std::move(slot);
+        }
+        else if (fields.size() == 12 && fields[0] == "P" && !curdir.empty())
+        {
+            Product p;
+            p.directory = curdir;
+            p.resolution = fields[1];
+            p.productid1 = fields[2];
+            p.productid2 = fields[3];
+            p.timing = fields[4];
+            p.spacecraft_id = strtol(fields[5].c_str(), nullptr, 10);
+            p.channel_id = strtol(fields[6].c_str(), nullptr, 10);
+            p.planned_start = strtoul(fields[7].c_str(), nullptr, 10);
+            p.planned_end = strtoul(fields[8].c_str(), nullptr, 10);
+            p.flags = strtoul(fields[9].c_str(), nullptr, 10);
+            p.segment_name = fields[10];
+            p.segments = parse_ranges(fields[11]);
+            string key = make_key(p.directory, p.resolution, p.productid1, p.productid2, p.timing);
+            products[key] = std::move(p);
+        } else {
+            stringstream msg;
+            msg << pathname << ":" << lineno << ": invalid index line";
+            throw std::runtime_error(msg.str());
+        }
+    }
+}
+
+std::shared_ptr<const ArchiveIndex> ArchiveIndex::load(const std::string& pathname)
+{
+    struct Loaded
+    {
+        size_t size;
+        struct timespec mtime;
+        std::shared_ptr<const ArchiveIndex> index;
+    };
+    static std::mutex mutex;
+    static std::map<std::string, Loaded> loaded;
+
+    string abspath = sys::abspath(pathname);
+    struct stat st;
+    sys::stat(abspath, st);
+
+    lock_guard<std::mutex> lock(mutex);
+    auto i = loaded.find(abspath);
+    if (i != loaded.end()
+            && (size_t)st.st_size == i->second.size
+            && st.st_mtim.tv_sec == i->second.mtime.tv_sec
+            && st.st_mtim.tv_nsec == i->second.mtime.tv_nsec)
+        return i->second.index;
+
+    std::shared_ptr<ArchiveIndex> index(new ArchiveIndex);
+    index->read(abspath);
+    Loaded& l = loaded[abspath];
+    l.size = st.st_size;
+    l.mtime = st.st_mtim;
+    l.index = index;
+    return index;
+}
+
+}
+}
@@ -0,0 +1,148 @@
+#ifndef MSAT_XRIT_ARCHIVEINDEX_H
+#define MSAT_XRIT_ARCHIVEINDEX_H
+
+/*
+ * xrit/archiveindex - Catalog of the xRIT products in a directory tree
+ *
+ * Copyright (C) 2016  ARPA-SIM <urpsim@smr.arpa.emr.it>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Enrico Zini <enrico@enricozini.org>
+ */
+
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include <memory>
+
+namespace msat {
+namespace xrit {
+
+struct FileAccess;
+
+/**
+ * Catalog of the xRIT products found in a directory tree, with the names of
+ * their files.
+ *
+ * It is built by crawling the tree once, reading only one segment header per
+ * product, and can be saved to an index file. A FileAccess with an index set
+ * looks up file names in it instead of listing directories.
+ */
+class ArchiveIndex
+{
+public:
+    /// Quality flags of a product
+    enum Flags {
+        /// Some of the planned segments are missing
+        MISSING_SEGMENTS = 1,
+        /// There is no prologue for the slot
+        MISSING_PROLOGUE = 2,
+        /// There is no epilogue for the slot
+        MISSING_EPILOGUE = 4,
+        /// The segment header could not be read
+        UNREADABLE = 8,
+    };
+
+    /// One channel of a slot
+    struct Product
+    {
+        std::string directory;
+        std::string resolution;
+        std::string productid1;
+        std::string productid2;
+        std::string timing;
+        /// Spacecraft ID, as in facts::spacecraftIDFromHRIT()
+        int spacecraft_id = 0;
+        /// Spectral channel ID
+        int channel_id = 0;
+        /// Number of the first and last segment planned for the product
+        unsigned planned_start = 0;
+        unsigned planned_end = 0;
+        /// Combination of ArchiveIndex::Flags values
+        unsigned flags = 0;
+        /// File name of one of the segments, used to build the others
+        std::string segment_name;
+        /// Numbers of the segments found, sorted
+        std::vector<unsigned> segments;
+
+        /// File names of all the segments, sorted by segment number
+        std::vector<std::string> segment_names() const;
+    };
+
+    /// Prologue and epilogue of a slot, shared by all its channels
+    struct Slot
+    {
+        std::string directory;
+        std::string resolution;
+        std::string productid1;
+        std::string timing;
+        /// File names of prologue and epilogue, empty if missing
+        std::string prologue;
+        std::string epilogue;
+    };
+
+    /// Products, indexed by key()
+    std::map<std::string, Product> products;
+
+    /// Slots, indexed by slot_key()
+    std::map<std::string, Slot> slots;
+
+    /// Absolute pathnames of the indexed directories
+    std::set<std::string> directories;
+
+    /// Key identifying the product described by \a fa
+    static std::string key(const FileAccess& fa);
+
+    /// Key identifying the slot of the product described by \a fa
+    static std::string slot_key(const FileAccess& fa);
+
+    /**
+     * Index all the xRIT products found in the directory tree under \a root,
+     * reading their segment headers using up to \a threads threads.
+     *
+     * Entries previously indexed under \a root are replaced.
+     */
+    void crawl(const std::string& root, unsigned threads=1);
+
+    /// Return the product described by \a fa, or nullptr if not indexed
+    const Product* find(const FileAccess& fa) const;
+
+    /// Return the slot of the product described by \a fa, or nullptr if not indexed
+    const Slot* find_slot(const FileAccess& fa) const;
+
+    /// Check if the directory of \a fa has been indexed
+    bool covers(const FileAccess& fa) const;
+
+    /// Write the index to a file
+    void write(const std::string& pathname) const;
+
+    /// Read an index file written by write()
+    void read(const std::string& pathname);
+
+    /**
+     * Return the index stored in \a pathname.
+     *
+     * Indices are kept in memory and shared across calls, and the file is
+     * read again only if it changed.
+     */
+    static std::shared_ptr<const ArchiveIndex> load(const std::string& pathname);
+};
+
+}
+}
+
+#endif
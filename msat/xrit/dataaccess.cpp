@@ -22,24 +22,54 @@
 
 #include <msat/xrit/dataaccess.h>
 #include <msat/xrit/fileaccess.h>
+#include <msat/xrit/diskcache.h>
+#include <msat/xrit/prologuecache.h>
 #include <msat/hrit/MSG_HRIT.h>
+#include <msat/utils/threadpool.h>
+#include <msat/utils/kernels.h>
 #include <stdexcept>
+#include <sstream>
+#include <memory>
+#include <fcntl.h>
+#include <sys/mman.h>
 
 using namespace std;
 
 namespace msat {
 namespace xrit {
 
-DataAccess::DataAccess() : npixperseg(0)
+const size_t DataAccess::unscanned;
+
+namespace {
+
+/**
+ * Check if a segment file has been completely written, comparing its size
+ * with the lengths in its primary header
+ */
+bool segment_complete(const std::string& pathname)
+{
+    sys::File in(pathname);
+    if (!in.open_ifexists(O_RDONLY)) return false;
+    struct stat st;
+    in.fstat(st);
+    unsigned char buf[16];
+    if (in.pread(buf, 16, 0) != 16) return false;
+    uint64_t header_length = get_ui4(buf + 4);
+    uint64_t data_length = ((uint64_t)get_ui4(buf + 8) << 32 | get_ui4(buf + 12)) / 8;
+    return (uint64_t)st.st_size >= header_length + data_length;
+}
+
+}
+
+DataAccess::DataAccess()
+    : last_segment(-1), npixperseg(0), use_mmap(true), threads(1), readahead(0), incremental(false)
 {
 }
 
 DataAccess::~DataAccess()
 {
-    // Delete the segment cache
-    //if (m_segment) delete m_segment;
-    for (auto& i: segcache)
-        delete i.segment;
+    // Wait for background decoding to end before the cache goes away
+    prefetcher.reset();
 }
 
 void DataAccess::read_file(const std::string& file, MSG_header& head) const
@@ -90,21 +120,59 @@ void DataAccess::scan(const FileAccess& fa, MSG_data& pro, MSG_data& epi, MSG_he
     //p.activity("Reading prologue " + opts.prologueFile());
     read_file(fa.prologueFile(), PRO_head, pro);
 
-    // Read epilogue
+    // Read epilogue, which may not have arrived yet when reading
+    // incrementally
     MSG_header EPI_head;
+    string epifile;
+    try {
+        epifile = fa.epilogueFile();
+    } catch (std::runtime_error&) {
+        if (!incremental) throw;
+    }
     //p.activity("Reading epilogue " + opts.epilogueFile());
-    read_file(fa.epilogueFile(), EPI_head, epi);
+    if (!epifile.empty())
+        read_file(epifile, EPI_head, epi);
 
-    // Sort the segment names by their index
+    scan_segments(fa, pro, epi, header);
+}
+
+void DataAccess::scan(const FileAccess& fa, MSG_header& header)
+{
+    pro = PrologueCache::prologue(fa);
+
+    // The epilogue may not have arrived yet when reading incrementally
+    epi.reset();
+    try {
+        epi = PrologueCache::epilogue(fa);
+    } catch (std::runtime_error&) {
+        if (!incremental) throw;
+    }
+
+    if (epi)
+        scan_segments(fa, *pro, *epi, header);
+    else
+        scan_segments(fa, *pro, MSG_data(), header);
+}
+
+void DataAccess::scan_segments(const FileAccess& fa, const MSG_data& pro, const MSG_data& epi, MSG_header& header)
+{
+
+    // Sort the segment names by their index, taken from the file name if
+    // possible, to avoid opening segments that may not be needed
     vector<string> segfiles = fa.segmentFiles();
+    string scanned;
     for (const auto& i: segfiles)
     {
-        //p.activity("Scanning segment " + *i);
-        read_file(i, header);
-        if (header.segment_id->data_field_format == MSG_NO_FORMAT)
-            throw std::runtime_error(i + ": product dumped in binary format");
+        int num = segmentNumber(i);
+        if (num == -1)
+        {
+            //p.activity("Scanning segment " + *i);
+            read_file(i, header);
+            num = header.segment_id->sequence_number;
+            scanned = i;
+        }
 
-        int idx = header.segment_id->sequence_number-1;
+        int idx = num - 1;
         if (idx < 0) continue;
         if ((size_t)idx >= segnames.size())
             segnames.resize(idx + 1);
@@ -114,19 +182,64 @@ void DataAccess::scan(const FileAccess& fa, MSG_data& pro, MSG_data& epi, MSG_he
     if (segnames.empty()) throw std::runtime_error("no segments found");
 
     // Read common info just once from a random segment
+    if (scanned.empty())
+    {
+        for (const auto& i: segnames)
+            if (!i.empty())
+            {
+                scanned = i;
+                break;
+            }
+        read_file(scanned, header);
+    }
+    if (header.segment_id->data_field_format == MSG_NO_FORMAT)
+        throw std::runtime_error(scanned + ": product dumped in binary format");
     scanSegment(header);
 
+    // The headers of the other segments are read when they are first needed
+    segoffsets.clear();
+    segoffsets.resize(segnames.size(), 0);
+    for (size_t idx = 0; idx < segnames.size(); ++idx)
+        if (!segnames[idx].empty())
+            segoffsets[idx] = unscanned;
+    cachednames.clear();
+    cachednames.resize(segnames.size());
+    segmaps.clear();
+    segmaps.resize(segnames.size());
+
+    // We already have the header of the segment we scanned
+    for (size_t idx = 0; idx < segnames.size(); ++idx)
+        if (segnames[idx] == scanned)
+        {
+            segoffsets[idx] = check_segment(idx, header);
+            break;
+        }
+
     if (hrv)
     {
-        MSG_ActualL15CoverageHRV& cov = epi.epilogue->product_stats.ActualL15CoverageHRV;
-        LowerEastColumnActual = cov.LowerEastColumnActual;
-        LowerNorthLineActual = cov.LowerNorthLineActual;
-        LowerWestColumnActual = cov.LowerWestColumnActual;
-        LowerSouthLineActual = cov.LowerSouthLineActual;
-        UpperEastColumnActual = cov.UpperEastColumnActual;
-        UpperSouthLineActual = cov.UpperSouthLineActual;
-        UpperWestColumnActual = cov.UpperWestColumnActual;
-        UpperNorthLineActual = cov.UpperNorthLineActual;
+        if (epi.epilogue)
+        {
+            const MSG_ActualL15CoverageHRV& cov = epi.epilogue->product_stats.ActualL15CoverageHRV;
+            LowerEastColumnActual = cov.LowerEastColumnActual;
+            LowerNorthLineActual = cov.LowerNorthLineActual;
+            LowerWestColumnActual = cov.LowerWestColumnActual;
+            LowerSouthLineActual = cov.LowerSouthLineActual;
+            UpperEastColumnActual = cov.UpperEastColumnActual;
+            UpperSouthLineActual = cov.UpperSouthLineActual;
+            UpperWestColumnActual = cov.UpperWestColumnActual;
+            UpperNorthLineActual = cov.UpperNorthLineActual;
+        } else {
+            // The epilogue has not arrived yet: use the planned coverage
+            const MSG_coverage_HRV& cov = pro.prologue->image_description.PlannedCoverageHRV;
+            LowerEastColumnActual = cov.LowerEastColumnPlanned;
+            LowerNorthLineActual = cov.LowerNorthLinePlanned;
+            LowerWestColumnActual = cov.LowerWestColumnPlanned;
+            LowerSouthLineActual = cov.LowerSouthLinePlanned;
+            UpperEastColumnActual = cov.UpperEastColumnPlanned;
+            UpperSouthLineActual = cov.UpperSouthLinePlanned;
+            UpperWestColumnActual = cov.UpperWestColumnPlanned;
+            UpperNorthLineActual = cov.UpperNorthLinePlanned;
+        }
         MaxLineActual = max(LowerNorthLineActual, UpperNorthLineActual);
 #if 0
         fprintf(stderr, "LECA %zd\n", LowerEastColumnActual);
@@ -150,49 +263,356 @@ void DataAccess::scan(const FileAccess& fa, MSG_data& pro, MSG_data& epi, MSG_he
     }
 }
 
-MSG_data* DataAccess::segment(size_t idx) const
+size_t DataAccess::refresh(const FileAccess& fa)
 {
-    // Check to see if the segment we need is the current one
-    if (!segcache.empty() && segcache.begin()->segno == idx)
-        return segcache.begin()->segment;
+    // Let background decoding finish before changing the segment lists
+    if (prefetcher) prefetcher->wait();
 
-    // If not, check to see if we can find the segment in the cache
-    std::deque<scache>::iterator i = segcache.begin();
-    for ( ; i != segcache.end(); ++i)
-        if (i->segno == idx)
-            break;
-    if (i == segcache.end())
+    size_t added = 0;
+    for (const auto& i: fa.segmentFiles())
     {
-        // Not in cache: we need to load it
+        int num = segmentNumber(i);
+        if (num > 0 && (size_t)num <= segnames.size() && !segnames[num - 1].empty())
+            continue;
 
-        // Do not load missing segments
-        if (idx >= segnames.size()) return 0;
-        if (segnames[idx].empty()) return 0;
+        // Skip segments that are still being written
+        if (!segment_complete(i)) continue;
+
+        if (num == -1)
+        {
+            MSG_header header;
+            read_file(i, header);
+            num = header.segment_id->sequence_number;
+        }
 
-        // Remove the last recently used if the cache is full
-        if (segcache.size() == 2)
+        int idx = num - 1;
+        if (idx < 0) continue;
+        if ((size_t)idx >= segnames.size())
         {
-            delete segcache.rbegin()->segment;
-            segcache.pop_back();
+            segnames.resize(idx + 1);
+            segoffsets.resize(idx + 1, 0);
+            cachednames.resize(idx + 1);
+            segmaps.resize(idx + 1);
         }
+        if (!segnames[idx].empty()) continue;
 
-        // Load the segment
-        // ProgressTask p("Reading segment " + segnames[idx]);
-        MSG_header header;
-        scache new_scache;
-        new_scache.segment = new MSG_data;
-        new_scache.segno = idx;
-        read_file(segnames[idx].c_str(), header, *new_scache.segment);
+        segnames[idx] = i;
+        segoffsets[idx] = unscanned;
+        ++added;
+    }
+    return added;
+}
 
-        // Put it in the front
-        segcache.push_front(new_scache);
-    } else {
-        // The segment is in the cache: bring it to the front
-        scache tmp = *i;
-        segcache.erase(i);
-        segcache.push_front(tmp);
+bool DataAccess::line_available(size_t line) const
+{
+    size_t segnum, segline;
+    line_segment(line, segnum, segline);
+    return segnum < segnames.size() && !segnames[segnum].empty();
+}
+
+size_t DataAccess::segment_offset(size_t idx) const
+{
+    lock_guard<mutex> lock(segment_lock(idx));
+    return segment_offset_locked(idx);
+}
+
+size_t DataAccess::segment_offset_locked(size_t idx) const
+{
+    if (segoffsets[idx] != unscanned) return segoffsets[idx];
+
+    MSG_header header;
+    read_file(segnames[idx], header);
+    segoffsets[idx] = check_segment(idx, header);
+    return segoffsets[idx];
+}
+
+size_t DataAccess::check_segment(size_t idx, const MSG_header& header) const
+{
+    if (header.segment_id->data_field_format == MSG_NO_FORMAT)
+        throw std::runtime_error(segnames[idx] + ": product dumped in binary format");
+
+    // The segment number in the file name was trusted by scan()
+    if ((size_t)header.segment_id->sequence_number != idx + 1)
+    {
+        stringstream msg;
+        msg << segnames[idx] << ": segment has sequence number " << header.segment_id->sequence_number
+            << " instead of " << idx + 1;
+        throw std::runtime_error(msg.str());
     }
-    return segcache.begin()->segment;
+
+    const MSG_header_image_struct& is = *header.image_structure;
+    if ((size_t)is.number_of_columns != columns || (size_t)is.number_of_lines != seglines)
+    {
+        stringstream msg;
+        msg << segnames[idx] << ": segment is " << is.number_of_columns << "x" << is.number_of_lines
+            << " instead of " << columns << "x" << seglines;
+        throw std::runtime_error(msg.str());
+    }
+
+    // Uncompressed 16 bit samples can be read straight from the file
+    size_t res = 0;
+    if (is.compression_flag == MSG_NO_COMPRESSION
+            && is.number_of_bits_per_pixel == 16
+            && header.data_field_length / 8 == (uint_8)is.number_of_columns * is.number_of_lines * 2)
+        res = header.total_header_length;
+
+    // Segments decoded by other processes are read from the disk cache
+    if (!res && diskcache)
+        res = diskcache->lookup(segnames[idx], npixperseg, cachednames[idx]);
+
+    return res;
+}
+
+MSG_data* DataAccess::load_segment(size_t idx) const
+{
+    // Do not load missing segments
+    if (idx >= segnames.size()) return 0;
+    if (segnames[idx].empty()) return 0;
+
+    string cachedname;
+    size_t offset;
+    {
+        lock_guard<mutex> lock(segment_lock(idx));
+        offset = segment_offset_locked(idx);
+        cachedname = cachednames[idx];
+    }
+
+    if (!cachedname.empty())
+        if (MSG_data* res = load_cached_segment(cachedname, offset))
+            return res;
+
+    // ProgressTask p("Reading segment " + segnames[idx]);
+    MSG_header header;
+    unique_ptr<MSG_data> res(new MSG_data);
+    read_file(segnames[idx], header, *res);
+
+    if (diskcache && !offset && res->image)
+    {
+        // Failing to write the cache should not prevent reading the data
+        try {
+            diskcache->store(segnames[idx], res->image->data, npixperseg);
+        } catch (std::exception&) {
+        }
+    }
+
+    return res.release();
+}
+
+MSG_data* DataAccess::load_cached_segment(const std::string& pathname, size_t offset) const
+{
+    // The entry could have been evicted by another process since scan()
+    sys::File in(pathname);
+    if (!in.open_ifexists(O_RDONLY)) return nullptr;
+    sys::MMap entry = in.mmap(offset + npixperseg * 2, PROT_READ, MAP_SHARED);
+    in.close();
+
+    unique_ptr<MSG_data> res(new MSG_data);
+    res->image = new MSG_data_image;
+    res->image->len = npixperseg;
+    res->image->data = new MSG_SAMPLE[npixperseg];
+    const unsigned char* src = entry;
+    utils::kernels::copy_u16((const uint16_t*)(src + offset), npixperseg, res->image->data, false, !is_big());
+    return res.release();
+}
+
+std::shared_ptr<MSG_data> DataAccess::segment(size_t idx) const
+{
+    unique_lock<mutex> lock(cache_mutex);
+
+    // If another thread is decoding this segment, wait for it
+    load_done.wait(lock, [&] { return loading.find(idx) == loading.end(); });
+
+    std::shared_ptr<MSG_data> res = segcache.get(idx);
+    if (!res)
+    {
+        // Not in cache: we need to load it, and other threads needing it
+        // wait for us
+        loading.insert(idx);
+        lock.unlock();
+        try {
+            res.reset(load_segment(idx));
+        } catch (...) {
+            lock.lock();
+            end_loading({ idx });
+            throw;
+        }
+        lock.lock();
+        end_loading({ idx });
+        if (!res) return res;
+        segcache.put(idx, res, segment_size());
+    }
+
+    // Read ahead when moving to a neighbouring segment
+    if (readahead && idx != last_segment && last_segment != (size_t)-1)
+    {
+        if (idx == last_segment + 1)
+            schedule_readahead(idx, 1);
+        else if (idx + 1 == last_segment)
+            schedule_readahead(idx, -1);
+    }
+    last_segment = idx;
+
+    return res;
+}
+
+bool DataAccess::in_cache(size_t idx) const
+{
+    lock_guard<mutex> lock(cache_mutex);
+    return segcache.has(idx);
+}
+
+bool DataAccess::needs_decoding(size_t idx) const
+{
+    if (idx >= segnames.size() || segnames[idx].empty()) return false;
+    if (use_mmap && segment_offset(idx)) return false;
+    return true;
+}
+
+void DataAccess::end_loading(const std::vector<size_t>& todo) const
+{
+    for (size_t idx: todo)
+        loading.erase(idx);
+    load_done.notify_all();
+}
+
+void DataAccess::schedule_readahead(size_t idx, int dir) const
+{
+    // Keep room in the cache for the segment being read
+    size_t capacity = segcache.budget() / segment_size();
+    if (capacity < 2) return;
+    size_t count = min((size_t)readahead, capacity - 1);
+
+    for (size_t i = 1; i <= count; ++i)
+    {
+        if (dir < 0 && i > idx) break;
+        size_t next = idx + dir * i;
+        // Only look at what is in memory here: checking if the segment can
+        // be mapped reads its header, which is done by the prefetch job
+        if (next >= segnames.size() || segnames[next].empty()) continue;
+        if (segcache.has(next) || loading.find(next) != loading.end()) continue;
+
+        if (!prefetcher)
+            prefetcher.reset(new utils::ThreadPool(1));
+
+        loading.insert(next);
+        prefetcher->submit([this, next] {
+            // Errors are ignored here: the segment will be decoded again
+            // when it is needed, and the error reported then
+            std::shared_ptr<MSG_data> segment;
+            try {
+                if (needs_decoding(next))
+                    segment.reset(load_segment(next));
+            } catch (std::exception&) {
+            }
+
+            lock_guard<mutex> lock(cache_mutex);
+            if (segment)
+                segcache.put(next, segment, segment_size());
+            end_loading({ next });
+        });
+    }
+}
+
+size_t DataAccess::segment_size() const
+{
+    return sizeof(MSG_data) + sizeof(MSG_data_image) + npixperseg * sizeof(MSG_SAMPLE);
+}
+
+size_t DataAccess::preload_segments(std::vector<size_t> todo) const
+{
+    // Skip missing and memory mapped segments
+    size_t count = 0;
+    size_t skipped = 0;
+    for (size_t idx: todo)
+        if (needs_decoding(idx))
+            todo[count++] = idx;
+    todo.resize(count);
+
+    {
+        // Skip segments already cached or being decoded by other threads,
+        // and claim the others
+        lock_guard<mutex> lock(cache_mutex);
+        count = 0;
+        for (size_t idx: todo)
+            if (!segcache.has(idx) && loading.find(idx) == loading.end())
+                todo[count++] = idx;
+        todo.resize(count);
+
+        // Do not decode more than what fits in the cache, or we would evict
+        // segments decoded in this same batch
+        size_t max_count = max((size_t)1, segcache.budget() / segment_size());
+        if (todo.size() > max_count)
+        {
+            skipped = todo.size() - max_count;
+            todo.resize(max_count);
+        }
+
+        loading.insert(todo.begin(), todo.end());
+    }
+    if (todo.empty()) return skipped;
+
+    // Decode in parallel, each worker filling its own slot
+    vector<std::shared_ptr<MSG_data>> decoded(todo.size());
+    try {
+        if (threads > 1 && todo.size() > 1)
+        {
+            utils::ThreadPool pool(min((size_t)threads, todo.size()));
+            for (size_t i = 0; i < todo.size(); ++i)
+                pool.submit([this, &todo, &decoded, i] { decoded[i].reset(load_segment(todo[i])); });
+            pool.wait();
+        } else {
+            for (size_t i = 0; i < todo.size(); ++i)
+                decoded[i].reset(load_segment(todo[i]));
+        }
+    } catch (...) {
+        lock_guard<mutex> lock(cache_mutex);
+        end_loading(todo);
+        throw;
+    }
+
+    // Feed the results into the cache, so that the first in the list end up
+    // as the most recently used
+    lock_guard<mutex> lock(cache_mutex);
+    for (size_t i = todo.size(); i > 0; --i)
+        segcache.put(todo[i - 1], decoded[i - 1], segment_size());
+    end_loading(todo);
+    return skipped;
+}
+
+size_t DataAccess::preload(size_t first, size_t last) const
+{
+    if (last > segnames.size()) last = segnames.size();
+    vector<size_t> todo;
+    for (size_t idx = first; idx < last; ++idx)
+        todo.push_back(idx);
+    return preload_segments(todo);
+}
+
+size_t DataAccess::preload() const
+{
+    return preload(0, segnames.size());
+}
+
+size_t DataAccess::preload_lines(size_t first, size_t last) const
+{
+    if (first >= last) return 0;
+    size_t seg_a, seg_b, segline;
+    line_segment(first, seg_a, segline);
+    line_segment(last - 1, seg_b, segline);
+    // Lines outside the image can map to bogus segment numbers
+    seg_a = min(seg_a, segnames.size());
+    seg_b = min(seg_b, segnames.size());
+
+    // List segments in reading order: lines go from north to south, while
+    // segments go from south to north
+    vector<size_t> todo;
+    if (seg_a <= seg_b)
+        for (size_t idx = seg_a; idx <= seg_b; ++idx)
+            todo.push_back(idx);
+    else
+        for (size_t idx = seg_a + 1; idx > seg_b; --idx)
+            todo.push_back(idx - 1);
+    return preload_segments(todo);
 }
 
 size_t DataAccess::line_start(size_t line) const
@@ -210,40 +630,122 @@ size_t DataAccess::line_start(size_t line) const
     return 0;
 }
 
-void DataAccess::line_read(size_t line, MSG_SAMPLE* buf) const
+void DataAccess::line_segment(size_t line, size_t& segnum, size_t& segline) const
 {
-    size_t segnum = 0;
-    size_t segline = 0;
-
-    MSG_data* d = nullptr;
-
     if (hrv)
     {
         line = MaxLineActual - line - 1;
         segnum = line / seglines;
         segline = line % seglines;
-        d = segment(segnum);
     }
     else
     {
         line = 3712 - line;
         segnum = (line - SouthLineActual) / seglines;
         segline = (line - SouthLineActual) % seglines;
-        d = segment(segnum);
     }
+}
+
+const unsigned char* DataAccess::mapped_line(size_t segnum, size_t segline) const
+{
+    if (!use_mmap) return nullptr;
+    if (segnum >= segoffsets.size() || segnames[segnum].empty()) return nullptr;
+
+    // The mapping is created by the first thread that needs it, and stays
+    // until the DataAccess is destroyed
+    lock_guard<mutex> lock(segment_lock(segnum));
+    if (!segment_offset_locked(segnum)) return nullptr;
+
+    if (!segmaps[segnum])
+    {
+        sys::File in(cachednames[segnum].empty() ? segnames[segnum] : cachednames[segnum]);
+        if (!in.open_ifexists(O_RDONLY))
+        {
+            if (cachednames[segnum].empty()) in.throw_error("cannot open file");
+            // The disk cache entry was evicted by another process since
+            // scan(): decode the segment instead
+            cachednames[segnum].clear();
+            segoffsets[segnum] = 0;
+            return nullptr;
+        }
+        struct stat st;
+        in.fstat(st);
+        size_t size = st.st_size;
+        if (size < segoffsets[segnum] + npixperseg * 2)
+            throw std::runtime_error(in.name() + ": file is shorter than its header says");
+        segmaps[segnum].reset(new sys::MMap(in.mmap(size, PROT_READ, MAP_SHARED)));
+    }
+
+    const unsigned char* data = *segmaps[segnum];
+    return data + segoffsets[segnum] + segline * columns * 2;
+}
+
+void DataAccess::line_read(size_t line, MSG_SAMPLE* buf) const
+{
+    line_read(line, buf, 0, columns);
+}
+
+void DataAccess::line_read(size_t line, MSG_SAMPLE* buf, size_t first, size_t count) const
+{
+    if (first >= columns) return;
+    if (first + count > columns) count = columns - first;
+
+    size_t segnum = 0;
+    size_t segline = 0;
+    line_segment(line, segnum, segline);
+
+    // Index in the segment line of the first sample to read
+    size_t start = swapX ? columns - first - count : first;
+
+    // Uncompressed segments are read from the file mapping, converting the
+    // samples from big endian
+    if (const unsigned char* src = mapped_line(segnum, segline))
+    {
+        src += start * 2;
+        if ((uintptr_t)src % alignof(uint16_t) == 0)
+            utils::kernels::copy_u16((const uint16_t*)src, count, buf, swapX, !is_big());
+        else if (swapX)
+        {
+            for (size_t i = 0; i < count; ++i)
+                buf[count - i - 1] = get_ui2(src + i * 2);
+        } else {
+            for (size_t i = 0; i < count; ++i)
+                buf[i] = get_ui2(src + i * 2);
+        }
+        return;
+    }
+
+    std::shared_ptr<MSG_data> d = segment(segnum);
 
     if (d == nullptr)
     {
-        bzero(buf, columns * sizeof(MSG_SAMPLE));
+        bzero(buf, count * sizeof(MSG_SAMPLE));
         return;
     }
 
-    if (swapX)
+    utils::kernels::copy_u16(d->image->data + segline * columns + start, count, buf, swapX, false);
+}
+
+void DataAccess::reduced_line_read(size_t factor, size_t line, MSG_SAMPLE* buf) const
+{
+    // Lay out the source lines in the virtual fullsize image
+    size_t width = image_width();
+    vector<MSG_SAMPLE> src(width * factor, 0);
+    size_t first = line * factor;
+    size_t count = 0;
+    for ( ; count < factor && first + count < lines; ++count)
     {
-        for (size_t i = 0; i < columns; ++i)
-            buf[columns - i - 1] = d->image->data[segline * columns + i];
-    } else
-        memcpy(buf, d->image->data + segline * columns, columns * sizeof(MSG_SAMPLE));
+        size_t start = line_start(first + count);
+        if (start >= width) continue;
+        line_read(first + count, src.data() + count * width + start, 0, min(columns, width - start));
+    }
+
+    if (!count)
+    {
+        std::fill(buf, buf + (width + factor - 1) / factor, 0);
+        return;
+    }
+    utils::kernels::box_decimate(src.data(), width, count, width, factor, buf, 0);
 }
 
 }
@@ -25,25 +25,132 @@
 
 #include <string>
 #include <vector>
-#include <deque>
+#include <memory>
+#include <set>
+#include <mutex>
+#include <condition_variable>
 #include <msat/hrit/MSG_data_image.h>
+#include <msat/xrit/segmentcache.h>
+#include <msat/utils/sys.h>
 
 struct MSG_header;
 struct MSG_data;
 
 namespace msat {
+namespace utils {
+class ThreadPool;
+}
+
 namespace xrit {
 
 struct FileAccess;
+class DiskCache;
 
 /**
  * Higher level data access for xRIT files
+ *
+ * Once scan() has returned, the const methods can be called from multiple
+ * threads at the same time: a segment needed by more than one thread is
+ * decoded only once.
  */
 class DataAccess
 {
 protected:
         void scanSegment(const MSG_header& header);
 
+        /// Scan the segments, after the prologue and epilogue have been read
+        void scan_segments(const FileAccess& fa, const MSG_data& pro, const MSG_data& epi, MSG_header& header);
+
+        /**
+         * Check that the header of segment \a idx matches its position and
+         * the geometry read by scan(), and compute its segoffsets value.
+         *
+         * Throws std::runtime_error if the segment is not consistent with the
+         * others.
+         */
+        size_t check_segment(size_t idx, const MSG_header& header) const;
+
+        /// Number of locks protecting the per-segment state
+        static const size_t segment_lock_count = 16;
+
+        /**
+         * Locks protecting segoffsets, cachednames and segmaps, each shared
+         * by the segments whose index has the same remainder modulo
+         * segment_lock_count
+         */
+        mutable std::mutex segment_locks[segment_lock_count];
+
+        /// Return the lock protecting the state of segment \a idx
+        std::mutex& segment_lock(size_t idx) const { return segment_locks[idx % segment_lock_count]; }
+
+        /// segment_offset(), to be called with segment_lock(idx) held
+        size_t segment_offset_locked(size_t idx) const;
+
+        /// Decode the segment with the given index, returning nullptr if it is missing
+        MSG_data* load_segment(size_t idx) const;
+
+        /**
+         * Load a segment from the disk cache entry \a pathname, with the
+         * samples at \a offset, returning nullptr if the entry has
+         * disappeared
+         */
+        MSG_data* load_cached_segment(const std::string& pathname, size_t offset) const;
+
+        /**
+         * Decode the segments with the given indices and add them to the
+         * segment cache, in order, using up to \a threads worker threads.
+         *
+         * Only as many segments as fit in the cache budget are decoded, since
+         * more would evict the first ones of the same batch. Returns the
+         * number of segments left out because of this, so that callers can
+         * report it or raise the budget.
+         */
+        size_t preload_segments(std::vector<size_t> todo) const;
+
+        /**
+         * Return a pointer to the raw big endian samples of a line in an
+         * uncompressed segment, mapping the segment file if needed.
+         *
+         * Returns nullptr if the segment cannot be accessed via mmap.
+         */
+        const unsigned char* mapped_line(size_t segnum, size_t segline) const;
+
+        /// Check if a segment needs decoding to be read
+        bool needs_decoding(size_t idx) const;
+
+        /// Protects segcache, loading and last_segment
+        mutable std::mutex cache_mutex;
+        /// Signaled when a thread is done decoding a segment
+        mutable std::condition_variable load_done;
+        /**
+         * Segments being decoded, by a reader or in background: other
+         * threads needing them wait for the result instead of decoding them
+         * again
+         */
+        mutable std::set<size_t> loading;
+
+        /**
+         * Remove \a todo from loading and wake up the threads waiting for
+         * them.
+         *
+         * cache_mutex must be held when calling this.
+         */
+        void end_loading(const std::vector<size_t>& todo) const;
+        /// Index of the last segment requested, used to detect sequential access
+        mutable size_t last_segment;
+        /// Thread decoding segments in background
+        mutable std::unique_ptr<utils::ThreadPool> prefetcher;
+
+        /**
+         * Queue for background decoding the \a readahead segments that follow
+         * \a idx in direction \a dir (+1 or -1).
+         *
+         * cache_mutex must be held when calling this. No file is accessed
+         * here: the background job itself skips the segments that do not
+         * need decoding.
+         */
+        void schedule_readahead(size_t idx, int dir) const;
+
 public:
         /// Number of pixels in every segment
         size_t npixperseg;
@@ -63,13 +170,82 @@ public:
         /// Pathnames of the segment files, indexed with their index
         std::vector<std::string> segnames;
 
-        struct scache
-        {
-                MSG_data* segment;
-                size_t segno;
-        };
-        /// Segment cache
-        mutable std::deque<scache> segcache;
+        /**
+         * Prologue, shared with other DataAccess objects, if scanned with
+         * scan(const FileAccess&, MSG_header&). It must not be modified.
+         */
+        std::shared_ptr<MSG_data> pro;
+
+        /**
+         * Epilogue, like pro. It is nullptr in incremental mode if the
+         * epilogue has not arrived yet.
+         */
+        std::shared_ptr<MSG_data> epi;
+
+        /// Segment cache, protected by cache_mutex when threads are reading
+        mutable SegmentCache segcache;
+
+        /**
+         * Cache of decoded segments shared with other processes, or nullptr
+         * to decode every segment.
+         *
+         * It needs to be set before calling scan().
+         */
+        std::unique_ptr<DiskCache> diskcache;
+
+        /**
+         * Pathnames of the disk cache entries of the segments that were found
+         * in the disk cache, indexed like segnames; empty strings for
+         * segments that were not found or have not been scanned yet.
+         *
+         * Entries that have been evicted by other processes by the time they
+         * are read are removed from here and from segoffsets.
+         */
+        mutable std::vector<std::string> cachednames;
+
+        /**
+         * Offset of the image data in each segment file, or in its disk cache
+         * entry, indexed like segnames, if the segment can be read directly
+         * from a memory mapping as 16 bit big endian samples; 0 otherwise.
+         *
+         * It is DataAccess::unscanned for segments whose header has not been
+         * read yet: use segment_offset() to access it.
+         */
+        mutable std::vector<size_t> segoffsets;
+
+        /// Value of segoffsets for segments that have not been scanned yet
+        static const size_t unscanned = (size_t)-1;
+
+        /// Memory mappings of uncompressed segment files, indexed like segnames
+        mutable std::vector<std::unique_ptr<sys::MMap>> segmaps;
+
+        /// Read uncompressed segments via mmap instead of loading them in memory
+        bool use_mmap;
+
+        /**
+         * Number of threads used to decode segments in preload() (1 means
+         * decode serially in the calling thread)
+         */
+        unsigned threads;
+
+        /**
+         * Number of segments to decode in background when segments are
+         * requested sequentially (0 disables read-ahead)
+         *
+         * Read-ahead is limited so that the segments it decodes never push
+         * the one being read out of the segment cache.
+         */
+        unsigned readahead;
+
+        /**
+         * Allow accessing a repeat cycle while it is still being received.
+         *
+         * scan() does not require the epilogue, which is the last file to
+         * arrive: if it is missing, \a epi is left empty and the HRV coverage
+         * is taken from the planned coverage in the prologue. Segments that
+         * arrive later can be added with refresh().
+         */
+        bool incremental;
 
         /// Length of a scanline
         size_t columns;
@@ -105,9 +281,53 @@ public:
         /**
          * Scan the given segments, filling in all the various DataAccess
          * fields.
+         *
+         * Segments are indexed using the segment number in their file names,
+         * and only the header of one of them is read, and returned in
+         * \a header. The other segment files are not accessed until their
+         * data is needed, so reading only part of the image only touches the
+         * segments that contain it.
          */
         void scan(const FileAccess& fa, MSG_data& pro, MSG_data& epi, MSG_header& header);
 
+        /**
+         * Scan the given segments like scan(const FileAccess&, MSG_data&,
+         * MSG_data&, MSG_header&), taking prologue and epilogue from the
+         * process-wide PrologueCache and storing them in \a pro and \a epi.
+         */
+        void scan(const FileAccess& fa, MSG_header& header);
+
+        /**
+         * Look for segment files that appeared after scan() or the last
+         * refresh(), and make them available for reading.
+         *
+         * Segment files that are still being written are skipped. This must
+         * not be called while other threads are reading from this
+         * DataAccess.
+         *
+         * Returns the number of segments added.
+         */
+        size_t refresh(const FileAccess& fa);
+
+        /**
+         * Check if the segment containing the given line is available.
+         *
+         * Line is numbered as in line_read(). Lines of missing segments are
+         * read as zeros.
+         */
+        bool line_available(size_t line) const;
+
+        /**
+         * Return segoffsets[idx], reading and validating the segment header
+         * and looking the segment up in the disk cache if this has not been
+         * done yet.
+         *
+         * scan() only reads the header of one segment, and segment numbers
+         * are taken from file names: this is where the other segments are
+         * checked, the first time they are accessed.
+         */
+        size_t segment_offset(size_t idx) const;
+
         /**
          * Read a xRIT file (prologue, epilogue or segment)
          */
@@ -141,11 +361,84 @@ public:
         void line_read(size_t line, MSG_SAMPLE* buf) const;
 
         /**
-         * Return the MSG_data corresponding to the segment with the given index.
+         * Read \a count samples of a scanline, starting from column \a first.
+         *
+         * Columns are numbered as in the output of line_read(size_t,
+         * MSG_SAMPLE*), that is, after swapping. The range is truncated at the
+         * end of the scanline.
+         */
+        void line_read(size_t line, MSG_SAMPLE* buf, size_t first, size_t count) const;
+
+        /**
+         * Width of the virtual fullsize image in which lines are aligned by
+         * line_start(): 11136 for HRV, columns otherwise.
+         */
+        size_t image_width() const { return hrv ? 11136 : columns; }
+
+        /**
+         * Read a line of the image reduced by \a factor in both directions.
+         *
+         * Each sample is the average of the nonzero samples in a box of
+         * \a factor x \a factor samples of the virtual fullsize image, as
+         * computed by utils::kernels::box_decimate(). \a buf must be at least
+         * ceil(image_width() / factor) elements.
+         *
+         * Segments are still decoded at full resolution, since the wavelet
+         * decompressor has no way of stopping at a coarser level.
+         */
+        void reduced_line_read(size_t factor, size_t line, MSG_SAMPLE* buf) const;
+
+        /**
+         * Compute the index of the segment containing the given line, and the
+         * position of the line inside the segment.
+         *
+         * Line is numbered as in line_read().
+         */
+        void line_segment(size_t line, size_t& segnum, size_t& segline) const;
+
+        /**
+         * Return the MSG_data corresponding to the segment with the given
+         * index, or an empty pointer if the segment is missing.
+         *
+         * The segment stays valid as long as the returned pointer is held,
+         * even if it is evicted from the segment cache meanwhile. It must not
+         * be modified.
+         *
+         * This always loads the segment in memory, even if line_read() would
+         * read it via mmap.
+         */
+        std::shared_ptr<MSG_data> segment(size_t idx) const;
+
+        /// Check if the segment with the given index is in the segment cache
+        bool in_cache(size_t idx) const;
+
+        /// Size in memory of a decoded segment
+        size_t segment_size() const;
+
+        /**
+         * Decode all the segments with index in [first, last) that are not
+         * already in cache, using up to \a threads worker threads, and store
+         * them in the segment cache.
+         *
+         * Missing segments are skipped. If the range does not fit in the
+         * segment cache budget, only its first segments are decoded.
+         *
+         * Returns the number of segments left out because of the budget.
+         */
+        size_t preload(size_t first, size_t last) const;
+
+        /// Preload all the segments of the image, like preload(first, last)
+        size_t preload() const;
+
+        /**
+         * Preload all the segments needed to read the lines in [first, last),
+         * numbered as in line_read().
          *
-         * The pointer could be invalidated by another call to segment()
+         * If they do not all fit in the segment cache budget, the segments
+         * closer to \a first are preferred. Returns the number of segments
+         * left out because of the budget.
          */
-        MSG_data* segment(size_t idx) const;
+        size_t preload_lines(size_t first, size_t last) const;
 };
 
 }
@@ -0,0 +1,241 @@
+/*
+ * xrit/diskcache - Cache of decoded xRIT segments shared across processes
+ *
+ * Copyright (C) 2016  ARPA-SIM <urpsim@smr.arpa.emr.it>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Enrico Zini <enrico@enricozini.org>
+ */
+
+#include <msat/xrit/diskcache.h>
+#include <msat/hrit/MSG_machine.h>
+#include <msat/utils/sys.h>
+#include <msat/utils/kernels.h>
+#include <vector>
+#include <algorithm>
+#include <cstring>
+#include <cstdint>
+#include <cstdio>
+#include <cerrno>
+#include <system_error>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+using namespace std;
+
+namespace msat {
+namespace xrit {
+
+namespace {
+
+const char entry_magic[8] = { 'M', 'S', 'A', 'T', 'S', 'E', 'G', '1' };
+const char entry_suffix[] = ".seg";
+const char tmp_prefix[] = ".tmp";
+
+/// Temporary files older than this are leftovers of interrupted writers
+const time_t tmp_max_age = 3600;
+
+void append_u64(std::string& buf, uint64_t val)
+{
+    buf.append((const char*)&val, sizeof(val));
+}
+
+bool ends_with(const char* name, const char* suffix)
+{
+    size_t nlen = strlen(name);
+    size_t slen = strlen(suffix);
+    return nlen >= slen && strcmp(name + nlen - slen, suffix) == 0;
+}
+
+}
+
+DiskCache::DiskCache(const std::string& dir, size_t budget)
+    : m_dir(sys::abspath(dir)), m_budget(budget)
+{
+    sys::makedirs(m_dir);
+}
+
+std::string DiskCache::entry_header(const std::string& abspath, size_t size, const struct timespec& mtime, size_t count)
+{
+    // Header fields are in host byte order: the cache is local to the machine
+    std::string res(entry_magic, sizeof(entry_magic));
+    append_u64(res, size);
+    append_u64(res, mtime.tv_sec);
+    append_u64(res, mtime.tv_nsec);
+    append_u64(res, count);
+    append_u64(res, abspath.size());
+    res += abspath;
+    // Keep the samples aligned
+    res.resize((res.size() + 7) / 8 * 8, 0);
+    return res;
+}
+
+std::string DiskCache::entry_name(const std::string& abspath, size_t size, const struct timespec& mtime) const
+{
+    // 64 bit FNV-1a hash of the segment identity
+    std::string id = entry_header(abspath, size, mtime, 0);
+    uint64_t hash = 14695981039346656037ull;
+    for (unsigned char c: id)
+    {
+        hash ^= c;
+        hash *= 1099511628211ull;
+    }
+    char buf[17];
+    snprintf(buf, 17, "%016llx", (unsigned long long)hash);
+    return m_dir + "/" + buf + entry_suffix;
+}
+
+size_t DiskCache::lookup(const std::string& segment, size_t count, std::string& entry)
+{
+    std::string path = sys::abspath(segment);
+    struct stat st;
+    sys::stat(path, st);
+    std::string header = entry_header(path, st.st_size, st.st_mtim, count);
+    std::string name = entry_name(path, st.st_size, st.st_mtim);
+
+    // The entry must exist, describe the same segment file and be complete
+    bool found = false;
+    sys::File in(name);
+    if (in.open_ifexists(O_RDONLY))
+    {
+        struct stat est;
+        in.fstat(est);
+        if ((size_t)est.st_size == header.size() + count * 2)
+        {
+            std::vector<char> buf(header.size());
+            if (in.pread(buf.data(), buf.size(), 0) == buf.size()
+                    && memcmp(buf.data(), header.data(), buf.size()) == 0)
+                found = true;
+        }
+        // Mark as recently used
+        if (found)
+            futimens(in, nullptr);
+        in.close();
+    }
+
+    lock_guard<mutex> lock(stats_mutex);
+    if (!found)
+    {
+        ++m_stats.misses;
+        return 0;
+    }
+    ++m_stats.hits;
+    entry = name;
+    return header.size();
+}
+
+void DiskCache::store(const std::string& segment, const MSG_SAMPLE* samples, size_t count)
+{
+    std::string path = sys::abspath(segment);
+    struct stat st;
+    sys::stat(path, st);
+    std::string header = entry_header(path, st.st_size, st.st_mtim, count);
+    std::string name = entry_name(path, st.st_size, st.st_mtim);
+
+    // Store samples big endian, like in uncompressed segment files
+    std::vector<uint16_t> data(count);
+    utils::kernels::copy_u16(samples, count, data.data(), false, !is_big());
+
+    // Write to a temporary file and rename it in place, so that readers only
+    // ever see complete entries, and concurrent writers of the same entry
+    // just replace each other's identical copy
+    sys::File out = sys::File::mkstemp(m_dir + "/" + tmp_prefix);
+    try {
+        out.write_all_or_retry(header.data(), header.size());
+        out.write_all_or_retry(data.data(), count * 2);
+        out.fchmod(0644);
+        out.close();
+        if (::rename(out.name().c_str(), name.c_str()) < 0)
+            throw std::system_error(errno, std::system_category(), "cannot rename " + out.name() + " to " + name);
+    } catch (...) {
+        sys::unlink_ifexists(out.name());
+        throw;
+    }
+
+    {
+        lock_guard<mutex> lock(stats_mutex);
+        ++m_stats.stores;
+    }
+
+    trim();
+}
+
+void DiskCache::trim()
+{
+    struct Entry
+    {
+        std::string name;
+        struct timespec mtime;
+        size_t size;
+    };
+
+    vector<Entry> entries;
+    size_t total = 0;
+    time_t now = time(nullptr);
+
+    sys::Path dir(m_dir);
+    for (auto i = dir.begin(); i != dir.end(); ++i)
+    {
+        const char* name = i->d_name;
+        bool is_entry = ends_with(name, entry_suffix);
+        bool is_tmp = strncmp(name, tmp_prefix, strlen(tmp_prefix)) == 0;
+        if (!is_entry && !is_tmp) continue;
+
+        // Other processes can delete files while we scan
+        struct stat st;
+        if (::fstatat(dir, name, &st, AT_SYMLINK_NOFOLLOW) < 0) continue;
+
+        if (is_tmp)
+        {
+            if (st.st_mtime + tmp_max_age < now)
+                ::unlinkat(dir, name, 0);
+            continue;
+        }
+
+        entries.emplace_back(Entry{name, st.st_mtim, (size_t)st.st_size});
+        total += st.st_size;
+    }
+
+    if (total <= m_budget) return;
+
+    // Delete the least recently used entries first
+    std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) {
+        if (a.mtime.tv_sec != b.mtime.tv_sec) return a.mtime.tv_sec < b.mtime.tv_sec;
+        return a.mtime.tv_nsec < b.mtime.tv_nsec;
+    });
+
+    size_t evicted = 0;
+    for (const auto& e: entries)
+    {
+        if (total <= m_budget) break;
+        // If it fails, someone else deleted it already
+        if (::unlinkat(dir, e.name.c_str(), 0) == 0)
+            ++evicted;
+        total -= e.size;
+    }
+
+    lock_guard<mutex> lock(stats_mutex);
+    m_stats.evictions += evicted;
+}
+
+DiskCache::Stats DiskCache::stats() const
+{
+    lock_guard<mutex> lock(stats_mutex);
+    return m_stats;
+}
+
+}
+}
@@ -0,0 +1,122 @@
+#ifndef MSAT_XRIT_DISKCACHE_H
+#define MSAT_XRIT_DISKCACHE_H
+
+/*
+ * xrit/diskcache - Cache of decoded xRIT segments shared across processes
+ *
+ * Copyright (C) 2016  ARPA-SIM <urpsim@smr.arpa.emr.it>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Enrico Zini <enrico@enricozini.org>
+ */
+
+#include <msat/hrit/MSG_data_image.h>
+#include <string>
+#include <mutex>
+#include <cstddef>
+#include <ctime>
+
+namespace msat {
+namespace xrit {
+
+/**
+ * Directory of decoded segments, so that a segment decoded by one process can
+ * be reused by the following ones.
+ *
+ * Entries are identified by pathname, size and modification time of the
+ * segment file, and contain the decoded samples as 16 bit big endian values,
+ * in the same layout as the data field of an uncompressed segment file, so
+ * that they can be read via mmap.
+ *
+ * Entries are written to a temporary file and renamed in place, so that many
+ * processes can use the same directory at the same time. The total size of
+ * the directory is kept within a budget by deleting the least recently used
+ * entries.
+ */
+class DiskCache
+{
+public:
+        /// Access counters
+        struct Stats
+        {
+                /// Number of lookups that found the segment in cache
+                size_t hits = 0;
+                /// Number of lookups that did not find the segment in cache
+                size_t misses = 0;
+                /// Number of segments added to the cache
+                size_t stores = 0;
+                /// Number of entries deleted to stay within the budget
+                size_t evictions = 0;
+        };
+
+        /// Default size budget
+        static const size_t default_budget = 1024 * 1024 * 1024;
+
+protected:
+        std::string m_dir;
+        size_t m_budget;
+        mutable std::mutex stats_mutex;
+        Stats m_stats;
+
+        /// Pathname of the cache entry for the segment with the given identity
+        std::string entry_name(const std::string& abspath, size_t size, const struct timespec& mtime) const;
+
+        /// Build the header of a cache entry, padded to a multiple of 8 bytes
+        static std::string entry_header(const std::string& abspath, size_t size, const struct timespec& mtime, size_t count);
+
+public:
+        /// Create the cache in the directory \a dir, creating it if missing
+        DiskCache(const std::string& dir, size_t budget=default_budget);
+        DiskCache(const DiskCache&) = delete;
+        DiskCache& operator=(const DiskCache&) = delete;
+
+        /// Cache directory
+        const std::string& dir() const { return m_dir; }
+
+        /// Maximum total size of the cache entries
+        size_t budget() const { return m_budget; }
+
+        /**
+         * Look up the decoded samples of the segment file \a segment, which
+         * has \a count samples.
+         *
+         * On success, returns the offset of the samples in the cache entry and
+         * sets \a entry to its pathname, marking it as recently used. Returns
+         * 0 if the segment is not in cache, or if its file changed since it
+         * was cached.
+         */
+        size_t lookup(const std::string& segment, size_t count, std::string& entry);
+
+        /**
+         * Add the \a count decoded \a samples of the segment file \a segment
+         * to the cache, then delete old entries if the budget is exceeded.
+         */
+        void store(const std::string& segment, const MSG_SAMPLE* samples, size_t count);
+
+        /**
+         * Delete least recently used entries until the cache fits in the
+         * budget. Leftover temporary files are also removed.
+         */
+        void trim();
+
+        /// Access counters for this process
+        Stats stats() const;
+};
+
+}
+}
+
+#endif
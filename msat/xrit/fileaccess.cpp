@@ -21,9 +21,11 @@
  */
 
 #include <msat/xrit/fileaccess.h>
+#include <msat/xrit/archiveindex.h>
 #include <glob.h>
 #include <stdexcept>
 #include <sstream>
+#include <cctype>
 
 using namespace std;
 
@@ -67,6 +69,33 @@ bool isValid(const std::string& filename)
 	return true;
 }
 
+int segmentNumber(const std::string& filename)
+{
+    size_t beg = filename.rfind('/');
+    beg = beg == string::npos ? 0 : beg + 1;
+
+    // The segment number is the sixth dash-separated field
+    for (int i = 0; i < 5; ++i)
+    {
+        if ((beg = filename.find('-', beg)) == string::npos)
+            return -1;
+        ++beg;
+    }
+    size_t end = filename.find('-', beg);
+    if (end == string::npos || end == beg)
+        return -1;
+
+    int res = 0;
+    size_t pos = beg;
+    for ( ; pos < end && isdigit(filename[pos]); ++pos)
+        res = res * 10 + filename[pos] - '0';
+    if (pos == beg) return -1;
+    // Digits can only be followed by underscore padding
+    for ( ; pos < end; ++pos)
+        if (filename[pos] != '_') return -1;
+    return res;
+}
+
 // dir/res:prodid1:prodid2:time
 FileAccess::FileAccess(const std::string& filename)
 {
@@ -85,6 +114,7 @@ void FileAccess::parse(const FileAccess& fa, const std::string& chan)
     productid1 = fa.productid1;
     productid2 = chan;
     timing = fa.timing;
+    index = fa.index;
 }
 
 void FileAccess::parse(const std::string& filename)
@@ -180,6 +210,15 @@ void FileAccess::ensureComplete() const
 
 std::string FileAccess::prologueFile() const
 {
+  // Look the file up in the index instead of listing the directory
+  if (index && index->covers(*this))
+  {
+    const ArchiveIndex::Slot* slot = index->find_slot(*this);
+    if (!slot || slot->prologue.empty())
+      throw std::runtime_error("No such file(s)");
+    return directory + PATH_SEPARATOR + slot->prologue;
+  }
+
   std::string filename = directory
 		       + PATH_SEPARATOR
 					 + resolution
@@ -206,6 +245,15 @@ std::string FileAccess::prologueFile() const
 
 std::string FileAccess::epilogueFile() const
 {
+  // Look the file up in the index instead of listing the directory
+  if (index && index->covers(*this))
+  {
+    const ArchiveIndex::Slot* slot = index->find_slot(*this);
+    if (!slot || slot->epilogue.empty())
+      throw std::runtime_error("No such file(s)");
+    return directory + PATH_SEPARATOR + slot->epilogue;
+  }
+
   std::string filename = directory
 		       + PATH_SEPARATOR
 					 + resolution
@@ -232,6 +280,18 @@ std::string FileAccess::epilogueFile() const
 
 std::vector<std::string> FileAccess::segmentFiles() const
 {
+    // Look the files up in the index instead of listing the directory
+    if (index && index->covers(*this))
+    {
+        const ArchiveIndex::Product* p = index->find(*this);
+        if (!p || p->segments.empty())
+            throw std::runtime_error("No such file(s)");
+        std::vector<std::string> res;
+        for (const auto& name: p->segment_names())
+            res.push_back(directory + PATH_SEPARATOR + name);
+        return res;
+    }
+
     string filename = directory
         + PATH_SEPARATOR
         + resolution
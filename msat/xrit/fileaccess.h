@@ -25,13 +25,23 @@
 
 #include <string>
 #include <vector>
+#include <memory>
 
 namespace msat {
 namespace xrit {
 
+class ArchiveIndex;
+
 /// Return true if the file name looks like a valid XRIT 'pathname'
 bool isValid(const std::string& filename);
 
+/**
+ * Return the segment number found in the name of a segment file, or -1 if the
+ * file name is not in the form
+ * [directory/]resolution-nnn-xxxxxx-productid1-productid2-segment-datetime-C_
+ */
+int segmentNumber(const std::string& filename);
+
 /**
  * Compute the names of the various file parts of the XRIT data
  */
@@ -43,6 +53,12 @@ struct FileAccess
 	std::string productid2;
 	std::string timing;
 
+    /**
+     * If set, file names in the directories covered by the index are looked
+     * up there instead of listing the directory
+     */
+    std::shared_ptr<const ArchiveIndex> index;
+
     FileAccess() : directory(".") {}
     FileAccess(const std::string& filename);
     FileAccess(const FileAccess& fa) = default;
@@ -0,0 +1,129 @@
+/*
+ * xrit/prologuecache - Process-wide cache of parsed prologues and epilogues
+ *
+ * Copyright (C) 2016  ARPA-SIM <urpsim@smr.arpa.emr.it>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Enrico Zini <enrico@enricozini.org>
+ */
+
+#include <msat/xrit/prologuecache.h>
+#include <msat/xrit/fileaccess.h>
+#include <msat/hrit/MSG_HRIT.h>
+#include <stdexcept>
+#include <fstream>
+#include <sys/stat.h>
+
+using namespace std;
+
+namespace msat {
+namespace xrit {
+
+namespace {
+
+std::shared_ptr<MSG_data> parse(const std::string& pathname)
+{
+    std::ifstream hrit(pathname.c_str(), (std::ios::binary | std::ios::in));
+    if (hrit.fail()) throw std::runtime_error(pathname + ": cannot open");
+    MSG_header head;
+    std::shared_ptr<MSG_data> res(new MSG_data);
+    head.read_from(hrit);
+    res->read_from(hrit, head);
+    return res;
+}
+
+std::string make_key(const FileAccess& fa, const char* type)
+{
+    return fa.directory + "/" + fa.resolution + ":" + fa.productid1 + ":" + type + ":" + fa.timing;
+}
+
+}
+
+PrologueCache& PrologueCache::instance()
+{
+    static PrologueCache cache;
+    return cache;
+}
+
+std::shared_ptr<MSG_data> PrologueCache::get(const std::string& key, std::function<std::string()> find_file)
+{
+    lock_guard<std::mutex> lock(this->mutex);
+
+    for (auto i = entries.begin(); i != entries.end(); ++i)
+    {
+        if (i->key != key) continue;
+
+        // Use the cached version only if the file has not changed
+        struct stat st;
+        if (::stat(i->pathname.c_str(), &st) == 0
+                && (size_t)st.st_size == i->size
+                && st.st_mtim.tv_sec == i->mtime.tv_sec
+                && st.st_mtim.tv_nsec == i->mtime.tv_nsec)
+        {
+            ++m_stats.hits;
+            entries.splice(entries.begin(), entries, i);
+            return i->data;
+        }
+        entries.erase(i);
+        break;
+    }
+
+    // Parse while holding the lock, so that datasets opened at the same time
+    // in different threads wait for the same parse instead of repeating it
+    ++m_stats.misses;
+    Entry e;
+    e.key = key;
+    e.pathname = find_file();
+    struct stat st;
+    if (::stat(e.pathname.c_str(), &st) != 0)
+        throw std::runtime_error(e.pathname + ": cannot stat");
+    e.size = st.st_size;
+    e.mtime = st.st_mtim;
+    e.data = parse(e.pathname);
+
+    entries.push_front(e);
+    if (entries.size() > max_entries)
+        entries.pop_back();
+    return e.data;
+}
+
+std::shared_ptr<MSG_data> PrologueCache::prologue(const FileAccess& fa)
+{
+    return instance().get(make_key(fa, "PRO"), [&] { return fa.prologueFile(); });
+}
+
+std::shared_ptr<MSG_data> PrologueCache::epilogue(const FileAccess& fa)
+{
+    return instance().get(make_key(fa, "EPI"), [&] { return fa.epilogueFile(); });
+}
+
+PrologueCache::Stats PrologueCache::stats()
+{
+    PrologueCache& cache = instance();
+    lock_guard<std::mutex> lock(cache.mutex);
+    return cache.m_stats;
+}
+
+void PrologueCache::clear()
+{
+    PrologueCache& cache = instance();
+    lock_guard<std::mutex> lock(cache.mutex);
+    cache.entries.clear();
+    cache.m_stats = Stats();
+}
+
+}
+}
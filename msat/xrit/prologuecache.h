@@ -0,0 +1,110 @@
+#ifndef MSAT_XRIT_PROLOGUECACHE_H
+#define MSAT_XRIT_PROLOGUECACHE_H
+
+/*
+ * xrit/prologuecache - Process-wide cache of parsed prologues and epilogues
+ *
+ * Copyright (C) 2016  ARPA-SIM <urpsim@smr.arpa.emr.it>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Enrico Zini <enrico@enricozini.org>
+ */
+
+#include <string>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <functional>
+#include <ctime>
+#include <cstddef>
+
+struct MSG_data;
+
+namespace msat {
+namespace xrit {
+
+struct FileAccess;
+
+/**
+ * Cache of parsed prologue and epilogue files, shared by all the datasets
+ * opened by the process, so that opening many channels of the same repeat
+ * cycle parses them only once.
+ *
+ * Entries are identified by directory, satellite and time of the repeat
+ * cycle, and are parsed again if the file size or modification time
+ * changes. The cache is thread safe, and the parsed data it returns must not
+ * be modified.
+ */
+class PrologueCache
+{
+public:
+        /// Access counters
+        struct Stats
+        {
+                /// Number of lookups that found the file already parsed
+                size_t hits = 0;
+                /// Number of lookups that needed to parse the file
+                size_t misses = 0;
+        };
+
+        /// Maximum number of parsed files that are kept
+        static const size_t max_entries = 32;
+
+        /// Return the parsed prologue of the product described by \a fa
+        static std::shared_ptr<MSG_data> prologue(const FileAccess& fa);
+
+        /**
+         * Return the parsed epilogue of the product described by \a fa.
+         *
+         * Like FileAccess::epilogueFile(), throws std::runtime_error if the
+         * epilogue file does not exist.
+         */
+        static std::shared_ptr<MSG_data> epilogue(const FileAccess& fa);
+
+        /// Access counters
+        static Stats stats();
+
+        /// Remove all entries and reset the access counters
+        static void clear();
+
+protected:
+        struct Entry
+        {
+                std::string key;
+                std::string pathname;
+                size_t size;
+                struct timespec mtime;
+                std::shared_ptr<MSG_data> data;
+        };
+
+        std::mutex mutex;
+        /// Cached files, most recently used first
+        std::list<Entry> entries;
+        Stats m_stats;
+
+        static PrologueCache& instance();
+
+        /**
+         * Return the entry with the given key, calling \a find_file to locate
+         * the file to parse if it is not cached or has changed
+         */
+        std::shared_ptr<MSG_data> get(const std::string& key, std::function<std::string()> find_file);
+};
+
+}
+}
+
+#endif
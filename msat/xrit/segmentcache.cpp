@@ -0,0 +1,107 @@
+/*
+ * xrit/segmentcache - LRU cache of decoded xRIT segments
+ *
+ * Copyright (C) 2016  ARPA-SIM <urpsim@smr.arpa.emr.it>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Enrico Zini <enrico@enricozini.org>
+ */
+
+#include <msat/xrit/segmentcache.h>
+#include <msat/hrit/MSG_HRIT.h>
+
+using namespace std;
+
+namespace msat {
+namespace xrit {
+
+SegmentCache::SegmentCache(size_t budget)
+    : m_budget(budget)
+{
+}
+
+SegmentCache::~SegmentCache()
+{
+    clear();
+}
+
+std::shared_ptr<MSG_data> SegmentCache::get(size_t idx)
+{
+    auto i = by_idx.find(idx);
+    if (i == by_idx.end())
+    {
+        ++m_stats.misses;
+        return nullptr;
+    }
+    ++m_stats.hits;
+
+    // Bring it to the front
+    if (i->second != lru.begin())
+        lru.splice(lru.begin(), lru, i->second);
+    return i->second->segment;
+}
+
+bool SegmentCache::has(size_t idx) const
+{
+    return by_idx.find(idx) != by_idx.end();
+}
+
+void SegmentCache::shrink(size_t size)
+{
+    while (!lru.empty() && m_bytes > size)
+    {
+        Entry& e = lru.back();
+        m_bytes -= e.size;
+        by_idx.erase(e.idx);
+        lru.pop_back();
+        ++m_stats.evictions;
+    }
+}
+
+void SegmentCache::put(size_t idx, std::shared_ptr<MSG_data> segment, size_t size)
+{
+    // Replace an existing entry for the same segment
+    auto old = by_idx.find(idx);
+    if (old != by_idx.end())
+    {
+        m_bytes -= old->second->size;
+        lru.erase(old->second);
+        by_idx.erase(old);
+    }
+
+    // Make room for the new segment
+    shrink(size > m_budget ? 0 : m_budget - size);
+
+    lru.push_front(Entry{idx, std::move(segment), size});
+    by_idx[idx] = lru.begin();
+    m_bytes += size;
+}
+
+void SegmentCache::clear()
+{
+    lru.clear();
+    by_idx.clear();
+    m_bytes = 0;
+}
+
+void SegmentCache::set_budget(size_t budget)
+{
+    m_budget = budget;
+    shrink(budget);
+}
+
+}
+}
@@ -0,0 +1,131 @@
+#ifndef MSAT_XRIT_SEGMENTCACHE_H
+#define MSAT_XRIT_SEGMENTCACHE_H
+
+/*
+ * xrit/segmentcache - LRU cache of decoded xRIT segments
+ *
+ * Copyright (C) 2016  ARPA-SIM <urpsim@smr.arpa.emr.it>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Enrico Zini <enrico@enricozini.org>
+ */
+
+#include <list>
+#include <unordered_map>
+#include <memory>
+#include <cstddef>
+
+struct MSG_data;
+
+namespace msat {
+namespace xrit {
+
+/**
+ * Least recently used cache of decoded segments, indexed by segment index
+ * and bounded by the total size in bytes of the segments it holds.
+ *
+ * Segments are reference counted: one that is evicted while someone still
+ * holds it is freed when the last reference goes away. The cache itself is
+ * not thread safe, and needs to be protected by its user.
+ */
+class SegmentCache
+{
+public:
+        /// Access counters
+        struct Stats
+        {
+                /// Number of lookups that found the segment in cache
+                size_t hits = 0;
+                /// Number of lookups that did not find the segment in cache
+                size_t misses = 0;
+                /// Number of segments removed to make room for new ones
+                size_t evictions = 0;
+        };
+
+        /// Default memory budget
+        static const size_t default_budget = 64 * 1024 * 1024;
+
+protected:
+        struct Entry
+        {
+                size_t idx;
+                std::shared_ptr<MSG_data> segment;
+                size_t size;
+        };
+
+        /// Cached segments, most recently used first
+        std::list<Entry> lru;
+        /// Index of the entries in lru by segment index
+        std::unordered_map<size_t, std::list<Entry>::iterator> by_idx;
+        /// Maximum total size of the cached segments
+        size_t m_budget;
+        /// Total size of the cached segments
+        size_t m_bytes = 0;
+        Stats m_stats;
+
+        /// Evict least recently used segments until there are at most \a size bytes in use
+        void shrink(size_t size);
+
+public:
+        SegmentCache(size_t budget=default_budget);
+        SegmentCache(const SegmentCache&) = delete;
+        ~SegmentCache();
+        SegmentCache& operator=(const SegmentCache&) = delete;
+
+        /**
+         * Return the segment with the given index, or an empty pointer if it
+         * is not in cache.
+         *
+         * A successful lookup marks the segment as most recently used.
+         * Lookups are counted in the hit/miss statistics.
+         */
+        std::shared_ptr<MSG_data> get(size_t idx);
+
+        /// Check if a segment is in cache, without affecting LRU order or statistics
+        bool has(size_t idx) const;
+
+        /**
+         * Add a segment to the cache.
+         *
+         * Least recently used segments are evicted to stay within the budget.
+         * The segment just added is always kept, even if it alone exceeds the
+         * budget.
+         */
+        void put(size_t idx, std::shared_ptr<MSG_data> segment, size_t size);
+
+        /// Remove all segments from the cache
+        void clear();
+
+        /// Change the memory budget, evicting segments if needed
+        void set_budget(size_t budget);
+
+        /// Maximum total size of the cached segments
+        size_t budget() const { return m_budget; }
+
+        /// Total size of the cached segments
+        size_t bytes() const { return m_bytes; }
+
+        /// Number of cached segments
+        size_t size() const { return lru.size(); }
+
+        /// Access counters
+        const Stats& stats() const { return m_stats; }
+};
+
+}
+}
+
+#endif
@@ -0,0 +1,117 @@
+/*
+ * xrit/segmentwatcher - Wait for xRIT segment files to arrive
+ *
+ * Copyright (C) 2016  ARPA-SIM <urpsim@smr.arpa.emr.it>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Enrico Zini <enrico@enricozini.org>
+ */
+
+#include <msat/xrit/segmentwatcher.h>
+#include <stdexcept>
+#include <system_error>
+#include <chrono>
+#include <cerrno>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/inotify.h>
+
+using namespace std;
+
+namespace msat {
+namespace xrit {
+
+SegmentWatcher::SegmentWatcher(const FileAccess& fa)
+    : fa(fa)
+{
+    fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (fd < 0)
+        throw std::system_error(errno, std::system_category(), "cannot initialize inotify");
+    if (inotify_add_watch(fd, fa.directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0)
+    {
+        int e = errno;
+        ::close(fd);
+        throw std::system_error(e, std::system_category(), "cannot watch " + fa.directory);
+    }
+}
+
+SegmentWatcher::~SegmentWatcher()
+{
+    ::close(fd);
+}
+
+bool SegmentWatcher::matches(const std::string& name) const
+{
+    if (segmentNumber(name) == -1) return false;
+    FileAccess seg;
+    try {
+        seg.parse(name);
+    } catch (std::runtime_error&) {
+        return false;
+    }
+    return seg.resolution == fa.resolution
+        && seg.productid1 == fa.productid1
+        && seg.productid2 == fa.productid2
+        && seg.timing == fa.timing;
+}
+
+bool SegmentWatcher::wait(int timeout)
+{
+    auto deadline = chrono::steady_clock::now() + chrono::milliseconds(timeout);
+    while (true)
+    {
+        int remaining = -1;
+        if (timeout >= 0)
+        {
+            auto left = chrono::duration_cast<chrono::milliseconds>(deadline - chrono::steady_clock::now()).count();
+            remaining = left > 0 ? left : 0;
+        }
+
+        struct pollfd pfd = { fd, POLLIN, 0 };
+        int res = poll(&pfd, 1, remaining);
+        if (res < 0)
+        {
+            if (errno == EINTR) continue;
+            throw std::system_error(errno, std::system_category(), "cannot poll inotify events");
+        }
+        if (res == 0) return false;
+
+        // Consume all pending events, looking for a segment of our product
+        bool found = false;
+        alignas(struct inotify_event) char buf[4096];
+        while (true)
+        {
+            ssize_t len = read(fd, buf, sizeof(buf));
+            if (len < 0)
+            {
+                if (errno == EAGAIN) break;
+                if (errno == EINTR) continue;
+                throw std::system_error(errno, std::system_category(), "cannot read inotify events");
+            }
+            for (char* pos = buf; pos < buf + len; )
+            {
+                const struct inotify_event* ev = (const struct inotify_event*)pos;
+                if (ev->len && matches(ev->name))
+                    found = true;
+                pos += sizeof(struct inotify_event) + ev->len;
+            }
+        }
+        if (found) return true;
+    }
+}
+
+}
+}
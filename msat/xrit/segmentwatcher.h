@@ -0,0 +1,67 @@
+#ifndef MSAT_XRIT_SEGMENTWATCHER_H
+#define MSAT_XRIT_SEGMENTWATCHER_H
+
+/*
+ * xrit/segmentwatcher - Wait for xRIT segment files to arrive
+ *
+ * Copyright (C) 2016  ARPA-SIM <urpsim@smr.arpa.emr.it>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Enrico Zini <enrico@enricozini.org>
+ */
+
+#include <msat/xrit/fileaccess.h>
+
+namespace msat {
+namespace xrit {
+
+/**
+ * Watch the directory of an xRIT product with inotify, to be notified when
+ * new segment files of that product have been written.
+ *
+ * Use together with DataAccess::refresh() to read a repeat cycle while it is
+ * being received.
+ */
+class SegmentWatcher
+{
+protected:
+        FileAccess fa;
+        int fd;
+
+        /// Check if a file name is a segment of the product we are watching
+        bool matches(const std::string& name) const;
+
+public:
+        /// Start watching the directory of \a fa
+        SegmentWatcher(const FileAccess& fa);
+        SegmentWatcher(const SegmentWatcher&) = delete;
+        ~SegmentWatcher();
+        SegmentWatcher& operator=(const SegmentWatcher&) = delete;
+
+        /**
+         * Wait until a segment file of the product has been closed after
+         * writing or moved into the directory.
+         *
+         * \a timeout is in milliseconds, and -1 waits forever. Returns false
+         * if the timeout expired and no new segment arrived.
+         */
+        bool wait(int timeout=-1);
+};
+
+}
+}
+
+#endif
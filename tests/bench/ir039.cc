@@ -0,0 +1,118 @@
+/*
+ * Microbenchmark for the IR 3.9 reflectance computation
+ *
+ * Computes the IR 3.9 reflectance of a full disk image (3712 lines of 3712
+ * columns) of brightness temperatures, as the derived bands do: once with
+ * the literal pow() and exp() formulas the bands used before, and once with
+ * facts::IR039Reflectance.
+ */
+#include <msat/facts.h>
+#include <vector>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+
+using namespace msat::facts;
+using namespace std;
+
+static const size_t columns = 3712;
+static const size_t lines = 3712;
+static const int julian_day = 74;
+
+struct Data
+{
+    vector<double> bt039;
+    vector<double> bt108;
+    vector<double> bt134;
+    vector<double> cos_sol_za;
+    vector<double> sat_za;
+    vector<double> out;
+
+    Data()
+        : bt039(columns * lines), bt108(columns * lines), bt134(columns * lines),
+          cos_sol_za(columns * lines), sat_za(columns * lines), out(columns * lines)
+    {
+        for (size_t y = 0; y < lines; ++y)
+            for (size_t x = 0; x < columns; ++x)
+            {
+                size_t i = y * columns + x;
+                bt039[i] = 220.0 + 110.0 * ((x * 7 + y * 13) % 1000) / 1000.0;
+                bt108[i] = 210.0 + 100.0 * ((x * 11 + y * 3) % 1000) / 1000.0;
+                bt134[i] = bt108[i] - 5.0 - 20.0 * ((x + y * 17) % 1000) / 1000.0;
+                cos_sol_za[i] = 1.0 - (double)y / lines;
+                sat_za[i] = 1.4 * x / columns;
+            }
+    }
+};
+
+/// The code facts::IR039Reflectance replaced
+static void compute_reference(Data& d)
+{
+    const double c1 = 0.0000119104;
+    const double c2 = 1.43877;
+    const double Vc = 2569.094;
+    const double A = 0.9959;
+    const double B = 3.471;
+    double esd = 1.0 - 0.0167 * cos( 2.0 * M_PI * (julian_day - 3) / 365.0);
+
+    for (size_t i = 0; i < d.out.size(); ++i)
+    {
+        double BT108 = d.bt108[i];
+        double BT134 = d.bt134[i];
+        double BT039 = pow(pow(d.bt039[i], 4)
+                         + pow(BT108, 4)
+                         - pow(BT108 - (BT108 - BT134)/4, 4),
+                         0.25);
+        double R_tot = c1 * (Vc*Vc*Vc) / (exp(c2 * Vc / (A * BT039 + B)) - 1) + 0.015;
+        double R39_corr = pow((BT108 - 0.25 * (BT108 - BT134)) / BT108, 4);
+        double R_therm = c1 * (Vc*Vc*Vc) / (exp(c2 * Vc / (A * BT108 + B)) - 1) * R39_corr;
+        double cosTETA = d.cos_sol_za[i];
+        if (cosTETA < 0.173648178) cosTETA = 0.173648178;
+        double TOARAD = 4.92 / (esd*esd)
+                      * pow(cosTETA, 0.75)
+                      * exp(-(1-R39_corr) * cosTETA)
+                      * exp(-(1-R39_corr) / cos(d.sat_za[i]));
+        if (R_tot <= R_therm) R_tot = R_therm + 0.0000001;
+        if (TOARAD <= R_therm) TOARAD = R_therm + 0.0000001;
+        double REFL = 100 * (R_tot - R_therm) / (TOARAD);
+        if (!(REFL > 0.0)) REFL = 0.0;
+        if (REFL > 100.0) REFL = 100.0;
+        d.out[i] = REFL;
+    }
+}
+
+static void compute_facts(Data& d)
+{
+    IR039Reflectance ir039(julian_day);
+    for (size_t i = 0; i < d.out.size(); ++i)
+        d.out[i] = ir039.reflectance(d.bt039[i], d.bt108[i], d.bt134[i], d.cos_sol_za[i], d.sat_za[i]);
+}
+
+template<typename F>
+static double time_best(F f, int runs)
+{
+    double best = 1e100;
+    for (int i = 0; i < runs; ++i)
+    {
+        auto start = chrono::steady_clock::now();
+        f();
+        chrono::duration<double, milli> elapsed = chrono::steady_clock::now() - start;
+        if (elapsed.count() < best) best = elapsed.count();
+    }
+    return best;
+}
+
+int main(int argc, const char* argv[])
+{
+    int runs = argc > 1 ? atoi(argv[1]) : 5;
+    Data d;
+
+    double ref = time_best([&] { compute_reference(d); }, runs);
+    printf("%-10s %8.2fms\n", "reference", ref);
+
+    double t = time_best([&] { compute_facts(d); }, runs);
+    printf("%-10s %8.2fms  %.2fx\n", "facts", t, ref / t);
+
+    return 0;
+}
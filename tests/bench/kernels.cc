@@ -0,0 +1,99 @@
+/*
+ * Microbenchmark for the scanline conversion kernels
+ *
+ * Converts a full disk IR image (3712 lines of 3712 columns) as the XRIT
+ * driver does: flip each line horizontally, then calibrate it with a lookup
+ * table, clamping invalid values and padding the line.
+ */
+#include <msat/utils/kernels.h>
+#include <vector>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+
+using namespace msat::utils::kernels;
+using namespace std;
+
+static const size_t columns = 3712;
+static const size_t lines = 3712;
+static const size_t pad = 16;
+
+struct Data
+{
+    vector<uint16_t> image;
+    vector<float> lut;
+    vector<uint16_t> line;
+    vector<float> out;
+
+    Data()
+        : image(columns * lines), lut(1024), line(columns), out(columns + 2 * pad)
+    {
+        for (size_t i = 0; i < image.size(); ++i)
+            image[i] = rand() % 1024;
+        for (size_t i = 0; i < lut.size(); ++i)
+            lut[i] = i < 20 ? -1 : 200 + i * 0.1;
+    }
+};
+
+/// The code the kernels replaced
+static void convert_reference(Data& d)
+{
+    for (size_t y = 0; y < lines; ++y)
+    {
+        const uint16_t* src = d.image.data() + y * columns;
+        for (size_t i = 0; i < columns; ++i)
+            d.line[columns - i - 1] = src[i];
+        for (size_t i = 0; i < pad; ++i)
+            d.out[i] = 0.0;
+        for (size_t i = 0; i < columns; ++i)
+        {
+            float res = d.lut[d.line[i]];
+            if (res < 0 || std::isnan(res)) res = 0;
+            d.out[pad + i] = res;
+        }
+        for (size_t i = pad + columns; i < d.out.size(); ++i)
+            d.out[i] = 0.0;
+    }
+}
+
+static void convert_kernels(Data& d, ISA isa)
+{
+    for (size_t y = 0; y < lines; ++y)
+    {
+        copy_u16(isa, d.image.data() + y * columns, columns, d.line.data(), true, false);
+        calibrate(isa, d.line.data(), columns, d.lut.data(), d.out.data(), pad, pad);
+    }
+}
+
+template<typename F>
+static double time_best(F f, int runs)
+{
+    double best = 1e100;
+    for (int i = 0; i < runs; ++i)
+    {
+        auto start = chrono::steady_clock::now();
+        f();
+        chrono::duration<double, milli> elapsed = chrono::steady_clock::now() - start;
+        if (elapsed.count() < best) best = elapsed.count();
+    }
+    return best;
+}
+
+int main(int argc, const char* argv[])
+{
+    int runs = argc > 1 ? atoi(argv[1]) : 10;
+    Data d;
+
+    double ref = time_best([&] { convert_reference(d); }, runs);
+    printf("%-10s %8.2fms\n", "reference", ref);
+
+    for (ISA isa: { ISA::SCALAR, ISA::SSE2, ISA::AVX2 })
+    {
+        if (isa > best_isa()) break;
+        double t = time_best([&] { convert_kernels(d, isa); }, runs);
+        printf("%-10s %8.2fms  %.2fx\n", isa_name(isa), t, ref / t);
+    }
+
+    return 0;
+}
@@ -0,0 +1,84 @@
+/*
+ * Microbenchmark for the solar zenith angle computation
+ *
+ * Computes the cosine of the solar zenith angle of a full disk image (3712
+ * lines of 3712 columns) as the derived bands do: once calling the scalar
+ * facts::cos_sol_za for each pixel, and once a line at a time with
+ * facts::SolarPosition.
+ */
+#include <msat/facts.h>
+#include <vector>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+using namespace msat::facts;
+using namespace std;
+
+static const size_t columns = 3712;
+static const size_t lines = 3712;
+static const int julian_day = 74;
+static const double daytime = 12.25;
+
+struct Data
+{
+    vector<double> lats;
+    vector<double> lons;
+    vector<double> out;
+
+    Data()
+        : lats(columns * lines), lons(columns * lines), out(columns * lines)
+    {
+        for (size_t y = 0; y < lines; ++y)
+            for (size_t x = 0; x < columns; ++x)
+            {
+                lats[y * columns + x] = 81.0 - 162.0 * y / lines;
+                lons[y * columns + x] = -81.0 + 162.0 * x / columns;
+            }
+    }
+};
+
+/// The code the batched version replaced
+static void compute_reference(Data& d)
+{
+    for (size_t i = 0; i < d.out.size(); ++i)
+        d.out[i] = cos_sol_za(julian_day, daytime, d.lats[i], d.lons[i]);
+}
+
+static void compute_batch(Data& d)
+{
+    SolarPosition sun(julian_day, daytime);
+    for (size_t y = 0; y < lines; ++y)
+    {
+        size_t ofs = y * columns;
+        sun.cos_sol_za(columns, d.lats.data() + ofs, d.lons.data() + ofs, d.out.data() + ofs);
+    }
+}
+
+template<typename F>
+static double time_best(F f, int runs)
+{
+    double best = 1e100;
+    for (int i = 0; i < runs; ++i)
+    {
+        auto start = chrono::steady_clock::now();
+        f();
+        chrono::duration<double, milli> elapsed = chrono::steady_clock::now() - start;
+        if (elapsed.count() < best) best = elapsed.count();
+    }
+    return best;
+}
+
+int main(int argc, const char* argv[])
+{
+    int runs = argc > 1 ? atoi(argv[1]) : 5;
+    Data d;
+
+    double ref = time_best([&] { compute_reference(d); }, runs);
+    printf("%-10s %8.2fms\n", "reference", ref);
+
+    double t = time_best([&] { compute_batch(d); }, runs);
+    printf("%-10s %8.2fms  %.2fx\n", "batch", t, ref / t);
+
+    return 0;
+}
@@ -126,6 +126,45 @@ add_method("known2", [](Fixture& f) {
 #endif
 });
 
+// Test the closed-form projection against OGR
+add_method("geos", [](Fixture& f) {
+    GeoReferencer gr(f.dataset());
+    msat::utils::GeosProjection geos;
+    wassert(actual(msat::dataset::geosFromWKT(f.dataset()->GetProjectionRef(), geos)).istrue());
+    wassert(actual(geos.sublon) == 0);
+
+    double gt[6];
+    f.dataset()->GetGeoTransform(gt);
+    for (int y = 0; y < 3712; y += 53)
+        for (int x = 0; x < 3712; x += 47)
+        {
+            double lat, lon;
+            if (geos.pixels_to_latlon(gt, x, y, 1, &lat, &lon) == 0)
+                continue;
+
+            double olat, olon;
+            gr.pixelToLatlon(x, y, olat, olon);
+            wassert(actual(lat).almost_equal(olat, 6));
+            wassert(actual(lon).almost_equal(olon, 6));
+
+            double px, py, opx, opy;
+            wassert(actual(geos.from_latlon(1, &lat, &lon, &px, &py)) == 1u);
+            gr.latlonToProjected(olat, olon, opx, opy);
+            wassert(actual(px).almost_equal(opx, 2));
+            wassert(actual(py).almost_equal(opy, 2));
+        }
+
+    // Corners of the image are in space
+    double lat, lon;
+    wassert(actual(geos.pixels_to_latlon(gt, 0, 0, 1, &lat, &lon)) == 0u);
+    wassert(actual_function([&] { gr.pixelToLatlon(0, 0, lat, lon); }).throws("failed to transform"));
+
+    // Other projections are left to OGR
+    const char* wgs84 = "GEOGCS[\"WGS 84\",DATUM[\"WGS_1984\",SPHEROID[\"WGS 84\",6378137,298.257223563]],"
+                        "PRIMEM[\"Greenwich\",0],UNIT[\"degree\",0.0174532925199433]]";
+    wassert(actual(msat::dataset::geosFromWKT(wgs84, geos)).isfalse());
+});
+
 }
 
 }
@@ -1,5 +1,7 @@
 #include "utils.h"
 #include "msat/facts.h"
+#include <cstdint>
+#include <vector>
 
 using namespace std;
 using namespace msat::tests;
@@ -190,6 +192,33 @@ void Tests::register_tests()
         wassert(actual(b->GetOffset()).almost_equal(-1.63196, 5));
         wassert(actual(b->GetScale()).almost_equal(0.03200, 5));
     });
+
+    // The mask only covers the part of the disk inside the HRV windows
+    this->add_method("disk_mask", [](Fixture& f) {
+        GDALRasterBand* mask = f.dataset()->GetRasterBand(1)->GetMaskBand();
+        struct { int x, y; unsigned val; } points[] = {
+            { 2500, 2900, 0 },   // On the disk, left of the Europe part
+            { 4000, 2900, 255 }, // Europe part
+            { 9200, 2900, 0 },   // On the disk, right of the Europe part
+            { 5300, 3150, 0 },   // On the disk, left of the Africa part
+            { 8600, 3111, 255 }, // Africa part
+        };
+        for (const auto& p: points)
+        {
+            uint8_t val;
+            wassert(actual(mask->RasterIO(GF_Read, p.x, p.y, 1, 1, &val, 1, 1, GDT_Byte, 0, 0)) == CE_None);
+            wassert(actual((unsigned)val) == p.val);
+        }
+
+        // No line has more pixels with data than the HRV window is wide
+        vector<uint8_t> line(11136);
+        wassert(actual(mask->RasterIO(GF_Read, 0, 5568, 11136, 1, line.data(), 11136, 1, GDT_Byte, 0, 0)) == CE_None);
+        unsigned count = 0;
+        for (auto v: line)
+            if (v) ++count;
+        wassert(actual(count) > 0u);
+        wassert(actual(count) <= 5568u);
+    });
 }
 
 }
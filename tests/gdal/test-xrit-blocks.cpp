@@ -0,0 +1,219 @@
+#include "utils.h"
+#include <msat/utils/sys.h>
+#include <cstdint>
+#include <vector>
+
+using namespace std;
+using namespace msat::tests;
+
+namespace {
+
+#define TESTDATA_RSS   "rss/H:MSG2_RSS:VIS006:201604281230"
+#define TESTDATA_RSSNL "rss/H:MSG2_RSS:IR_039:201604281230"
+#define TESTDATA_HRV   "H:MSG1:HRV:200611141200"
+
+// Open a dataset with 500x500 tiles, using the config option so that it also
+// works with GDAL versions without open options
+unique_ptr<GDALDataset> open_tiled(const char* name)
+{
+    CPLSetConfigOption("MSAT_XRIT_TILE_SIZE", "500");
+    unique_ptr<GDALDataset> res = gdal::open_ro(name);
+    CPLSetConfigOption("MSAT_XRIT_TILE_SIZE", nullptr);
+    return res;
+}
+
+// Write segment \a segno of the RSS VIS006 repeat cycle in \a dir, using the
+// contents of segment 8 with a patched sequence number
+void write_rss_segment(const std::string& dir, unsigned segno)
+{
+    const std::string seg = "H-000-MSG2__-MSG2_RSS____-VIS006___-000008___-201604281230-C_";
+    std::string data = msat::sys::read_file(DATA_DIR "/rss/" + seg);
+    unsigned char* buf = (unsigned char*)&data[0];
+    size_t header_len = (buf[4] << 24) | (buf[5] << 16) | (buf[6] << 8) | buf[7];
+    for (size_t pos = 0; pos < header_len; )
+    {
+        size_t rec_len = (buf[pos + 1] << 8) | buf[pos + 2];
+        if (buf[pos] == 128)
+        {
+            buf[pos + 6] = segno >> 8;
+            buf[pos + 7] = segno & 0xff;
+        }
+        pos += rec_len;
+    }
+    std::string name = seg;
+    name[41] = '0' + segno;
+    msat::sys::write_file(dir + "/" + name, data);
+}
+
+class Tests : public TestCase
+{
+    using TestCase::TestCase;
+
+    void register_tests() override;
+} test("gdal_xrit_blocks");
+
+void Tests::register_tests()
+{
+
+add_method("block_size", []{
+    unique_ptr<GDALDataset> strips = gdal::open_ro(TESTDATA_RSS);
+    unique_ptr<GDALDataset> tiles = open_tiled(TESTDATA_RSS);
+
+    int bx, by;
+    strips->GetRasterBand(1)->GetBlockSize(&bx, &by);
+    wassert(actual(bx) == 3712);
+    wassert(actual(by) == 464);
+
+    tiles->GetRasterBand(1)->GetBlockSize(&bx, &by);
+    wassert(actual(bx) == 500);
+    wassert(actual(by) == 500);
+});
+
+// Read a window crossing segment and tile boundaries, including partial
+// tiles on the right edge, both directly and through the block cache
+add_method("linear", []{
+    unique_ptr<GDALDataset> strips = gdal::open_ro(TESTDATA_RSS);
+    unique_ptr<GDALDataset> tiles = open_tiled(TESTDATA_RSS);
+    const int x = 3300, y = 100, w = 412, h = 600;
+
+    vector<uint16_t> direct(w * h);
+    wassert(actual(strips->GetRasterBand(1)->RasterIO(GF_Read, x, y, w, h, direct.data(), w, h, GDT_UInt16, 0, 0)) == CE_None);
+
+    vector<uint16_t> tiled(w * h);
+    wassert(actual(tiles->GetRasterBand(1)->RasterIO(GF_Read, x, y, w, h, tiled.data(), w, h, GDT_UInt16, 0, 0)) == CE_None);
+
+    vector<double> blocks(w * h);
+    wassert(actual(tiles->GetRasterBand(1)->RasterIO(GF_Read, x, y, w, h, blocks.data(), w, h, GDT_Float64, 0, 0)) == CE_None);
+
+    unsigned nonzero = 0;
+    for (int i = 0; i < w * h; ++i)
+    {
+        wassert(actual(tiled[i]) == direct[i]);
+        wassert(actual(blocks[i]) == direct[i]);
+        if (direct[i]) ++nonzero;
+    }
+    wassert(actual(nonzero) > 0u);
+});
+
+add_method("nonlinear", []{
+    unique_ptr<GDALDataset> strips = gdal::open_ro(TESTDATA_RSSNL);
+    unique_ptr<GDALDataset> tiles = open_tiled(TESTDATA_RSSNL);
+    const int x = 3300, y = 100, w = 412, h = 600;
+
+    vector<float> direct(w * h);
+    wassert(actual(strips->GetRasterBand(1)->RasterIO(GF_Read, x, y, w, h, direct.data(), w, h, GDT_Float32, 0, 0)) == CE_None);
+
+    vector<double> blocks(w * h);
+    wassert(actual(tiles->GetRasterBand(1)->RasterIO(GF_Read, x, y, w, h, blocks.data(), w, h, GDT_Float64, 0, 0)) == CE_None);
+
+    for (int i = 0; i < w * h; ++i)
+        wassert(actual(blocks[i]) == direct[i]);
+});
+
+// Windows east of the data of the upper HRV area, which ends at column 9073
+// in lines 2808-3007, read as nodata
+add_method("hrv_outside", []{
+    unique_ptr<GDALDataset> strips = gdal::open_ro(TESTDATA_HRV);
+    unique_ptr<GDALDataset> tiles = open_tiled(TESTDATA_HRV);
+
+    vector<uint16_t> window(500 * 100, 0xffff);
+    wassert(actual(strips->GetRasterBand(1)->RasterIO(GF_Read, 9100, 2850, 500, 100, window.data(), 500, 100, GDT_UInt16, 0, 0)) == CE_None);
+    for (auto v: window)
+        wassert(actual(v) == 0u);
+
+    // Tile 19,5 covers columns 9500-9999 and lines 2500-2999
+    vector<uint16_t> tile(500 * 500, 0xffff);
+    wassert(actual(tiles->GetRasterBand(1)->ReadBlock(19, 5, tile.data())) == CE_None);
+    for (auto v: tile)
+        wassert(actual(v) == 0u);
+});
+
+// Overviews average 2x2 boxes of valid pixels, and are the same whether
+// computed on demand or as a by-product of reading the full image
+add_method("overviews", []{
+    unique_ptr<GDALDataset> ds = gdal::open_ro(TESTDATA_RSS);
+    GDALRasterBand* rb = ds->GetRasterBand(1);
+    wassert(actual(rb->GetOverviewCount()) == 3);
+    GDALRasterBand* ovr = rb->GetOverview(0);
+    wassert(actual(ovr->GetXSize()) == 1856);
+    wassert(actual(ovr->GetYSize()) == 1856);
+    wassert(actual(rb->GetOverview(2)->GetXSize()) == 464);
+
+    const int x = 800, y = 100, w = 300, h = 200;
+    vector<uint16_t> full(w * 2 * h * 2);
+    wassert(actual(rb->RasterIO(GF_Read, x * 2, y * 2, w * 2, h * 2, full.data(), w * 2, h * 2, GDT_UInt16, 0, 0)) == CE_None);
+    vector<uint16_t> half(w * h);
+    wassert(actual(ovr->RasterIO(GF_Read, x, y, w, h, half.data(), w, h, GDT_UInt16, 0, 0)) == CE_None);
+    unsigned nonzero = 0;
+    for (int oy = 0; oy < h; ++oy)
+        for (int ox = 0; ox < w; ++ox)
+        {
+            unsigned sum = 0, count = 0;
+            for (int dy = 0; dy < 2; ++dy)
+                for (int dx = 0; dx < 2; ++dx)
+                {
+                    uint16_t v = full[(oy * 2 + dy) * w * 2 + ox * 2 + dx];
+                    if (v) { sum += v; ++count; }
+                }
+            wassert(actual(half[oy * w + ox]) == (count ? (sum + count / 2) / count : 0));
+            if (count) ++nonzero;
+        }
+    wassert(actual(nonzero) > 0u);
+
+    // Read the full image block by block, then the smallest overview, which
+    // has been filled in by the block reads
+    unique_ptr<GDALDataset> ds1 = gdal::open_ro(TESTDATA_RSS);
+    GDALRasterBand* rb1 = ds1->GetRasterBand(1);
+    vector<uint16_t> block(3712 * 464);
+    for (int yblock = 0; yblock < 8; ++yblock)
+        wassert(actual(rb1->ReadBlock(0, yblock, block.data())) == CE_None);
+    vector<uint16_t> by_product(464 * 464), on_demand(464 * 464);
+    wassert(actual(rb1->GetOverview(2)->RasterIO(GF_Read, 0, 0, 464, 464, by_product.data(), 464, 464, GDT_UInt16, 0, 0)) == CE_None);
+    wassert(actual(rb->GetOverview(2)->RasterIO(GF_Read, 0, 0, 464, 464, on_demand.data(), 464, 464, GDT_UInt16, 0, 0)) == CE_None);
+    wassert(actual(by_product == on_demand).istrue());
+});
+
+// Refreshing an incremental dataset discards the overview blocks computed
+// while segments were missing
+add_method("refresh", []{
+    const std::string dir = "gdalincrrss";
+    if (msat::sys::isdir(dir)) msat::sys::rmtree(dir);
+    msat::sys::makedirs(dir);
+    const std::string pro = "H-000-MSG2__-MSG2_RSS____-_________-PRO______-201604281230-__";
+    msat::sys::write_file(dir + "/" + pro, msat::sys::read_file(DATA_DIR "/rss/" + pro));
+    write_rss_segment(dir, 8);
+
+    CPLSetConfigOption("MSAT_XRIT_INCREMENTAL", "YES");
+    unique_ptr<GDALDataset> ds = gdal::open_ro(dir + "/H:MSG2_RSS:VIS006:201604281230");
+    CPLSetConfigOption("MSAT_XRIT_INCREMENTAL", nullptr);
+    wassert(actual(ds->GetMetadataItem(MD_MSAT_AVAILABLE_LINES, MD_DOMAIN_MSAT)) == "0-463");
+
+    // Segment 7 has lines 464-927, which are 58-115 in the smallest overview
+    GDALRasterBand* rb = ds->GetRasterBand(1);
+    GDALRasterBand* ovr = rb->GetOverview(2);
+    vector<uint16_t> block(3712 * 464);
+    wassert(actual(rb->ReadBlock(0, 1, block.data())) == CE_None);
+    for (auto v: block)
+        wassert(actual(v) == 0u);
+    vector<uint16_t> seg8(464 * 58), seg7(464 * 58);
+    wassert(actual(ovr->RasterIO(GF_Read, 0, 0, 464, 58, seg8.data(), 464, 58, GDT_UInt16, 0, 0)) == CE_None);
+    wassert(actual(ovr->RasterIO(GF_Read, 0, 58, 464, 58, seg7.data(), 464, 58, GDT_UInt16, 0, 0)) == CE_None);
+    for (auto v: seg7)
+        wassert(actual(v) == 0u);
+
+    // Once segment 7 arrives, it shows up in the band and in the overviews,
+    // with the same data as segment 8
+    write_rss_segment(dir, 7);
+    wassert(actual(ds->SetMetadataItem(MD_MSAT_REFRESH, "YES", MD_DOMAIN_MSAT)) == CE_None);
+    wassert(actual(ds->GetMetadataItem(MD_MSAT_AVAILABLE_LINES, MD_DOMAIN_MSAT)) == "0-927");
+    vector<uint16_t> block1(3712 * 464);
+    wassert(actual(rb->ReadBlock(0, 0, block.data())) == CE_None);
+    wassert(actual(rb->ReadBlock(0, 1, block1.data())) == CE_None);
+    wassert(actual(block1 == block).istrue());
+    wassert(actual(ovr->RasterIO(GF_Read, 0, 58, 464, 58, seg7.data(), 464, 58, GDT_UInt16, 0, 0)) == CE_None);
+    wassert(actual(seg7 == seg8).istrue());
+});
+
+}
+
+}
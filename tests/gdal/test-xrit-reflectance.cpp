@@ -1,5 +1,7 @@
 #include "utils.h"
+#include <msat/utils/sys.h>
 #include <cstdint>
+#include <vector>
 #include <gdal_version.h>
 
 #if GDAL_VERSION_MAJOR >= 2
@@ -224,6 +226,111 @@ add_method("new_hrv", []{
     wassert(actual(dataset->GetRasterCount()) == 1);
 });
 
+// Test computing the reflectance of several channels in one dataset
+add_method("fused", []{
+    unique_ptr<GDALDataset> datasetr = gdal::open_ro("H:MSG2:VIS006r:200807150900");
+    wassert(actual(datasetr.get() != 0).istrue());
+    unique_ptr<GDALDataset> fused = gdal::open_ro("H:MSG2:VIS006+VIS006r:200807150900");
+    wassert(actual(fused.get() != 0).istrue());
+    wassert(actual(string(GDALGetDriverShortName(fused->GetDriver()))) == "MsatXRIT");
+    wassert(actual(fused->GetRasterCount()) == 2);
+
+    // Reading the second band first computes the block of the first one too
+    float val2;
+    wassert(actual(fused->GetRasterBand(2)->RasterIO(GF_Read, 2000, 3400, 1, 1, &val2, 1, 1, GDT_Float32, 0, 0)) == CE_None);
+    wassert(actual((double)val2).almost_equal(25.9648, 3));
+    float val1;
+    wassert(actual(fused->GetRasterBand(1)->RasterIO(GF_Read, 2000, 3400, 1, 1, &val1, 1, 1, GDT_Float32, 0, 0)) == CE_None);
+    wassert(actual(val1) == val2);
+
+    // Values match the ones of the single channel dataset
+    vector<float> expected(100 * 100);
+    vector<float> actual1(100 * 100);
+    vector<float> actual2(100 * 100);
+    wassert(actual(datasetr->GetRasterBand(1)->RasterIO(GF_Read, 1950, 3350, 100, 100, expected.data(), 100, 100, GDT_Float32, 0, 0)) == CE_None);
+    wassert(actual(fused->GetRasterBand(1)->RasterIO(GF_Read, 1950, 3350, 100, 100, actual1.data(), 100, 100, GDT_Float32, 0, 0)) == CE_None);
+    wassert(actual(fused->GetRasterBand(2)->RasterIO(GF_Read, 1950, 3350, 100, 100, actual2.data(), 100, 100, GDT_Float32, 0, 0)) == CE_None);
+    wassert(actual(actual1 == expected).istrue());
+    wassert(actual(actual2 == expected).istrue());
+});
+
+// Test the mask of the pixels on the Earth disk
+add_method("disk_mask", []{
+    for (const char* name: { "H:MSG2:VIS006:200807150900", "H:MSG2:VIS006r:200807150900" })
+    {
+        unique_ptr<GDALDataset> dataset = gdal::open_ro(name);
+        wassert(actual(dataset.get() != 0).istrue());
+        GDALRasterBand* rb = dataset->GetRasterBand(1);
+        wassert(actual(rb->GetMaskFlags()) == GMF_PER_DATASET);
+        GDALRasterBand* mask = rb->GetMaskBand();
+        wassert(actual(mask->GetRasterDataType()) == GDT_Byte);
+
+        uint8_t val;
+        wassert(actual(mask->RasterIO(GF_Read, 2000, 3400, 1, 1, &val, 1, 1, GDT_Byte, 0, 0)) == CE_None);
+        wassert(actual((unsigned)val) == 255u);
+        wassert(actual(mask->RasterIO(GF_Read, 0, 3400, 1, 1, &val, 1, 1, GDT_Byte, 0, 0)) == CE_None);
+        wassert(actual((unsigned)val) == 0u);
+        wassert(actual(mask->RasterIO(GF_Read, 1856, 0, 1, 1, &val, 1, 1, GDT_Byte, 0, 0)) == CE_None);
+        wassert(actual((unsigned)val) == 0u);
+    }
+});
+
+// Test saving geolocation to a grid file
+add_method("latlon_cache", []{
+    if (msat::sys::isdir("latlon-cache"))
+        msat::sys::rmtree("latlon-cache");
+
+    CPLSetConfigOption("MSAT_LATLON_CACHE", "latlon-cache");
+    unique_ptr<GDALDataset> datasetr = gdal::open_ro("H:MSG2:VIS006r:200807150900");
+    CPLSetConfigOption("MSAT_LATLON_CACHE", nullptr);
+    wassert(actual(datasetr.get() != 0).istrue());
+
+    // Values computed from the shared grid match the ones computed directly
+    GDALRasterBand* rb = datasetr->GetRasterBand(1);
+    float valr;
+    wassert(actual(rb->RasterIO(GF_Read, 2000, 3400, 1, 1, &valr, 1, 1, GDT_Float32, 0, 0)) == CE_None);
+    wassert(actual((double)valr).almost_equal(25.9648, 3));
+
+    // The grid has been saved for other processes
+    unsigned count = 0;
+    msat::sys::Path dir("latlon-cache");
+    for (auto i = dir.begin(); i != dir.end(); ++i)
+        if (string(i->d_name).find(".latlon") != string::npos)
+            ++count;
+    wassert(actual(count) == 1u);
+});
+
+// Test serving satellite zenith angles from a grid file
+add_method("sat_za_cache", []{
+    only_on_gdal2();
+    if (msat::sys::isdir("latlon-cache"))
+        msat::sys::rmtree("latlon-cache");
+
+    CPLStringList opts(nullptr);
+    opts.SetNameValue("MSAT_COMPUTE", "sat_za");
+    CPLSetConfigOption("MSAT_LATLON_CACHE", "latlon-cache");
+    for (unsigned i = 0; i < 2; ++i)
+    {
+        // The first open writes the grid file, the second reuses the grid
+        unique_ptr<GDALDataset> dataset = gdal::open_ro("H:MSG1:IR_039:200611130800", opts);
+        wassert(actual(dataset.get() != 0).istrue());
+        GDALRasterBand* rb = dataset->GetRasterBand(1);
+        double valr;
+        wassert(actual(rb->RasterIO(GF_Read, 2000, 3400, 1, 1, &valr, 1, 1, GDT_Float64, 0, 0)) == CE_None);
+        wassert(actual((double)valr).almost_equal(1, 3));
+        wassert(actual(rb->RasterIO(GF_Read, 0, 0, 1, 1, &valr, 1, 1, GDT_Float64, 0, 0)) == CE_None);
+        wassert(actual((double)valr) == 0.0);
+    }
+    CPLSetConfigOption("MSAT_LATLON_CACHE", nullptr);
+
+    unsigned count = 0;
+    msat::sys::Path dir("latlon-cache");
+    for (auto i = dir.begin(); i != dir.end(); ++i)
+        if (string(i->d_name).find(".latlon") != string::npos)
+            ++count;
+    wassert(actual(count) == 1u);
+});
+
 }
 
 }
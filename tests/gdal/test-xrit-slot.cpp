@@ -0,0 +1,62 @@
+#include "utils.h"
+#include <cstdint>
+#include <vector>
+
+using namespace std;
+using namespace msat::tests;
+
+namespace {
+
+#define TESTDATA_SLOT "rss/H:MSG2_RSS:*:201604281230"
+
+class Tests : public TestCase
+{
+    using TestCase::TestCase;
+
+    void register_tests() override;
+} test("gdal_xrit_slot");
+
+void Tests::register_tests()
+{
+
+// All non-HRV channels found on disk become bands, in channel order
+add_method("bands", []{
+    unique_ptr<GDALDataset> ds = gdal::open_ro(TESTDATA_SLOT);
+    wassert(actual(ds->GetRasterCount()) == 2);
+    wassert(actual(ds->GetRasterXSize()) == 3712);
+    wassert(actual(ds->GetRasterYSize()) == 3712);
+    wassert(actual(ds->GetRasterBand(1)->GetDescription()) == "VIS006");
+    wassert(actual(ds->GetRasterBand(2)->GetDescription()) == "IR_039");
+    wassert(actual(ds->GetRasterBand(1)->GetRasterDataType()) == GDT_UInt16);
+    wassert(actual(ds->GetRasterBand(2)->GetRasterDataType()) == GDT_Float32);
+});
+
+// Each band reads the same data as the single channel dataset
+add_method("data", []{
+    unique_ptr<GDALDataset> slot = gdal::open_ro(TESTDATA_SLOT);
+    unique_ptr<GDALDataset> vis = gdal::open_ro("rss/H:MSG2_RSS:VIS006:201604281230");
+    unique_ptr<GDALDataset> ir = gdal::open_ro("rss/H:MSG2_RSS:IR_039:201604281230");
+    const int x = 1500, y = 100, w = 300, h = 600;
+
+    double gt_slot[6], gt_vis[6];
+    slot->GetGeoTransform(gt_slot);
+    vis->GetGeoTransform(gt_vis);
+    for (int i = 0; i < 6; ++i)
+        wassert(actual(gt_slot[i]) == gt_vis[i]);
+    wassert(actual(slot->GetProjectionRef()) == vis->GetProjectionRef());
+
+    vector<float> a(w * h), b(w * h);
+    wassert(actual(slot->GetRasterBand(1)->RasterIO(GF_Read, x, y, w, h, a.data(), w, h, GDT_Float32, 0, 0)) == CE_None);
+    wassert(actual(vis->GetRasterBand(1)->RasterIO(GF_Read, x, y, w, h, b.data(), w, h, GDT_Float32, 0, 0)) == CE_None);
+    for (int i = 0; i < w * h; ++i)
+        wassert(actual(a[i]) == b[i]);
+
+    wassert(actual(slot->GetRasterBand(2)->RasterIO(GF_Read, x, y, w, h, a.data(), w, h, GDT_Float32, 0, 0)) == CE_None);
+    wassert(actual(ir->GetRasterBand(1)->RasterIO(GF_Read, x, y, w, h, b.data(), w, h, GDT_Float32, 0, 0)) == CE_None);
+    for (int i = 0; i < w * h; ++i)
+        wassert(actual(a[i]) == b[i]);
+});
+
+}
+
+}
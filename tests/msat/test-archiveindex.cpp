@@ -0,0 +1,162 @@
+#include <msat/utils/tests.h>
+#include <msat/xrit/archiveindex.h>
+#include <msat/xrit/dataaccess.h>
+#include <msat/xrit/fileaccess.h>
+#include <msat/hrit/MSG_HRIT.h>
+#include <msat/utils/sys.h>
+#include <algorithm>
+
+using namespace msat::xrit;
+using namespace msat::tests;
+
+namespace {
+
+/// Copy the RSS test data into \a dir
+void copy_rss(const std::string& dir)
+{
+    const std::string src = DATA_DIR "/rss";
+    msat::sys::makedirs(dir);
+    msat::sys::Path srcdir(src);
+    for (auto i = srcdir.begin(); i != srcdir.end(); ++i)
+    {
+        if (i->d_name[0] == '.') continue;
+        std::string name = i->d_name;
+        msat::sys::write_file(dir + "/" + name, msat::sys::read_file(src + "/" + name));
+    }
+}
+
+class Tests : public TestCase
+{
+    using TestCase::TestCase;
+
+    void register_tests() override;
+} test("msat_archiveindex");
+
+void Tests::register_tests()
+{
+
+add_method("crawl", []() {
+    if (msat::sys::isdir("indextree")) msat::sys::rmtree("indextree");
+    copy_rss("indextree/2016/04/28");
+    msat::sys::makedirs("indextree/empty");
+    // A slot without epilogue
+    msat::sys::makedirs("indextree/noepi");
+    const std::string vis = "H-000-MSG2__-MSG2_RSS____-VIS006___-000008___-201604281230-C_";
+    const std::string pro = "H-000-MSG2__-MSG2_RSS____-_________-PRO______-201604281230-__";
+    msat::sys::write_file("indextree/noepi/" + vis, msat::sys::read_file(DATA_DIR "/rss/" + vis));
+    msat::sys::write_file("indextree/noepi/" + pro, msat::sys::read_file(DATA_DIR "/rss/" + pro));
+
+    ArchiveIndex index;
+    index.crawl("indextree", 2);
+    wassert(actual(index.directories.size()) == 6u);
+    wassert(actual(index.products.size()) == 4u);
+    wassert(actual(index.slots.size()) == 2u);
+
+    const ArchiveIndex::Product* p = index.find(FileAccess("indextree/2016/04/28/H:MSG2_RSS:VIS006:201604281230"));
+    wassert(actual(p != nullptr).istrue());
+    wassert(actual(p->spacecraft_id) == 56);
+    wassert(actual(p->channel_id) == 1);
+    wassert(actual(p->planned_end) == 8u);
+    wassert(actual(p->segments.size()) == 1u);
+    wassert(actual(p->segments[0]) == 8u);
+    wassert(actual(p->flags & ~ArchiveIndex::MISSING_SEGMENTS) == 0u);
+    wassert(actual(p->segment_names()[0]) == vis);
+
+    p = index.find(FileAccess("indextree/noepi/H:MSG2_RSS:VIS006:201604281230"));
+    wassert(actual(p != nullptr).istrue());
+    wassert(actual(p->flags & ArchiveIndex::MISSING_EPILOGUE) == (unsigned)ArchiveIndex::MISSING_EPILOGUE);
+    wassert(actual(p->flags & ArchiveIndex::MISSING_PROLOGUE) == 0u);
+
+    wassert(actual(index.find(FileAccess("indextree/2016/04/28/H:MSG2_RSS:IR_108:201604281230")) == nullptr).istrue());
+
+    // Crawling again replaces what was found before
+    msat::sys::rmtree("indextree/noepi");
+    index.crawl("indextree");
+    wassert(actual(index.products.size()) == 3u);
+    wassert(actual(index.slots.size()) == 1u);
+});
+
+add_method("write_read", []() {
+    if (msat::sys::isdir("indexrw")) msat::sys::rmtree("indexrw");
+    copy_rss("indexrw/data");
+    ArchiveIndex index;
+    index.crawl("indexrw");
+    // Segment lists are stored as ranges
+    ArchiveIndex::Product& p = index.products.begin()->second;
+    p.segments = { 1, 2, 3, 5, 7, 8 };
+    index.write("indexrw/index");
+
+    ArchiveIndex index1;
+    index1.read("indexrw/index");
+    wassert(actual(index1.directories == index.directories).istrue());
+    wassert(actual(index1.products.size()) == index.products.size());
+    wassert(actual(index1.slots.size()) == index.slots.size());
+    for (const auto& i: index.products)
+    {
+        const ArchiveIndex::Product& a = i.second;
+        const ArchiveIndex::Product& b = index1.products[i.first];
+        wassert(actual(b.directory) == a.directory);
+        wassert(actual(b.productid2) == a.productid2);
+        wassert(actual(b.channel_id) == a.channel_id);
+        wassert(actual(b.flags) == a.flags);
+        wassert(actual(b.segment_name) == a.segment_name);
+        wassert(actual(b.segments == a.segments).istrue());
+    }
+    for (const auto& i: index.slots)
+    {
+        wassert(actual(index1.slots[i.first].prologue) == i.second.prologue);
+        wassert(actual(index1.slots[i.first].epilogue) == i.second.epilogue);
+    }
+
+    // load() shares the index until the file changes
+    auto l1 = ArchiveIndex::load("indexrw/index");
+    auto l2 = ArchiveIndex::load("indexrw/index");
+    wassert(actual(l1 == l2).istrue());
+    wassert(actual(l1->products.size()) == index.products.size());
+
+    msat::sys::write_file("indexrw/broken", "msat-index 1\nP\tfoo\n");
+    ArchiveIndex broken;
+    wassert(actual_function([&] { broken.read("indexrw/broken"); }).throws("indexrw/broken:2: invalid index line"));
+});
+
+add_method("file_access", []() {
+    if (msat::sys::isdir("indexfa")) msat::sys::rmtree("indexfa");
+    copy_rss("indexfa/data");
+    std::shared_ptr<ArchiveIndex> index(new ArchiveIndex);
+    index->crawl("indexfa");
+
+    FileAccess plain("indexfa/data/H:MSG2_RSS:IR_039:201604281230");
+    FileAccess indexed(plain);
+    indexed.index = index;
+    wassert(actual(indexed.prologueFile()) == plain.prologueFile());
+    wassert(actual(indexed.epilogueFile()) == plain.epilogueFile());
+    wassert(actual(indexed.segmentFiles() == plain.segmentFiles()).istrue());
+    // Channel variants keep using the index
+    wassert(actual(FileAccess(indexed, "VIS006").index == index).istrue());
+
+    // Files are not looked up in indexed directories any more: files added
+    // later are not seen until the index is rebuilt
+    std::string seg = plain.segmentFiles()[0];
+    std::string seg7 = seg;
+    seg7[seg7.size() - 20] = '7';
+    msat::sys::write_file(seg7, msat::sys::read_file(seg));
+    wassert(actual(plain.segmentFiles().size()) == 2u);
+    wassert(actual(indexed.segmentFiles().size()) == 1u);
+    wassert(actual_function([&] { FileAccess(indexed, "IR_108").segmentFiles(); }).throws("No such file"));
+
+    // Directories not in the index are still listed
+    FileAccess other(DATA_DIR "/rss/H:MSG2_RSS:IR_039:201604281230");
+    other.index = index;
+    wassert(actual(other.segmentFiles().size()) == 1u);
+
+    // DataAccess reads through the index
+    DataAccess da;
+    MSG_header header;
+    da.scan(indexed, header);
+    wassert(actual(da.segnames.size()) == 8u);
+    wassert(actual(da.segnames[7]) == seg);
+});
+
+}
+
+}
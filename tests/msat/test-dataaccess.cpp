@@ -1,7 +1,13 @@
 #include <msat/utils/tests.h>
 #include <msat/xrit/dataaccess.h>
 #include <msat/xrit/fileaccess.h>
+#include <msat/xrit/diskcache.h>
 #include <msat/hrit/MSG_HRIT.h>
+#include <msat/utils/sys.h>
+#include <cstring>
+#include <cstdint>
+#include <thread>
+#include <atomic>
 
 using namespace msat::xrit;
 using namespace msat::tests;
@@ -15,6 +21,99 @@ namespace tut {
 #define TESTDATA_RSSNL     DATA_DIR "/rss/H:MSG2_RSS:IR_039:201604281230"
 #define TESTDATA_RSSHRV    DATA_DIR "/rss/H:MSG2_RSS:HRV:201604281230"
 
+/**
+ * Write an uncompressed copy of the RSS VIS006 test data in the directory
+ * \a dir, filling the image with samples computed from their position.
+ */
+static void make_uncompressed_rss(const std::string& dir)
+{
+    const std::string src = DATA_DIR "/rss/";
+    const std::string pro = "H-000-MSG2__-MSG2_RSS____-_________-PRO______-201604281230-__";
+    const std::string epi = "H-000-MSG2__-MSG2_RSS____-_________-EPI______-201604281230-__";
+    const std::string seg = "H-000-MSG2__-MSG2_RSS____-VIS006___-000008___-201604281230-C_";
+
+    msat::sys::makedirs(dir);
+    msat::sys::write_file(dir + "/" + pro, msat::sys::read_file(src + pro));
+    msat::sys::write_file(dir + "/" + epi, msat::sys::read_file(src + epi));
+
+    // Patch the headers to describe uncompressed 16 bit data
+    std::string data = msat::sys::read_file(src + seg);
+    unsigned char* buf = (unsigned char*)&data[0];
+    size_t header_len = (buf[4] << 24) | (buf[5] << 16) | (buf[6] << 8) | buf[7];
+    size_t columns = 0, lines = 0;
+    for (size_t pos = 0; pos < header_len; )
+    {
+        size_t rec_len = (buf[pos + 1] << 8) | buf[pos + 2];
+        if (buf[pos] == 1)
+        {
+            // Image structure: NB, NC, NL, compression flag
+            buf[pos + 3] = 16;
+            columns = (buf[pos + 4] << 8) | buf[pos + 5];
+            lines = (buf[pos + 6] << 8) | buf[pos + 7];
+            buf[pos + 8] = 0;
+        }
+        pos += rec_len;
+    }
+    uint64_t field_len = columns * lines * 16;
+    for (int i = 0; i < 8; ++i)
+        buf[8 + i] = (field_len >> (56 - i * 8)) & 0xff;
+
+    data.resize(header_len);
+    for (size_t i = 0; i < columns * lines; ++i)
+    {
+        data.push_back((i % 1021) >> 8);
+        data.push_back((i % 1021) & 0xff);
+    }
+    msat::sys::write_file(dir + "/" + seg, data);
+}
+
+/**
+ * Write in the directory \a dir a copy of the last segment of the RSS VIS006
+ * test data, numbered as segment \a segno, and return its pathname.
+ */
+static std::string write_rss_segment(const std::string& dir, unsigned segno)
+{
+    const std::string src = DATA_DIR "/rss/";
+    const std::string seg = "H-000-MSG2__-MSG2_RSS____-VIS006___-000008___-201604281230-C_";
+
+    std::string data = msat::sys::read_file(src + seg);
+    unsigned char* buf = (unsigned char*)&data[0];
+    size_t header_len = (buf[4] << 24) | (buf[5] << 16) | (buf[6] << 8) | buf[7];
+
+    // Patch the sequence number in the segment identification header
+    for (size_t pos = 0; pos < header_len; )
+    {
+        size_t rec_len = (buf[pos + 1] << 8) | buf[pos + 2];
+        if (buf[pos] == 128)
+        {
+            buf[pos + 6] = segno >> 8;
+            buf[pos + 7] = segno & 0xff;
+        }
+        pos += rec_len;
+    }
+    std::string name = seg;
+    name[41] = '0' + segno;
+    msat::sys::write_file(dir + "/" + name, data);
+    return dir + "/" + name;
+}
+
+/**
+ * Write a copy of the RSS VIS006 test data in the directory \a dir, with all
+ * 8 segments present. All segments are copies of the last one.
+ */
+static void make_full_rss(const std::string& dir)
+{
+    const std::string src = DATA_DIR "/rss/";
+    const std::string pro = "H-000-MSG2__-MSG2_RSS____-_________-PRO______-201604281230-__";
+    const std::string epi = "H-000-MSG2__-MSG2_RSS____-_________-EPI______-201604281230-__";
+
+    msat::sys::makedirs(dir);
+    msat::sys::write_file(dir + "/" + pro, msat::sys::read_file(src + pro));
+    msat::sys::write_file(dir + "/" + epi, msat::sys::read_file(src + epi));
+    for (unsigned segno = 1; segno <= 8; ++segno)
+        write_rss_segment(dir, segno);
+}
+
 class Tests : public TestCase
 {
     using TestCase::TestCase;
@@ -237,6 +336,431 @@ add_method("scan_rss_hrv", []() {
     wassert(da.line_read(0, buf));
 });
 
+add_method("preload_parallel", []() {
+    FileAccess fa(TESTDATA_RSS);
+    MSG_data pro;
+    MSG_data epi;
+    MSG_header header;
+
+    DataAccess serial;
+    serial.scan(fa, pro, epi, header);
+
+    DataAccess da;
+    da.scan(fa, pro, epi, header);
+    da.threads = 4;
+    da.preload();
+
+    // All segments are decoded and kept in cache
+    for (size_t i = 0; i < da.segnames.size(); ++i)
+        if (!da.segnames[i].empty())
+            wassert(actual(da.in_cache(i)).istrue());
+
+    // Data is the same as decoding serially
+    MSG_SAMPLE buf[3712];
+    MSG_SAMPLE buf1[3712];
+    for (size_t line = 0; line < da.lines; line += 100)
+    {
+        wassert(da.line_read(line, buf));
+        wassert(serial.line_read(line, buf1));
+        wassert(actual(memcmp(buf, buf1, sizeof(buf))) == 0);
+    }
+});
+
+add_method("preload_budget", []() {
+    make_full_rss("budgetrss");
+    FileAccess fa("budgetrss/H:MSG2_RSS:VIS006:201604281230");
+    MSG_data pro;
+    MSG_data epi;
+    MSG_header header;
+
+    DataAccess da;
+    da.scan(fa, pro, epi, header);
+    da.threads = 4;
+    size_t present = 0;
+    for (const auto& name: da.segnames)
+        if (!name.empty()) ++present;
+    wassert(actual(present) == 8u);
+
+    // Segments that do not fit in the budget are reported
+    da.segcache.set_budget(da.segment_size());
+    wassert(actual(da.preload()) == present - 1);
+    wassert(actual(da.segcache.size()) == 1u);
+
+    // With enough room, all segments are decoded
+    da.segcache.set_budget(da.segment_size() * da.segnames.size());
+    wassert(actual(da.preload()) == 0u);
+    wassert(actual(da.segcache.size()) == present);
+});
+
+add_method("mmap_uncompressed", []() {
+    make_uncompressed_rss("uncompressed");
+    FileAccess fa("uncompressed/H:MSG2_RSS:VIS006:201604281230");
+    MSG_data pro;
+    MSG_data epi;
+    MSG_header header;
+
+    DataAccess da;
+    da.scan(fa, pro, epi, header);
+    wassert(actual(da.segoffsets.size()) == 8u);
+    wassert(actual(da.segment_offset(7) != 0).istrue());
+
+    // Line 0 is the last line of the last segment, swapped horizontally
+    MSG_SAMPLE buf[3712];
+    wassert(da.line_read(0, buf));
+    for (size_t i = 0; i < 3712; ++i)
+        wassert(actual(buf[3711 - i]) == (463 * 3712 + i) % 1021);
+
+    // Nothing has been loaded in memory
+    wassert(actual(da.segcache.size()) == 0u);
+    wassert(da.preload());
+    wassert(actual(da.segcache.size()) == 0u);
+
+    // Reading without mmap gives the same results
+    DataAccess da1;
+    da1.use_mmap = false;
+    da1.scan(fa, pro, epi, header);
+    MSG_SAMPLE buf1[3712];
+    for (size_t line = 0; line < 464; line += 50)
+    {
+        wassert(da.line_read(line, buf));
+        wassert(da1.line_read(line, buf1));
+        wassert(actual(memcmp(buf, buf1, sizeof(buf))) == 0);
+        wassert(da.line_read(line, buf, 1000, 200));
+        wassert(actual(memcmp(buf, buf1 + 1000, 200 * sizeof(MSG_SAMPLE))) == 0);
+    }
+});
+
+add_method("line_read_partial", []() {
+    FileAccess fa(TESTDATA_RSS);
+    MSG_data pro;
+    MSG_data epi;
+    MSG_header header;
+    DataAccess da;
+    da.scan(fa, pro, epi, header);
+
+    MSG_SAMPLE full[3712];
+    MSG_SAMPLE part[3712];
+    wassert(da.line_read(10, full));
+
+    wassert(da.line_read(10, part, 0, 100));
+    wassert(actual(memcmp(part, full, 100 * sizeof(MSG_SAMPLE))) == 0);
+
+    wassert(da.line_read(10, part, 1000, 200));
+    wassert(actual(memcmp(part, full + 1000, 200 * sizeof(MSG_SAMPLE))) == 0);
+
+    // Reads past the end of the line are truncated
+    part[12] = 0xffff;
+    wassert(da.line_read(10, part, 3700, 100));
+    wassert(actual(memcmp(part, full + 3700, 12 * sizeof(MSG_SAMPLE))) == 0);
+    wassert(actual(part[12]) == 0xffff);
+});
+
+add_method("readahead", []() {
+    make_full_rss("fullrss");
+    FileAccess fa("fullrss/H:MSG2_RSS:VIS006:201604281230");
+    MSG_data pro;
+    MSG_data epi;
+    MSG_header header;
+
+    DataAccess da;
+    da.readahead = 2;
+    da.scan(fa, pro, epi, header);
+    wassert(actual(da.segnames.size()) == 8u);
+    for (const auto& name: da.segnames)
+        wassert(actual(name.empty()).isfalse());
+
+    // Random access does not trigger read-ahead
+    wassert(actual(da.segment(5) != nullptr).istrue());
+    wassert(actual(da.segment(2) != nullptr).istrue());
+    wassert(actual(da.in_cache(3)).isfalse());
+
+    // Reading two segments in sequence does, and the following reads are
+    // served from the cache
+    wassert(actual(da.segment(3) != nullptr).istrue());
+    wassert(actual(da.segcache.stats().hits) == 0u);
+    wassert(actual(da.segment(4) != nullptr).istrue());
+    wassert(actual(da.segment(5) != nullptr).istrue());
+    wassert(actual(da.segment(6) != nullptr).istrue());
+    wassert(actual(da.segment(7) != nullptr).istrue());
+    wassert(actual(da.segcache.stats().hits) == 4u);
+    wassert(actual(da.segcache.stats().misses) == 3u);
+
+    // Reading lines backwards reads ahead in the other direction
+    DataAccess da1;
+    da1.readahead = 1;
+    da1.scan(fa, pro, epi, header);
+    MSG_SAMPLE buf[3712];
+    for (size_t line = 0; line < da1.lines; ++line)
+        da1.line_read(line, buf);
+    wassert(actual(da1.segcache.stats().misses) == 2u);
+});
+
+add_method("concurrent_reads", []() {
+    make_full_rss("fullrss");
+    FileAccess fa("fullrss/H:MSG2_RSS:VIS006:201604281230");
+    MSG_data pro;
+    MSG_data epi;
+    MSG_header header;
+
+    // Reference image, read serially
+    DataAccess plain;
+    plain.scan(fa, pro, epi, header);
+    std::vector<MSG_SAMPLE> image(plain.lines * plain.columns);
+    for (size_t line = 0; line < plain.lines; ++line)
+        plain.line_read(line, image.data() + line * plain.columns);
+
+    // Many threads reading the same DataAccess, with a cache too small to
+    // hold what they need, so that segments get evicted while in use
+    DataAccess da;
+    da.scan(fa, pro, epi, header);
+    da.segcache.set_budget(da.segment_size() * 2);
+    std::atomic<unsigned> mismatches(0);
+    std::atomic<unsigned> errors(0);
+    std::vector<std::thread> workers;
+    for (unsigned t = 0; t < 8; ++t)
+        workers.emplace_back([&, t] {
+            std::vector<MSG_SAMPLE> buf(da.columns);
+            try {
+                for (size_t i = 0; i < da.lines; i += 7)
+                {
+                    size_t line = (i + t * da.seglines) % da.lines;
+                    da.line_read(line, buf.data());
+                    if (memcmp(buf.data(), image.data() + line * da.columns, da.columns * sizeof(MSG_SAMPLE)) != 0)
+                        ++mismatches;
+                }
+            } catch (std::exception&) {
+                ++errors;
+            }
+        });
+    for (auto& w: workers)
+        w.join();
+    wassert(actual(errors.load()) == 0u);
+    wassert(actual(mismatches.load()) == 0u);
+    wassert(actual(da.segcache.stats().evictions) > 0u);
+
+    // A segment requested by many threads at once is decoded only once
+    DataAccess da1;
+    da1.scan(fa, pro, epi, header);
+    std::vector<std::shared_ptr<MSG_data>> results(8);
+    workers.clear();
+    for (unsigned t = 0; t < 8; ++t)
+        workers.emplace_back([&, t] { results[t] = da1.segment(3); });
+    for (auto& w: workers)
+        w.join();
+    wassert(actual(da1.segcache.stats().misses) == 1u);
+    for (const auto& r: results)
+        wassert(actual(r == results[0]).istrue());
+
+    // Segments stay valid after eviction, as long as they are held
+    da1.segcache.set_budget(da1.segment_size());
+    std::shared_ptr<MSG_data> held = da1.segment(3);
+    std::shared_ptr<MSG_data> other = da1.segment(4);
+    wassert(actual(da1.in_cache(3)).isfalse());
+    std::shared_ptr<MSG_data> reference = plain.segment(3);
+    wassert(actual(memcmp(held->image->data, reference->image->data, da1.npixperseg * sizeof(MSG_SAMPLE))) == 0);
+});
+
+add_method("disk_cache", []() {
+    if (msat::sys::isdir("diskcache-da")) msat::sys::rmtree("diskcache-da");
+    FileAccess fa(TESTDATA_RSS);
+    MSG_data pro;
+    MSG_data epi;
+    MSG_header header;
+
+    DataAccess plain;
+    plain.scan(fa, pro, epi, header);
+
+    // The first reader decodes the segment and stores it in the disk cache
+    DataAccess da;
+    da.diskcache.reset(new DiskCache("diskcache-da"));
+    da.scan(fa, pro, epi, header);
+    wassert(actual(da.segment_offset(7)) == 0u);
+    wassert(actual(da.cachednames[7].empty()).istrue());
+    MSG_SAMPLE buf[3712];
+    MSG_SAMPLE buf1[3712];
+    wassert(da.line_read(0, buf));
+    wassert(actual(da.diskcache->stats().stores) == 1u);
+
+    // The next one reads it via mmap from the disk cache
+    DataAccess da1;
+    da1.diskcache.reset(new DiskCache("diskcache-da"));
+    da1.scan(fa, pro, epi, header);
+    wassert(actual(da1.segment_offset(7)) > 0u);
+    wassert(actual(da1.cachednames[7].empty()).isfalse());
+    for (size_t line = 0; line < da1.lines; line += 50)
+    {
+        wassert(da1.line_read(line, buf));
+        wassert(plain.line_read(line, buf1));
+        wassert(actual(memcmp(buf, buf1, sizeof(buf))) == 0);
+    }
+    wassert(actual(da1.in_cache(7)).isfalse());
+    wassert(actual(da1.diskcache->stats().stores) == 0u);
+
+    // Loading the whole segment also uses the disk cache
+    std::shared_ptr<MSG_data> d = da1.segment(7);
+    std::shared_ptr<MSG_data> d1 = plain.segment(7);
+    wassert(actual(memcmp(d->image->data, d1->image->data, da1.npixperseg * sizeof(MSG_SAMPLE))) == 0);
+    wassert(actual(da1.diskcache->stats().stores) == 0u);
+
+    // If the entry disappears, the segment is decoded again
+    DataAccess da2;
+    da2.diskcache.reset(new DiskCache("diskcache-da"));
+    da2.scan(fa, pro, epi, header);
+    wassert(actual(da2.segment_offset(7)) > 0u);
+    msat::sys::unlink(da2.cachednames[7]);
+    wassert(da2.line_read(0, buf));
+    wassert(plain.line_read(0, buf1));
+    wassert(actual(memcmp(buf, buf1, sizeof(buf))) == 0);
+    wassert(actual(da2.cachednames[7].empty()).istrue());
+});
+
+add_method("lazy_scan", []() {
+    make_full_rss("lazyrss");
+    FileAccess fa("lazyrss/H:MSG2_RSS:VIS006:201604281230");
+    MSG_data pro;
+    MSG_data epi;
+    MSG_header header;
+
+    DataAccess da;
+    da.scan(fa, pro, epi, header);
+    wassert(actual(da.segnames.size()) == 8u);
+    wassert(actual(da.lines) == 8u * da.seglines);
+
+    // Only one segment header has been read
+    size_t unscanned = 0;
+    for (size_t i = 0; i < da.segoffsets.size(); ++i)
+        if (da.segoffsets[i] == DataAccess::unscanned)
+            ++unscanned;
+    wassert(actual(unscanned) >= 7u);
+
+    // Remove segment 3: reading lines that are in other segments still works,
+    // because its file is never opened
+    msat::sys::unlink(da.segnames[2]);
+    MSG_SAMPLE buf[3712];
+    for (size_t line = 0; line < da.seglines * 2; ++line)
+        wassert(da.line_read(line, buf));
+    wassert(actual(da.segoffsets[2]) == DataAccess::unscanned);
+    wassert(actual(da.segoffsets[7]) == 0u);
+
+    size_t segnum, segline;
+    da.line_segment(da.lines - da.seglines * 3, segnum, segline);
+    wassert(actual(segnum) == 2u);
+    wassert(actual_function([&] { da.line_read(da.lines - da.seglines * 3, buf); }).throws("cannot open"));
+});
+
+add_method("reduced_line_read", []() {
+    FileAccess fa(TESTDATA_RSS);
+    MSG_data pro;
+    MSG_data epi;
+    MSG_header header;
+    DataAccess da;
+    da.scan(fa, pro, epi, header);
+
+    // Lines 0-463 are in the only segment present
+    const size_t factor = 4, line = 30;
+    std::vector<MSG_SAMPLE> reduced(da.image_width() / factor + 1, 0xaaaa);
+    da.reduced_line_read(factor, line, reduced.data());
+    wassert(actual(reduced[da.image_width() / factor]) == 0xaaaa);
+
+    std::vector<MSG_SAMPLE> src(da.image_width() * factor);
+    for (size_t i = 0; i < factor; ++i)
+        da.line_read(line * factor + i, src.data() + i * da.image_width());
+    unsigned nonzero = 0;
+    for (size_t x = 0; x < da.image_width() / factor; ++x)
+    {
+        unsigned sum = 0, count = 0;
+        for (size_t y = 0; y < factor; ++y)
+            for (size_t i = 0; i < factor; ++i)
+                if (MSG_SAMPLE v = src[y * da.image_width() + x * factor + i])
+                {
+                    sum += v;
+                    ++count;
+                }
+        wassert(actual(reduced[x]) == (count ? (sum + count / 2) / count : 0u));
+        if (count) ++nonzero;
+    }
+    wassert(actual(nonzero) > 0u);
+
+    // Lines of missing segments and past the end of the image are zeros
+    da.reduced_line_read(factor, 500, reduced.data());
+    wassert(actual(reduced[10]) == 0u);
+    da.reduced_line_read(factor, da.lines / factor + 3, reduced.data());
+    wassert(actual(reduced[10]) == 0u);
+});
+
+add_method("validate_segment", []() {
+    make_full_rss("validrss");
+    FileAccess fa("validrss/H:MSG2_RSS:VIS006:201604281230");
+    MSG_data pro;
+    MSG_data epi;
+    MSG_header header;
+
+    DataAccess da;
+    da.scan(fa, pro, epi, header);
+
+    // Give segment 5 the contents of segment 3: the mismatch is only noticed
+    // when segment 5 is accessed
+    msat::sys::write_file(da.segnames[4], msat::sys::read_file(da.segnames[2]));
+    wassert(actual(da.segoffsets[4]) == DataAccess::unscanned);
+    wassert(actual_function([&] { da.segment_offset(4); }).throws("sequence number 3 instead of 5"));
+    da.segment_offset(3);
+    wassert(actual(da.segoffsets[3]) != DataAccess::unscanned);
+});
+
+add_method("incremental", []() {
+    // A repeat cycle being received: prologue and the first segment to
+    // arrive, which is the northernmost one
+    const std::string dir = "incrrss";
+    if (msat::sys::isdir(dir)) msat::sys::rmtree(dir);
+    msat::sys::makedirs(dir);
+    const std::string pro = "H-000-MSG2__-MSG2_RSS____-_________-PRO______-201604281230-__";
+    msat::sys::write_file(dir + "/" + pro, msat::sys::read_file(DATA_DIR "/rss/" + pro));
+    write_rss_segment(dir, 8);
+
+    FileAccess fa(dir + "/H:MSG2_RSS:VIS006:201604281230");
+    MSG_data pro_data;
+    MSG_data epi_data;
+    MSG_header header;
+
+    // Without incremental mode, the epilogue is required
+    DataAccess da0;
+    wassert(actual_function([&] { da0.scan(fa, pro_data, epi_data, header); }).throws("No such file"));
+
+    DataAccess da;
+    da.incremental = true;
+    da.scan(fa, pro_data, epi_data, header);
+    wassert(actual(epi_data.epilogue == nullptr).istrue());
+    wassert(actual(da.lines) == 8u * da.seglines);
+
+    size_t seg7_line = da.seglines;
+    wassert(actual(da.line_available(0)).istrue());
+    wassert(actual(da.line_available(seg7_line)).isfalse());
+    MSG_SAMPLE buf[3712];
+    da.line_read(seg7_line, buf);
+    for (size_t i = 0; i < da.columns; ++i)
+        wassert(actual(buf[i]) == 0u);
+
+    // Nothing new
+    wassert(actual(da.refresh(fa)) == 0u);
+
+    // A segment still being written is not picked up
+    std::string seg7 = write_rss_segment(dir, 7);
+    std::string data = msat::sys::read_file(seg7);
+    msat::sys::unlink(seg7);
+    msat::sys::write_file(seg7, data.substr(0, data.size() / 2));
+    wassert(actual(da.refresh(fa)) == 0u);
+    wassert(actual(da.line_available(seg7_line)).isfalse());
+
+    // Once complete, it is
+    msat::sys::write_file(seg7, data);
+    wassert(actual(da.refresh(fa)) == 1u);
+    wassert(actual(da.line_available(seg7_line)).istrue());
+    MSG_SAMPLE buf1[3712];
+    da.line_read(seg7_line, buf);
+    da.line_read(0, buf1);
+    wassert(actual(memcmp(buf, buf1, da.columns * sizeof(MSG_SAMPLE))) == 0);
+});
+
 }
 
 }
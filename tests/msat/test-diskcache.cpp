@@ -0,0 +1,111 @@
+#include <msat/utils/tests.h>
+#include <msat/xrit/diskcache.h>
+#include <msat/utils/sys.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <vector>
+#include <cstring>
+
+using namespace msat::xrit;
+using namespace msat::tests;
+
+namespace {
+
+/// Create a fake segment file and return its pathname
+std::string make_segment(const std::string& name, const std::string& contents)
+{
+    msat::sys::makedirs("diskcache-segs");
+    std::string pathname = "diskcache-segs/" + name;
+    msat::sys::write_file(pathname, contents);
+    return pathname;
+}
+
+class Tests : public TestCase
+{
+    using TestCase::TestCase;
+
+    void register_tests() override;
+} test("msat_diskcache");
+
+void Tests::register_tests()
+{
+
+add_method("store_lookup", []() {
+    if (msat::sys::isdir("diskcache-store")) msat::sys::rmtree("diskcache-store");
+    DiskCache cache("diskcache-store");
+    std::string seg = make_segment("store", "segment data");
+
+    std::vector<MSG_SAMPLE> samples(1000);
+    for (size_t i = 0; i < samples.size(); ++i)
+        samples[i] = i * 3;
+
+    std::string entry;
+    wassert(actual(cache.lookup(seg, samples.size(), entry)) == 0u);
+    cache.store(seg, samples.data(), samples.size());
+
+    size_t ofs = cache.lookup(seg, samples.size(), entry);
+    wassert(actual(ofs) > 0u);
+    wassert(actual(ofs % 8) == 0u);
+    wassert(actual(msat::sys::size(entry)) == ofs + samples.size() * 2);
+
+    // Samples are stored big endian
+    std::string data = msat::sys::read_file(entry);
+    const unsigned char* buf = (const unsigned char*)data.data() + ofs;
+    for (size_t i = 0; i < samples.size(); ++i)
+        wassert(actual((buf[i * 2] << 8) | buf[i * 2 + 1]) == samples[i]);
+
+    // A different sample count does not match
+    std::string entry1;
+    wassert(actual(cache.lookup(seg, samples.size() + 1, entry1)) == 0u);
+
+    wassert(actual(cache.stats().hits) == 1u);
+    wassert(actual(cache.stats().misses) == 2u);
+    wassert(actual(cache.stats().stores) == 1u);
+});
+
+add_method("changed_segment", []() {
+    if (msat::sys::isdir("diskcache-changed")) msat::sys::rmtree("diskcache-changed");
+    DiskCache cache("diskcache-changed");
+    std::string seg = make_segment("changed", "segment data");
+
+    std::vector<MSG_SAMPLE> samples(100, 42);
+    cache.store(seg, samples.data(), samples.size());
+    std::string entry;
+    wassert(actual(cache.lookup(seg, samples.size(), entry)) > 0u);
+
+    // Rewriting the segment file invalidates the entry
+    make_segment("changed", "other segment data");
+    wassert(actual(cache.lookup(seg, samples.size(), entry)) == 0u);
+});
+
+add_method("trim", []() {
+    if (msat::sys::isdir("diskcache-trim")) msat::sys::rmtree("diskcache-trim");
+    std::vector<MSG_SAMPLE> samples(1000, 1);
+    // Room for two entries, but not for three
+    DiskCache cache("diskcache-trim", 5000);
+
+    std::string seg0 = make_segment("trim0", "0");
+    std::string seg1 = make_segment("trim1", "1");
+    std::string seg2 = make_segment("trim2", "2");
+    cache.store(seg0, samples.data(), samples.size());
+    cache.store(seg1, samples.data(), samples.size());
+
+    // Make seg0 older than seg1, then use it so that seg1 is the least
+    // recently used
+    std::string entry0, entry1;
+    wassert(actual(cache.lookup(seg1, samples.size(), entry1)) > 0u);
+    struct timespec old[2] = { { 1000, 0 }, { 1000, 0 } };
+    utimensat(AT_FDCWD, entry1.c_str(), old, 0);
+    wassert(actual(cache.lookup(seg0, samples.size(), entry0)) > 0u);
+
+    cache.store(seg2, samples.data(), samples.size());
+    std::string entry;
+    wassert(actual(cache.lookup(seg0, samples.size(), entry)) > 0u);
+    wassert(actual(cache.lookup(seg1, samples.size(), entry)) == 0u);
+    wassert(actual(cache.lookup(seg2, samples.size(), entry)) > 0u);
+    wassert(actual(cache.stats().evictions) == 1u);
+});
+
+}
+
+}
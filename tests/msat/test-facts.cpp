@@ -1,5 +1,6 @@
 #include <msat/utils/tests.h>
 #include <msat/facts.h>
+#include <vector>
 #include <math.h>
 
 using namespace msat;
@@ -179,6 +180,90 @@ add_method("cos_sol_za", []() {
     wassert(actual(facts::cos_sol_za(2013, 3, 21, 6, 0, -80, 90)).almost_equal(0.17, 1));
 });
 
+// Test computing the solar zenith angle of many points at once
+add_method("cos_sol_za_batch", []() {
+    int jday = facts::jday(2013, 3, 21);
+    facts::SolarPosition sun(jday, 6.5);
+
+    std::vector<double> lats, lons;
+    for (int lat = -90; lat <= 90; lat += 5)
+        for (int lon = -180; lon <= 180; lon += 7)
+        {
+            lats.push_back(lat);
+            lons.push_back(lon);
+        }
+
+    std::vector<double> res(lats.size());
+    sun.cos_sol_za(lats.size(), lats.data(), lons.data(), res.data());
+    for (size_t i = 0; i < lats.size(); ++i)
+    {
+        wassert(actual(sun.cos_sol_za(lats[i], lons[i])) == facts::cos_sol_za(jday, 6.5, lats[i], lons[i]));
+        wassert(actual(res[i]).almost_equal(facts::cos_sol_za(jday, 6.5, lats[i], lons[i]), 12));
+    }
+
+    // Output can overwrite the input
+    sun.cos_sol_za(lats.size(), lats.data(), lons.data(), lats.data());
+    wassert(actual(lats[100]).almost_equal(res[100], 12));
+});
+
+// Test the IR 3.9 reflectance against the literal formulas of MMKM2010 and
+// MSGProc
+add_method("ir039_reflectance", []() {
+    auto reference = [](int jday, double BT039, double BT108, double BT134, double cosTETA, double SAT) {
+        const double c1 = 0.0000119104;
+        const double c2 = 1.43877;
+        const double Vc = 2569.094;
+        const double A = 0.9959;
+        const double B = 3.471;
+        double esd = 1.0 - 0.0167 * cos( 2.0 * M_PI * (jday - 3) / 365.0);
+        BT039 = pow(pow(BT039, 4)
+                  + pow(BT108, 4)
+                  - pow(BT108 - (BT108 - BT134)/4, 4),
+                  0.25);
+        double R_tot = c1 * (Vc*Vc*Vc) / (exp(c2 * Vc / (A * BT039 + B)) - 1) + 0.015;
+        double R39_corr = pow((BT108 - 0.25 * (BT108 - BT134)) / BT108, 4);
+        double R_therm = c1 * (Vc*Vc*Vc) / (exp(c2 * Vc / (A * BT108 + B)) - 1) * R39_corr;
+        if (cosTETA < 0.173648178) cosTETA = 0.173648178;
+        double TOARAD = 4.92 / (esd*esd)
+                      * pow(cosTETA, 0.75)
+                      * exp(-(1-R39_corr) * cosTETA)
+                      * exp(-(1-R39_corr) / cos(SAT));
+        if (R_tot <= R_therm) R_tot = R_therm + 0.0000001;
+        if (TOARAD <= R_therm) TOARAD = R_therm + 0.0000001;
+        double REFL = 100 * (R_tot - R_therm) / (TOARAD);
+        if (!(REFL > 0.0)) REFL = 0.0;
+        if (REFL > 100.0) REFL = 100.0;
+        return REFL;
+    };
+
+    // Deterministic pseudorandom samples over the range of MSG data
+    unsigned long long state = 1;
+    auto uniform = [&](double min, double max) {
+        state = state * 6364136223846793005ull + 1442695040888963407ull;
+        return min + (max - min) * (state >> 11) / 9007199254740992.0;
+    };
+
+    unsigned computed = 0;
+    for (int jday = 1; jday <= 365; jday += 30)
+    {
+        facts::IR039Reflectance ir039(jday);
+        for (unsigned i = 0; i < 20000; ++i)
+        {
+            double bt039 = uniform(200, 340);
+            double bt108 = uniform(190, 320);
+            double bt134 = uniform(190, bt108);
+            double cossza = uniform(-0.2, 1);
+            double sat_za = uniform(0, 1.4);
+            double expected = reference(jday, bt039, bt108, bt134, cossza, sat_za);
+            double res = ir039.reflectance(bt039, bt108, bt134, cossza, sat_za);
+            wassert(actual(fabs(res - expected)) < 1e-9);
+            if (expected > 0.0 && expected < 100.0) ++computed;
+        }
+    }
+    // Most samples are not clamped
+    wassert(actual(computed) > 100000u);
+});
+
 }
 
 }
@@ -55,6 +55,15 @@ add_method("segments", []() {
     wassert(actual(fa.timing) == "200611130800");
 });
 
+// Test extracting segment numbers from segment filenames
+add_method("segment_number", []() {
+    wassert(actual(xrit::segmentNumber("/foo/bar/H-000-MSG1__-MSG1________-IR_039___-000001___-200611130800-C_")) == 1);
+    wassert(actual(xrit::segmentNumber("H-000-MSG2__-MSG2_RSS____-VIS006___-000008___-201604281230-C_")) == 8);
+    wassert(actual(xrit::segmentNumber("H-000-MSG1__-MSG1________-HRV______-000018___-200611141200-C_")) == 18);
+    wassert(actual(xrit::segmentNumber("/foo-bar/H:MSG1:HRV:200611141200")) == -1);
+    wassert(actual(xrit::segmentNumber("H-000-MSG1__-MSG1________-_________-PRO______-200611141200-__")) == -1);
+});
+
 // Test parser with alternate channel
 add_method("altchannel", []() {
     xrit::FileAccess fa1;
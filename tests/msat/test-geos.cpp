@@ -0,0 +1,127 @@
+#include <msat/utils/tests.h>
+#include <msat/utils/geos.h>
+#include <vector>
+#include <cmath>
+
+using namespace msat::utils;
+using namespace msat::tests;
+
+namespace {
+
+/// Size of a SEVIRI full resolution pixel in projected coordinates
+const double pixel_size = 3000.403165817;
+
+class Tests : public TestCase
+{
+    using TestCase::TestCase;
+
+    void register_tests() override;
+} test("msat_geos");
+
+void Tests::register_tests()
+{
+
+add_method("sub_satellite_point", []() {
+    GeosProjection p(9.5);
+    double x = 0, y = 0, lat, lon;
+    wassert(actual(p.to_latlon(1, &x, &y, &lat, &lon)) == 1u);
+    wassert(actual(lat).almost_equal(0, 9));
+    wassert(actual(lon).almost_equal(9.5, 9));
+
+    wassert(actual(p.from_latlon(1, &lat, &lon, &x, &y)) == 1u);
+    wassert(actual(x).almost_equal(0, 6));
+    wassert(actual(y).almost_equal(0, 6));
+});
+
+add_method("known_points", []() {
+    // Reference values computed with the formulas of section 4.4.3.2 of the
+    // CGMS LRIT/HRIT Global Specification
+    GeosProjection p(9.5);
+    double x = 1000 * pixel_size, y = -500 * pixel_size, lat, lon;
+    wassert(actual(p.to_latlon(1, &x, &y, &lat, &lon)) == 1u);
+    wassert(actual(lat).almost_equal(-14.1534664093, 8));
+    wassert(actual(lon).almost_equal(39.5041069234, 8));
+
+    lat = 44.5; lon = 11.3;
+    wassert(actual(p.from_latlon(1, &lat, &lon, &x, &y)) == 1u);
+    wassert(actual(x).almost_equal(136191.686466, 4));
+    wassert(actual(y).almost_equal(4212442.293721, 4));
+});
+
+add_method("off_disk", []() {
+    GeosProjection p(0);
+
+    // Corners of the full disk image are in space
+    double x[] = { -1856 * pixel_size, 1856 * pixel_size, 0 };
+    double y[] = { 1856 * pixel_size, -1856 * pixel_size, 0 };
+    double lat[3], lon[3];
+    wassert(actual(p.to_latlon(3, x, y, lat, lon)) == 1u);
+    wassert(actual(std::isnan(lat[0])).istrue());
+    wassert(actual(std::isnan(lon[1])).istrue());
+    wassert(actual(std::isnan(lat[2])).isfalse());
+
+    // Points behind the Earth are not visible
+    double plat[] = { 0, 45, 0 };
+    double plon[] = { 100, -10, 180 };
+    wassert(actual(p.from_latlon(3, plat, plon, x, y)) == 1u);
+    wassert(actual(std::isnan(x[0])).istrue());
+    wassert(actual(std::isnan(y[1])).isfalse());
+    wassert(actual(std::isnan(y[2])).istrue());
+});
+
+add_method("round_trip", []() {
+    GeosProjection p(-3.4);
+    const double gt[6] = { -1856 * pixel_size, pixel_size, 0, 1856 * pixel_size, 0, -pixel_size };
+    std::vector<double> lat(3712), lon(3712);
+    for (int line = 0; line < 3712; line += 97)
+    {
+        size_t on_disk = p.pixels_to_latlon(gt, 0, line, 3712, lat.data(), lon.data());
+        std::vector<double> x(3712), y(3712);
+        wassert(actual(p.from_latlon(3712, lat.data(), lon.data(), x.data(), y.data())) == on_disk);
+        for (int col = 0; col < 3712; ++col)
+        {
+            if (std::isnan(lat[col])) continue;
+            wassert(actual(x[col]).almost_equal(gt[0] + gt[1] * col, 3));
+            wassert(actual(y[col]).almost_equal(gt[3] + gt[5] * line, 3));
+        }
+    }
+});
+
+add_method("line_span", []() {
+    GeosProjection p(0);
+    const double gt[6] = { -1856 * pixel_size, pixel_size, 0, 1856 * pixel_size, 0, -pixel_size };
+    std::vector<double> lat(3712), lon(3712);
+    unsigned empty = 0;
+    for (int line = 0; line < 3712; ++line)
+    {
+        int begin, end;
+        p.line_span(gt, line, 3712, begin, end);
+        if (begin == end) ++empty;
+
+        // Spans contain exactly the pixels on the disk
+        size_t on_disk = p.pixels_to_latlon(gt, 0, line, 3712, lat.data(), lon.data());
+        wassert(actual((size_t)(end - begin)) == on_disk);
+        for (int col = begin; col < end; ++col)
+            wassert(actual(std::isnan(lat[col])).isfalse());
+    }
+    // Only a few lines at the top and bottom miss the disk
+    wassert(actual(empty) > 0u);
+    wassert(actual(empty) < 200u);
+
+    // Spans are clipped to the raster
+    const double gt_half[6] = { 0, pixel_size, 0, 1856 * pixel_size, 0, -pixel_size };
+    int begin, end;
+    p.line_span(gt_half, 1856, 1000, begin, end);
+    wassert(actual(begin) == 0);
+    wassert(actual(end) == 1000);
+    p.line_span(gt_half, 1856, 3712, begin, end);
+    wassert(actual(begin) == 0);
+    wassert(actual(end) == 1812);
+    p.line_span(gt_half, 0, 1000, begin, end);
+    wassert(actual(begin) == 0);
+    wassert(actual(end) == 0);
+});
+
+}
+
+}
@@ -0,0 +1,152 @@
+#include <msat/utils/tests.h>
+#include <msat/hrit/MSG_HRIT.h>
+#include <msat/utils/sys.h>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <atomic>
+#include <vector>
+
+using namespace msat;
+using namespace msat::tests;
+
+namespace {
+
+const char* testfiles[] = {
+    DATA_DIR "/H-000-MSG1__-MSG1________-HRV______-000018___-200611141200-C_",
+    DATA_DIR "/H-000-MSG1__-MSG1________-IR_039___-000001___-200611130800-C_",
+    DATA_DIR "/H-000-MSG1__-MSG1________-_________-PRO______-200611130800-__",
+    DATA_DIR "/H-000-MSG1__-MSG1________-_________-EPI______-200611130800-__",
+    DATA_DIR "/H-000-MSG2__-MSG2________-IR_108___-000008___-201001191200-C_",
+    DATA_DIR "/H-000-MSG2__-MSG2________-VIS006___-000001___-200807150900-C_",
+    DATA_DIR "/H-000-MSG2__-MSG2________-_________-PRO______-200807150900-__",
+    DATA_DIR "/rss/H-000-MSG2__-MSG2_RSS____-HRV______-000024___-201604281230-C_",
+    DATA_DIR "/rss/H-000-MSG2__-MSG2_RSS____-IR_039___-000008___-201604281230-C_",
+    DATA_DIR "/rss/H-000-MSG2__-MSG2_RSS____-_________-PRO______-201604281230-__",
+    DATA_DIR "/rss/H-000-MSG2__-MSG2_RSS____-_________-EPI______-201604281230-__",
+};
+
+/// Decode a file and summarize its contents in a string
+std::string decode(const std::string& pathname)
+{
+    std::ifstream in(pathname.c_str(), std::ios::binary | std::ios::in);
+    if (in.fail()) throw std::runtime_error(pathname + ": cannot open");
+    MSG_header header;
+    MSG_data data;
+    header.read_from(in);
+    data.read_from(in, header);
+
+    std::stringstream res;
+    res << header.f_typecode << " " << header.total_header_length;
+    if (header.segment_id)
+        res << " " << header.segment_id->sequence_number;
+    if (data.image)
+    {
+        uint64_t sum = 0;
+        for (size_t i = 0; i < data.image->len; ++i)
+            sum += data.image->data[i];
+        res << " " << sum;
+    }
+    if (data.prologue)
+        res << " " << data.prologue->image_acquisition.PlannedAquisitionTime.TrueRepeatCycleStart.get_timestring();
+    if (data.epilogue)
+        res << " " << data.epilogue->product_stats.ActualScanningSummary.ForwardScanStart.get_timestring();
+    return res.str();
+}
+
+class Tests : public TestCase
+{
+    using TestCase::TestCase;
+
+    void register_tests() override;
+} test("msat_hrit");
+
+void Tests::register_tests()
+{
+
+add_method("machine", []() {
+    const unsigned char buf[] = { 0xbf, 0xc0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01 };
+    wassert(actual(get_ui1(buf)) == 0xbf);
+    wassert(actual(get_ui2(buf)) == 0xbfc0);
+    wassert(actual(get_ui4(buf)) == 0xbfc00000u);
+    wassert(actual(get_ui8(buf)) == 0xbfc0000000000001ull);
+    wassert(actual(get_i2(buf)) == (short)0xbfc0);
+    wassert(actual(get_i4(buf + 4)) == 1);
+    wassert(actual(get_r4(buf)) == -1.5f);
+
+    // Unaligned access
+    const unsigned char dbl[] = { 0, 0x3f, 0xb9, 0x99, 0x99, 0x99, 0x99, 0x99, 0x9a };
+    wassert(actual(get_r8(dbl + 1)) == 0.1);
+});
+
+add_method("time", []() {
+    // 2016-04-28 12:30:00 UTC, 21302 days after 1958-01-01
+    const unsigned char buf[] = { 0x53, 0x36, 0x02, 0xae, 0xa5, 0x40 };
+    MSG_time_cds_short t(buf);
+    wassert(actual(t.get_unixtime()) == 1461846600);
+    struct tm tmtime = t.get_timestruct();
+    wassert(actual(tmtime.tm_year) == 116);
+    wassert(actual(tmtime.tm_mon) == 3);
+    wassert(actual(tmtime.tm_mday) == 28);
+    wassert(actual(tmtime.tm_hour) == 12);
+    wassert(actual(tmtime.tm_min) == 30);
+    wassert(actual(t.get_timestring()) == "2016-04-28 12:30:00 +000 msecs");
+
+    MSG_time_generalized g((const unsigned char*)"20160428123000Z");
+    wassert(actual(g.get_unixtime()) == 1461846600);
+    wassert(actual(g.get_timestruct().tm_mday) == 28);
+});
+
+add_method("errors", []() {
+    // Malformed files raise exceptions instead of aborting
+    sys::write_file("hrit-truncated", std::string("\0\0\x10\0\0", 5));
+    wassert(actual_function([] { decode("hrit-truncated"); }).throws("Primary Header"));
+
+    std::string notprimary(16, '\0');
+    notprimary[0] = 5;
+    sys::write_file("hrit-notprimary", notprimary);
+    wassert(actual_function([] { decode("hrit-notprimary"); }).throws("not primary"));
+
+    // A header that claims more records than there are
+    std::string primary("\0\0\x10\0\0\0\0\x20\0\0\0\0\0\0\0\0", 16);
+    sys::write_file("hrit-shortheader", primary);
+    wassert(actual_function([] { decode("hrit-shortheader"); }).throws("Header body"));
+
+    std::string badrecord = primary + std::string("\x01\0\x30", 3) + std::string(13, '\0');
+    sys::write_file("hrit-badrecord", badrecord);
+    wassert(actual_function([] { decode("hrit-badrecord"); }).throws("Truncated header record"));
+});
+
+add_method("concurrent", []() {
+    std::vector<std::string> expected;
+    for (const auto& f: testfiles)
+        expected.push_back(decode(f));
+
+    // Decode all the files from several threads at the same time
+    std::atomic<unsigned> mismatches(0);
+    std::atomic<unsigned> errors(0);
+    std::vector<std::thread> workers;
+    for (unsigned t = 0; t < 8; ++t)
+        workers.emplace_back([&, t] {
+            const size_t count = sizeof(testfiles) / sizeof(testfiles[0]);
+            try {
+                for (unsigned round = 0; round < 3; ++round)
+                    for (size_t i = 0; i < count; ++i)
+                    {
+                        size_t idx = (i + t) % count;
+                        if (decode(testfiles[idx]) != expected[idx])
+                            ++mismatches;
+                    }
+            } catch (std::exception&) {
+                ++errors;
+            }
+        });
+    for (auto& w: workers)
+        w.join();
+    wassert(actual(errors.load()) == 0u);
+    wassert(actual(mismatches.load()) == 0u);
+});
+
+}
+
+}
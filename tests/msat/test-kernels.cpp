@@ -0,0 +1,120 @@
+#include <msat/utils/tests.h>
+#include <msat/utils/kernels.h>
+#include <vector>
+#include <cmath>
+
+using namespace msat::utils::kernels;
+using namespace msat::tests;
+
+namespace {
+
+/// Instruction sets supported by this CPU
+std::vector<ISA> supported_isas()
+{
+    std::vector<ISA> res { ISA::SCALAR };
+    if (best_isa() >= ISA::SSE2) res.push_back(ISA::SSE2);
+    if (best_isa() >= ISA::AVX2) res.push_back(ISA::AVX2);
+    return res;
+}
+
+class Tests : public TestCase
+{
+    using TestCase::TestCase;
+
+    void register_tests() override;
+} test("msat_kernels");
+
+void Tests::register_tests()
+{
+
+add_method("copy_u16", []() {
+    std::vector<uint16_t> src(3712 + 37);
+    for (size_t i = 0; i < src.size(); ++i)
+        src[i] = i * 2654435761u;
+
+    // Try lengths that exercise both vector bodies and scalar tails
+    for (size_t n: { 0, 1, 7, 8, 9, 15, 16, 17, 33, 3712 })
+        for (int flags = 0; flags < 4; ++flags)
+        {
+            bool reverse = flags & 1;
+            bool bswap = flags & 2;
+            std::vector<uint16_t> expected(n + 1, 0xaaaa);
+            for (size_t i = 0; i < n; ++i)
+            {
+                uint16_t v = src[i];
+                if (bswap) v = (v << 8) | (v >> 8);
+                expected[reverse ? n - i - 1 : i] = v;
+            }
+
+            for (ISA isa: supported_isas())
+            {
+                std::vector<uint16_t> dst(n + 1, 0xaaaa);
+                copy_u16(isa, src.data(), n, dst.data(), reverse, bswap);
+                wassert(actual(dst == expected).istrue());
+            }
+        }
+});
+
+add_method("calibrate", []() {
+    std::vector<float> lut(1024);
+    for (size_t i = 0; i < lut.size(); ++i)
+        lut[i] = (float)i * 0.5f - 10.0f;
+    lut[100] = NAN;
+    lut[101] = -INFINITY;
+
+    std::vector<uint16_t> src(3712);
+    for (size_t i = 0; i < src.size(); ++i)
+        src[i] = (i * 7) % 1024;
+
+    for (size_t n: { 0, 1, 7, 8, 9, 3712 })
+    {
+        const size_t lead = 3, trail = 5;
+        std::vector<float> expected(lead + n + trail + 1, 42.0f);
+        for (size_t i = 0; i < lead; ++i) expected[i] = 0;
+        for (size_t i = 0; i < n; ++i)
+        {
+            float v = lut[src[i]];
+            expected[lead + i] = (v < 0 || std::isnan(v)) ? 0 : v;
+        }
+        for (size_t i = 0; i < trail; ++i) expected[lead + n + i] = 0;
+
+        for (ISA isa: supported_isas())
+        {
+            std::vector<float> dst(lead + n + trail + 1, 42.0f);
+            calibrate(isa, src.data(), n, lut.data(), dst.data(), lead, trail);
+            wassert(actual(dst == expected).istrue());
+        }
+    }
+});
+
+add_method("box_decimate", []() {
+    // 5x3 image with lines 6 samples apart, shrunk by 2 with a partial box
+    // on the right and bottom edges
+    const uint16_t src[] = {
+        1, 2,  3, 0,  5, 99,
+        3, 4,  0, 0,  7, 99,
+        9, 0,  0, 0,  0, 99,
+    };
+    uint16_t dst[3 * 2 + 1];
+    std::fill(dst, dst + 7, 0xaaaa);
+    box_decimate(src, 5, 3, 6, 2, dst, 3);
+    wassert(actual(dst[0]) == 3u); // (1+2+3+4)/4 rounded
+    wassert(actual(dst[1]) == 3u); // zeros are not counted
+    wassert(actual(dst[2]) == 6u);
+    wassert(actual(dst[3]) == 9u);
+    wassert(actual(dst[4]) == 0u); // no data
+    wassert(actual(dst[5]) == 0u);
+    wassert(actual(dst[6]) == 0xaaaau);
+
+    const float fsrc[] = {
+        1.0f, 2.0f,
+        0.0f, 4.5f,
+    };
+    float fdst[1];
+    box_decimate(fsrc, 2, 2, 2, 2, fdst, 1);
+    wassert(actual(fdst[0]) == 2.5f);
+});
+
+}
+
+}
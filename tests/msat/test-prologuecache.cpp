@@ -0,0 +1,72 @@
+#include <msat/utils/tests.h>
+#include <msat/xrit/prologuecache.h>
+#include <msat/xrit/dataaccess.h>
+#include <msat/xrit/fileaccess.h>
+#include <msat/hrit/MSG_HRIT.h>
+#include <msat/utils/sys.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+
+using namespace msat::xrit;
+using namespace msat::tests;
+
+namespace {
+
+#define TESTDATA_RSS       DATA_DIR "/rss/H:MSG2_RSS:VIS006:201604281230"
+#define TESTDATA_RSSNL     DATA_DIR "/rss/H:MSG2_RSS:IR_039:201604281230"
+
+class Tests : public TestCase
+{
+    using TestCase::TestCase;
+
+    void register_tests() override;
+} test("msat_prologuecache");
+
+void Tests::register_tests()
+{
+
+add_method("shared", []() {
+    PrologueCache::clear();
+
+    MSG_header header;
+    DataAccess vis;
+    vis.scan(FileAccess(TESTDATA_RSS), header);
+    DataAccess ir;
+    ir.scan(FileAccess(TESTDATA_RSSNL), header);
+
+    // Both channels share the same parsed prologue and epilogue
+    wassert(actual(vis.pro.get() != nullptr).istrue());
+    wassert(actual(vis.epi.get() != nullptr).istrue());
+    wassert(actual(vis.pro == ir.pro).istrue());
+    wassert(actual(vis.epi == ir.epi).istrue());
+    wassert(actual(PrologueCache::stats().misses) == 2u);
+    wassert(actual(PrologueCache::stats().hits) == 2u);
+});
+
+add_method("invalidate", []() {
+    PrologueCache::clear();
+
+    const std::string dir = "prologuecache";
+    const std::string pro = "H-000-MSG2__-MSG2_RSS____-_________-PRO______-201604281230-__";
+    msat::sys::makedirs(dir);
+    msat::sys::write_file(dir + "/" + pro, msat::sys::read_file(DATA_DIR "/rss/" + pro));
+
+    FileAccess fa(dir + "/H:MSG2_RSS:VIS006:201604281230");
+    auto p1 = PrologueCache::prologue(fa);
+    auto p2 = PrologueCache::prologue(fa);
+    wassert(actual(p1 == p2).istrue());
+
+    // A file with a different modification time is parsed again
+    struct timespec old[2] = { { 1000, 0 }, { 1000, 0 } };
+    utimensat(AT_FDCWD, (dir + "/" + pro).c_str(), old, 0);
+    auto p3 = PrologueCache::prologue(fa);
+    wassert(actual(p1 == p3).isfalse());
+    wassert(actual(PrologueCache::stats().misses) == 2u);
+
+    // A missing epilogue is reported as an error
+    wassert(actual_function([&] { PrologueCache::epilogue(fa); }).throws("No such file"));
+});
+
+}
+
+}
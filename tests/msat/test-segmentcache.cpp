@@ -0,0 +1,79 @@
+#include <msat/utils/tests.h>
+#include <msat/xrit/segmentcache.h>
+#include <msat/hrit/MSG_HRIT.h>
+
+using namespace msat::xrit;
+using namespace msat::tests;
+
+namespace {
+
+class Tests : public TestCase
+{
+    using TestCase::TestCase;
+
+    void register_tests() override;
+} test("msat_segmentcache");
+
+void Tests::register_tests()
+{
+
+add_method("lru", []() {
+    SegmentCache cache(300);
+
+    std::shared_ptr<MSG_data> s0(new MSG_data);
+    std::shared_ptr<MSG_data> s1(new MSG_data);
+    cache.put(0, s0, 100);
+    cache.put(1, s1, 100);
+    cache.put(2, std::make_shared<MSG_data>(), 100);
+    wassert(actual(cache.size()) == 3u);
+    wassert(actual(cache.bytes()) == 300u);
+
+    // Use 0, so that 1 becomes the least recently used
+    wassert(actual(cache.get(0) == s0).istrue());
+
+    // Adding another segment evicts 1
+    cache.put(3, std::make_shared<MSG_data>(), 100);
+    wassert(actual(cache.size()) == 3u);
+    wassert(actual(cache.has(0)).istrue());
+    wassert(actual(cache.has(1)).isfalse());
+    wassert(actual(cache.has(2)).istrue());
+    wassert(actual(cache.has(3)).istrue());
+    wassert(actual(cache.get(1) == nullptr).istrue());
+
+    wassert(actual(cache.stats().hits) == 1u);
+    wassert(actual(cache.stats().misses) == 1u);
+    wassert(actual(cache.stats().evictions) == 1u);
+
+    // Evicted segments stay valid as long as someone holds them
+    wassert(actual(s1.use_count()) == 1);
+});
+
+add_method("budget", []() {
+    SegmentCache cache(250);
+    cache.put(0, std::make_shared<MSG_data>(), 100);
+    cache.put(1, std::make_shared<MSG_data>(), 100);
+    cache.put(2, std::make_shared<MSG_data>(), 100);
+    wassert(actual(cache.size()) == 2u);
+    wassert(actual(cache.has(0)).isfalse());
+
+    // A segment bigger than the budget is still kept
+    cache.put(3, std::make_shared<MSG_data>(), 1000);
+    wassert(actual(cache.size()) == 1u);
+    wassert(actual(cache.has(3)).istrue());
+    wassert(actual(cache.bytes()) == 1000u);
+
+    // Which is evicted as soon as something else comes in
+    cache.put(4, std::make_shared<MSG_data>(), 100);
+    wassert(actual(cache.size()) == 1u);
+    wassert(actual(cache.has(4)).istrue());
+
+    // Shrinking the budget evicts segments
+    cache.set_budget(50);
+    wassert(actual(cache.size()) == 0u);
+    wassert(actual(cache.bytes()) == 0u);
+    wassert(actual(cache.stats().evictions) == 5u);
+});
+
+}
+
+}
@@ -0,0 +1,47 @@
+#include <msat/utils/tests.h>
+#include <msat/xrit/segmentwatcher.h>
+#include <msat/utils/sys.h>
+
+using namespace msat::xrit;
+using namespace msat::tests;
+
+namespace {
+
+class Tests : public TestCase
+{
+    using TestCase::TestCase;
+
+    void register_tests() override;
+} test("msat_segmentwatcher");
+
+void Tests::register_tests()
+{
+
+add_method("wait", []() {
+    const std::string dir = "watched";
+    if (msat::sys::isdir(dir)) msat::sys::rmtree(dir);
+    msat::sys::makedirs(dir);
+
+    SegmentWatcher watcher(FileAccess(dir + "/H:MSG2:IR_108:201604281230"));
+    wassert(actual(watcher.wait(0)).isfalse());
+
+    // Other products, channels and times are ignored
+    msat::sys::write_file(dir + "/H-000-MSG2__-MSG2________-IR_108___-000001___-201604281245-C_", "x");
+    msat::sys::write_file(dir + "/H-000-MSG2__-MSG2________-IR_039___-000001___-201604281230-C_", "x");
+    msat::sys::write_file(dir + "/H-000-MSG2__-MSG2________-_________-PRO______-201604281230-__", "x");
+    wassert(actual(watcher.wait(0)).isfalse());
+
+    // Segments of our product are reported once written
+    msat::sys::write_file(dir + "/H-000-MSG2__-MSG2________-IR_108___-000002___-201604281230-C_", "x");
+    wassert(actual(watcher.wait(1000)).istrue());
+    wassert(actual(watcher.wait(0)).isfalse());
+
+    // Moving a segment in place is also reported
+    msat::sys::write_file(dir + "/tmpfile", "x");
+    msat::sys::rename_ifexists(dir + "/tmpfile", dir + "/H-000-MSG2__-MSG2________-IR_108___-000003___-201604281230-C_");
+    wassert(actual(watcher.wait(1000)).istrue());
+});
+
+}
+
+}
@@ -303,7 +303,7 @@ bool NetCDFProduct(MSG_header *PRO_head, MSG_data* PRO_data,
                    int totalsegs, int *segsindexes,
 		   MSG_header *header, MSG_data *msgdat)
 {
-  struct tm *tmtime;
+  struct tm tmtime;
   char NcName[1024];
   char reftime[64];
   char projname[16];
@@ -385,8 +385,8 @@ bool NetCDFProduct(MSG_header *PRO_head, MSG_data* PRO_data,
 
   // Build up output NetCDF file name and open it
   sprintf( NcName, "%s_%4d%02d%02d_%02d%02d.nc", channel,
-           tmtime->tm_year + 1900, tmtime->tm_mon + 1, tmtime->tm_mday,
-	   tmtime->tm_hour, tmtime->tm_min );
+           tmtime.tm_year + 1900, tmtime.tm_mon + 1, tmtime.tm_mday,
+	   tmtime.tm_hour, tmtime.tm_min );
   NcFile ncf ( NcName , NcFile::Replace );
   if (! ncf.is_valid()) return false;
 
@@ -397,8 +397,8 @@ bool NetCDFProduct(MSG_header *PRO_head, MSG_data* PRO_data,
   if (! ncf.add_att("Satellite", MSG_spacecraft_name(spc).c_str()))
 	            return false;
   sprintf(reftime, "%04d-%02d-%02d %02d:%02d:00 UTC",
-      tmtime->tm_year + 1900, tmtime->tm_mon + 1, tmtime->tm_mday,
-      tmtime->tm_hour, tmtime->tm_min);
+      tmtime.tm_year + 1900, tmtime.tm_mon + 1, tmtime.tm_mday,
+      tmtime.tm_hour, tmtime.tm_min);
   if (! ncf.add_att("Antenna", "Fixed") ) return false;
   if (! ncf.add_att("Receiver", "HIMET") ) return false;
   if (! ncf.add_att("Time", reftime) ) return false;
@@ -462,7 +462,7 @@ bool NetCDFProduct(MSG_header *PRO_head, MSG_data* PRO_data,
   double atime;
   time_t ttime;
   extern long timezone;
-  ttime = mktime(tmtime);
+  ttime = mktime(&tmtime);
   atime = ttime - 946684800 - timezone;
   if (!tvar->put(&atime, 1)) return false;
 
@@ -0,0 +1,133 @@
+//---------------------------------------------------------------------------
+//
+//  File        :   msat-index.cpp
+//  Description :   Build an index of the xRIT products in a directory tree
+//  Author      :   Enrico Zini (for ARPA SIM Emilia Romagna)
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//  
+//---------------------------------------------------------------------------
+
+#include <config.h>
+
+#include <msat/xrit/archiveindex.h>
+#include <msat/utils/threadpool.h>
+#include <msat/utils/sys.h>
+
+#include <string>
+#include <stdexcept>
+#include <iostream>
+
+#include <getopt.h>
+
+using namespace std;
+using namespace msat::xrit;
+
+static unsigned threads = 8;
+static bool verbose = false;
+
+void do_help(const char* argv0, ostream& out)
+{
+        out << "Usage: " << argv0 << " [options] indexfile directory..." << endl << endl
+            << "Crawl directory trees of xRIT data and write an index of the products found" << endl
+            << "to indexfile. The index can then be used to open xRIT data without listing" << endl
+            << "directories, by passing it as the MSAT_XRIT_INDEX GDAL open option." << endl << endl
+            << "Options are:" << endl
+            << "  --help           Print this help message" << endl
+            << "  --threads=N      Read segment headers using N threads (or ALL_CPUS, default 8)" << endl
+            << "  --update         Add to the products already in indexfile" << endl
+            << "  --verbose        List the products found, with their quality flags" << endl;
+}
+
+void do_list(const ArchiveIndex& index)
+{
+        for (const auto& i: index.products)
+        {
+                const ArchiveIndex::Product& p = i.second;
+                cout << p.directory << "/" << p.resolution << ":" << p.productid1 << ":" << p.productid2 << ":" << p.timing
+                     << " segments " << p.segments.size() << "/" << (p.planned_end - p.planned_start + 1);
+                if (p.flags & ArchiveIndex::MISSING_SEGMENTS) cout << " missing-segments";
+                if (p.flags & ArchiveIndex::MISSING_PROLOGUE) cout << " missing-prologue";
+                if (p.flags & ArchiveIndex::MISSING_EPILOGUE) cout << " missing-epilogue";
+                if (p.flags & ArchiveIndex::UNREADABLE) cout << " unreadable";
+                cout << endl;
+        }
+}
+
+int main( int argc, char* argv[] )
+{
+        static struct option longopts[] = {
+                { "help", 0, NULL, 'H' },
+                { "threads", 1, NULL, 't' },
+                { "update", 0, NULL, 'u' },
+                { "verbose", 0, NULL, 'v' },
+                { 0, 0, 0, 0 },
+        };
+
+        bool update = false;
+        bool done = false;
+        while (!done) {
+                int c = getopt_long(argc, argv, "uv", longopts, (int*)0);
+                switch (c) {
+                        case 'H': // --help
+                                do_help(argv[0], cout);
+                                return 0;
+                        case 't': // --threads
+                                threads = msat::utils::ThreadPool::parse_count(optarg);
+                                break;
+                        case 'u': // --update
+                                update = true;
+                                break;
+                        case 'v': // --verbose
+                                verbose = true;
+                                break;
+                        case -1:
+                                done = true;
+                                break;
+                        default:
+                                cerr << "Error parsing commandline." << endl;
+                                do_help(argv[0], cerr);
+                                return 1;
+                }
+        }
+
+        if (argc - optind < 2)
+        {
+                do_help(argv[0], cerr);
+                return 1;
+        }
+
+        try
+        {
+                ArchiveIndex index;
+                string indexfile = argv[optind];
+                if (update && msat::sys::exists(indexfile))
+                        index.read(indexfile);
+                for (int i = optind + 1; i < argc; ++i)
+                        index.crawl(argv[i], threads);
+                index.write(indexfile);
+                if (verbose)
+                        do_list(index);
+        }
+        catch (std::exception& e)
+        {
+                cerr << e.what() << endl;
+                return 1;
+        }
+
+        return 0;
+}
+
+// vim:set ts=2 sw=2:
@@ -25,6 +25,7 @@
 #include <msat/xrit/fileaccess.h>
 #include <msat/xrit/dataaccess.h>
 #include <msat/hrit/MSG_HRIT.h>
+#include <msat/utils/threadpool.h>
 
 #include <stdint.h>
 #include <set>
@@ -40,12 +41,15 @@
 using namespace std;
 using namespace msat::xrit;
 
+static unsigned threads = 1;
+
 void do_help(const char* argv0, ostream& out)
 {
         out << "Usage: " << argv0 << " [options] file(s)..." << endl << endl
             << "Dump contents and structure of an xRIT dataset." << endl << endl
             << "Options are:" << endl
-            << "  --help           Print this help message" << endl;
+            << "  --help           Print this help message" << endl
+            << "  --threads=N      Decode segments using N threads (or ALL_CPUS)" << endl;
 }
 
 void do_dump(const char* name)
@@ -59,6 +63,21 @@ void do_dump(const char* name)
 
         da.scan(fa, pro, epi, header);
 
+        // Decode all segments upfront, in parallel if requested, or else
+        // decode the next segment in background while dumping the current one
+        da.threads = threads;
+        if (threads > 1)
+        {
+                // Make room for the whole image, or preload would stop at
+                // the default cache budget
+                size_t size = da.segnames.size() * da.segment_size();
+                if (da.segcache.budget() < size)
+                        da.segcache.set_budget(size);
+                da.preload();
+        }
+        else
+                da.readahead = 1;
+
         cout << "Columns: " << da.columns << endl
              << "Lines: " << da.lines << endl
              << "Segments: " << da.segnames.size() << endl
@@ -88,7 +107,7 @@ void do_dump(const char* name)
         for (size_t i = 0; i < da.segnames.size(); ++i)
         {
                 cout << "Segment " << i << ": ";
-                MSG_data* d = da.segment(i);
+                std::shared_ptr<MSG_data> d = da.segment(i);
                 MSG_SAMPLE min = 0xffff, max = 0;
                 if (!d)
                 {
@@ -156,6 +175,7 @@ int main( int argc, char* argv[] )
 {
         static struct option longopts[] = {
                 { "help", 0, NULL, 'H' },
+                { "threads", 1, NULL, 't' },
 //                { "area", 1, 0, 'a' },
 //                { "pixels", 0, 0, 'p' },
                 { 0, 0, 0, 0 },
@@ -168,6 +188,9 @@ int main( int argc, char* argv[] )
                         case 'H': // --help
                                 do_help(argv[0], cout);
                                 return 0;
+                        case 't': // --threads
+                                threads = msat::utils::ThreadPool::parse_count(optarg);
+                                break;
 #if 0
                         case 'a':
                                 if (sscanf(optarg, "%d,%d,%d,%d", &ax,&ay,&aw,&ah) != 4)